@@ -7,6 +7,10 @@ layout(location = 2) in vec2 aTexCoord;
 out vec3 Normal;
 out vec3 FragPos;
 out vec2 TexCoord;
+// Distance along the view direction, used to pick the shadow cascade.
+out float ViewDepth;
+
+invariant gl_Position;
 
 uniform mat4 model;
 uniform mat4 view;
@@ -18,4 +22,5 @@ void main()
     FragPos = vec3(model * vec4(aPos, 1.0));
     Normal = mat3(transpose(inverse(model))) * aNormal;
     TexCoord = aTexCoord;
+    ViewDepth = -(view * vec4(FragPos, 1.0)).z;
 }
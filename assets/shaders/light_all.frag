@@ -1,9 +1,13 @@
 #version 330 core
 
+// Textures are layers of texture arrays, shared between materials.
 struct Material {
-    sampler2D diffuse;
-    sampler2D specular;
-    sampler2D emission;
+    sampler2DArray diffuse;
+    sampler2DArray specular;
+    sampler2DArray emission;
+    float diffuseLayer;
+    float specularLayer;
+    float emissionLayer;
     float shininess;
 };
 
@@ -35,10 +39,12 @@ struct SpotLight {
 };
 
 #define NR_POINT_LIGHTS 4
+#define NR_CASCADES 4
 
 in vec3 Normal;
 in vec3 FragPos;
 in vec2 TexCoord;
+in float ViewDepth;
 
 out vec4 FragColor;
 
@@ -48,18 +54,49 @@ uniform DirLight dirLight;
 uniform PointLight pointLights[NR_POINT_LIGHTS];
 uniform SpotLight spotLight;
 
-vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
+uniform bool shadowsEnabled;
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 lightSpaceMatrices[NR_CASCADES];
+uniform float cascadeSplits[NR_CASCADES];
+
+float CalcShadow()
+{
+    if (!shadowsEnabled)
+        return 1.0;
+
+    int cascade = NR_CASCADES - 1;
+    for (int i = 0; i < NR_CASCADES; i++) {
+        if (ViewDepth < cascadeSplits[i]) {
+            cascade = i;
+            break;
+        }
+    }
+    vec4 lightSpace = lightSpaceMatrices[cascade] * vec4(FragPos, 1.0);
+    vec3 coords = lightSpace.xyz / lightSpace.w * 0.5 + 0.5;
+    if (coords.z > 1.0 || ViewDepth > cascadeSplits[NR_CASCADES - 1])
+        return 1.0;
+
+    // 3x3 PCF, each tap being bilinearly filtered by the comparison sampler
+    vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+    float lit = 0.0;
+    for (int x = -1; x <= 1; x++)
+        for (int y = -1; y <= 1; y++)
+            lit += texture(shadowMap, vec4(coords.xy + vec2(x, y) * texelSize, cascade, coords.z));
+    return lit / 9.0;
+}
+
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir, float shadow)
 {
     vec3 lightDir = normalize(-light.direction);
     vec3 reflectDir = reflect(-lightDir, normal);
     float diff = max(dot(normal, lightDir), 0.0);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
 
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoord));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoord));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoord));
+    vec3 ambient = light.ambient * vec3(texture(material.diffuse, vec3(TexCoord, material.diffuseLayer)));
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, vec3(TexCoord, material.diffuseLayer)));
+    vec3 specular = light.specular * spec * vec3(texture(material.specular, vec3(TexCoord, material.specularLayer)));
 
-    return ambient + diffuse + specular;
+    return ambient + (diffuse + specular) * shadow;
 }
 
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
@@ -71,9 +108,9 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
 
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoord)) * attenuation;
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoord)) * attenuation;
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoord)) * attenuation;
+    vec3 ambient = light.ambient * vec3(texture(material.diffuse, vec3(TexCoord, material.diffuseLayer))) * attenuation;
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, vec3(TexCoord, material.diffuseLayer))) * attenuation;
+    vec3 specular = light.specular * spec * vec3(texture(material.specular, vec3(TexCoord, material.specularLayer))) * attenuation;
 
     return ambient + diffuse + specular;
 }
@@ -89,13 +126,13 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
         vec3 reflectDir = reflect(-lightDir, normal);
         float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
 
-        vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoord));
-        vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoord)) * intensity;
-        vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoord)) * intensity;
+        vec3 ambient = light.ambient * vec3(texture(material.diffuse, vec3(TexCoord, material.diffuseLayer)));
+        vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, vec3(TexCoord, material.diffuseLayer))) * intensity;
+        vec3 specular = light.specular * spec * vec3(texture(material.specular, vec3(TexCoord, material.specularLayer))) * intensity;
 
         return ambient + diffuse + specular;
     } else
-        return light.ambient * vec3(texture(material.diffuse, TexCoord));
+        return light.ambient * vec3(texture(material.diffuse, vec3(TexCoord, material.diffuseLayer)));
 }
 
 void main()
@@ -103,12 +140,12 @@ void main()
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPos);
 
-    vec3 emission = vec3(texture(material.emission, TexCoord));
+    vec3 emission = vec3(texture(material.emission, vec3(TexCoord, material.emissionLayer)));
 
-    vec3 result = CalcDirLight(dirLight, norm, viewDir) + CalcSpotLight(spotLight, norm, FragPos, viewDir); // + emission;
+    vec3 result = CalcDirLight(dirLight, norm, viewDir, CalcShadow()) + CalcSpotLight(spotLight, norm, FragPos, viewDir); // + emission;
 
     for (int i = 0; i < NR_POINT_LIGHTS; i++)
         result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
 
-    FragColor = vec4(result, vec4(texture(material.diffuse, TexCoord)).w);
+    FragColor = vec4(result, vec4(texture(material.diffuse, vec3(TexCoord, material.diffuseLayer))).w);
 }
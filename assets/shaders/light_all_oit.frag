@@ -0,0 +1,124 @@
+#version 330 core
+
+// Textures are layers of texture arrays, shared between materials.
+struct Material {
+    sampler2DArray diffuse;
+    sampler2DArray specular;
+    sampler2DArray emission;
+    float diffuseLayer;
+    float specularLayer;
+    float emissionLayer;
+    float shininess;
+};
+
+struct DirLight {
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct SpotLight {
+    vec3 position;
+    vec3 direction;
+    float cutOff;
+    float outerCutOff;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+#define NR_POINT_LIGHTS 4
+
+in vec3 Normal;
+in vec3 FragPos;
+in vec2 TexCoord;
+
+layout(location = 0) out vec4 Accumulation;
+layout(location = 1) out float Weight;
+
+uniform vec3 viewPos;
+uniform Material material;
+uniform DirLight dirLight;
+uniform PointLight pointLights[NR_POINT_LIGHTS];
+uniform SpotLight spotLight;
+
+vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
+{
+    vec3 lightDir = normalize(-light.direction);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float diff = max(dot(normal, lightDir), 0.0);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+
+    vec3 ambient = light.ambient * vec3(texture(material.diffuse, vec3(TexCoord, material.diffuseLayer)));
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, vec3(TexCoord, material.diffuseLayer)));
+    vec3 specular = light.specular * spec * vec3(texture(material.specular, vec3(TexCoord, material.specularLayer)));
+
+    return ambient + diffuse + specular;
+}
+
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    vec3 reflectDir = reflect(-lightDir, normal);
+    float diff = max(dot(normal, lightDir), 0.0);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+
+    vec3 ambient = light.ambient * vec3(texture(material.diffuse, vec3(TexCoord, material.diffuseLayer))) * attenuation;
+    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, vec3(TexCoord, material.diffuseLayer))) * attenuation;
+    vec3 specular = light.specular * spec * vec3(texture(material.specular, vec3(TexCoord, material.specularLayer))) * attenuation;
+
+    return ambient + diffuse + specular;
+}
+
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+    vec3 lightDir = normalize(light.position - fragPos);
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    if (theta > light.outerCutOff) {
+        float diff = max(dot(normal, lightDir), 0.0);
+        vec3 reflectDir = reflect(-lightDir, normal);
+        float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+
+        vec3 ambient = light.ambient * vec3(texture(material.diffuse, vec3(TexCoord, material.diffuseLayer)));
+        vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, vec3(TexCoord, material.diffuseLayer))) * intensity;
+        vec3 specular = light.specular * spec * vec3(texture(material.specular, vec3(TexCoord, material.specularLayer))) * intensity;
+
+        return ambient + diffuse + specular;
+    } else
+        return light.ambient * vec3(texture(material.diffuse, vec3(TexCoord, material.diffuseLayer)));
+}
+
+void main()
+{
+    vec3 norm = normalize(Normal);
+    vec3 viewDir = normalize(viewPos - FragPos);
+
+    vec3 emission = vec3(texture(material.emission, vec3(TexCoord, material.emissionLayer)));
+
+    vec3 result = CalcDirLight(dirLight, norm, viewDir) + CalcSpotLight(spotLight, norm, FragPos, viewDir); // + emission;
+
+    for (int i = 0; i < NR_POINT_LIGHTS; i++)
+        result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);
+
+    vec4 color = vec4(result, vec4(texture(material.diffuse, vec3(TexCoord, material.diffuseLayer))).w);
+
+    // Weight favouring close and opaque fragments (McGuire & Bavoil).
+    float weight = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+    Accumulation = vec4(color.rgb * color.a * weight, color.a);
+    Weight = color.a * weight;
+}
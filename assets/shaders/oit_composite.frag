@@ -0,0 +1,21 @@
+#version 330 core
+
+out vec4 FragColor;
+
+uniform sampler2D accumulation;
+uniform sampler2D weight;
+
+void main()
+{
+    ivec2 coordinates = ivec2(gl_FragCoord.xy);
+    vec4 accum = texelFetch(accumulation, coordinates, 0);
+    float revealage = accum.a;
+    if (revealage >= 1.0)
+        discard;
+
+    float weight_sum = texelFetch(weight, coordinates, 0).r;
+    vec3 average_color = accum.rgb / max(weight_sum, 1e-5);
+
+    // Blended with (1 - src alpha, src alpha): average * (1 - revealage) + background * revealage.
+    FragColor = vec4(average_color, revealage);
+}
@@ -0,0 +1,8 @@
+#version 330 core
+
+// Full screen triangle, no vertex buffer needed.
+void main()
+{
+    vec2 position = vec2(float((gl_VertexID & 1) << 2), float((gl_VertexID & 2) << 1)) - 1.0;
+    gl_Position = vec4(position, 0.0, 1.0);
+}
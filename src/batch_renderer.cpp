@@ -0,0 +1,363 @@
+#include "batch_renderer.h"
+
+#include "ngn/io/file_system.h"
+#include "ngn/io/image_encoder.h"
+#include "ngn/jobs/jobs.h"
+#include "ngn/math/bounds.h"
+#include "ngn/rendering/framebuffer.h"
+#include "ngn/rendering/gl_context.h"
+#include "ngn/rendering/gl_state.h"
+#include "ngn/rendering/model.h"
+#include "ngn/rendering/readback_ring.h"
+#include "ngn/rendering/shader.h"
+#include "ngn/rendering/texture.h"
+#include "ngn/scene/scene.h"
+#include "ngn/scene/static_batches.h"
+#include "ngn/utils/log.h"
+
+#include <glad/glad.h>
+
+#include <GLFW/glfw3.h>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Reads in flight before rendering waits for the oldest: enough to cover the GPU's lag behind the CPU.
+ */
+constexpr size_t READBACK_SLOTS = 3;
+/**
+ * @brief Images queued for encoding per thread before rendering waits for the encoders.
+ */
+constexpr size_t ENCODES_PER_THREAD = 2;
+constexpr int DEFAULT_SIZE = 256;
+constexpr float DEFAULT_FOV = 45;
+constexpr float MAX_ELEVATION = 89;
+// Units 0 to 2 are used by the material textures, the shadow map sampler must not share them.
+constexpr int SHADOW_MAP_UNIT = 3;
+constexpr int POINT_LIGHT_COUNT = 4;
+
+struct Shot {
+    size_t model;
+    std::string output;
+    int width;
+    int height;
+    /**
+     * @brief Vertical field of view, in degrees.
+     */
+    float fov;
+    /**
+     * @brief Pose around the model's bounds, in degrees and framing distances, instead of eye and target.
+     */
+    bool orbit;
+    glm::vec3 eye;
+    glm::vec3 target;
+    float azimuth;
+    float elevation;
+    float distance;
+};
+
+struct Batch {
+    std::vector<std::string> models;
+    std::vector<Shot> shots;
+};
+
+static bool parse_batch(const std::string& path, Batch& batch)
+{
+    std::ifstream file(path);
+    if (!file) {
+        LOGERRF("Failed to open %s.", path.c_str());
+        return false;
+    }
+
+    int width = DEFAULT_SIZE, height = DEFAULT_SIZE;
+    float fov = DEFAULT_FOV;
+    std::string line;
+    for (int line_number = 1; std::getline(file, line); line_number++) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string command;
+        if (!(words >> command))
+            continue;
+
+        Shot shot { batch.models.size() - 1, {}, width, height, fov, false, {}, {}, 0, 0, 1 };
+        bool valid = true;
+        if (command == "size") {
+            valid = static_cast<bool>(words >> width >> height) && width > 0 && height > 0;
+        } else if (command == "fov") {
+            valid = static_cast<bool>(words >> fov) && fov > 0 && fov < 180;
+        } else if (command == "model") {
+            std::string model;
+            valid = static_cast<bool>(words >> model);
+            batch.models.push_back(model);
+        } else if (batch.models.empty() && (command == "view" || command == "orbit" || command == "turntable")) {
+            LOGERRF("%s:%d: %s before any model.", path.c_str(), line_number, command.c_str());
+            return false;
+        } else if (command == "view") {
+            valid = static_cast<bool>(words >> shot.output >> shot.eye.x >> shot.eye.y >> shot.eye.z
+                >> shot.target.x >> shot.target.y >> shot.target.z);
+            batch.shots.push_back(shot);
+        } else if (command == "orbit") {
+            shot.orbit = true;
+            valid = static_cast<bool>(words >> shot.output >> shot.azimuth >> shot.elevation);
+            words >> shot.distance;
+            batch.shots.push_back(shot);
+        } else if (command == "turntable") {
+            std::string prefix;
+            int frames = 0;
+            valid = static_cast<bool>(words >> prefix >> frames) && frames > 0;
+            shot.orbit = true;
+            words >> shot.elevation >> shot.distance;
+            for (int frame = 0; valid && frame < frames; frame++) {
+                char suffix[16];
+                snprintf(suffix, sizeof(suffix), "_%04d.png", frame);
+                shot.output = prefix + suffix;
+                shot.azimuth = 360.f * frame / frames;
+                batch.shots.push_back(shot);
+            }
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            LOGERRF("%s:%d: invalid command \"%s\".", path.c_str(), line_number, line.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+static void set_lighting(const ngn::Shader& shader)
+{
+    shader.use();
+    for (int type : { ngn::TextureType::Diffuse, ngn::TextureType::Specular, ngn::TextureType::Emission })
+        shader.set(std::string("material.") + ngn::TextureType::to_string(static_cast<ngn::TextureType::Value>(type)), type);
+    shader.set("material.shininess", 32.f);
+    shader.set("shadowMap", SHADOW_MAP_UNIT);
+    shader.set("shadowsEnabled", 0);
+
+    // A single directional light: the point and spot lights of the interactive scene are left dark.
+    shader.set("dirLight.direction", glm::vec3 { -.2, -1, -.3 });
+    shader.set("dirLight.ambient", glm::vec3 { .1 });
+    shader.set("dirLight.diffuse", glm::vec3 { 1 });
+    shader.set("dirLight.specular", glm::vec3 { 1 });
+    for (int i = 0; i < POINT_LIGHT_COUNT; i++) {
+        std::string light = "pointLights[" + std::to_string(i) + "]";
+        shader.set(light + ".ambient", glm::vec3 { 0 });
+        shader.set(light + ".diffuse", glm::vec3 { 0 });
+        shader.set(light + ".specular", glm::vec3 { 0 });
+        shader.set(light + ".constant", 1.f);
+    }
+    shader.set("spotLight.ambient", glm::vec3 { 0 });
+    shader.set("spotLight.diffuse", glm::vec3 { 0 });
+    shader.set("spotLight.specular", glm::vec3 { 0 });
+}
+
+static void draw_batches(const ngn::StaticBatches& batches, const ngn::Shader& shader)
+{
+    shader.set("model", glm::mat4(1));
+    for (auto& batch : batches.batches()) {
+        for (auto& texture : batch.mesh.textures()) {
+            ngn::GLState::bind_texture(texture.type(), GL_TEXTURE_2D_ARRAY, texture.id());
+            shader.set(std::string("material.") + ngn::TextureType::to_string(texture.type()) + "Layer", static_cast<float>(texture.layer()));
+        }
+        ngn::StaticBatches::draw(batch, false);
+    }
+}
+
+static ngn::Bounds batches_bounds(const ngn::StaticBatches& batches)
+{
+    ngn::Bounds bounds;
+    for (auto& batch : batches.batches()) {
+        for (auto& cluster : batch.clusters)
+            bounds.extend(cluster.bounds);
+    }
+    return bounds;
+}
+
+static int render_batch(const Batch& batch)
+{
+    ngn::Shader shader("assets/shaders/light.vert", "assets/shaders/light_all.frag");
+    set_lighting(shader);
+    ngn::GLState::set_enabled(GL_DEPTH_TEST, true);
+    ngn::GLState::set_enabled(GL_CULL_FACE, true);
+    ngn::GLState::set_enabled(GL_BLEND, true);
+    ngn::GLState::blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    ngn::Framebuffer framebuffer("Batch framebuffer");
+    ngn::ReadbackRing readbacks(READBACK_SLOTS, "Batch readback");
+
+    // The next model is read and converted on the job threads while the current one renders.
+    std::optional<ngn::Model::Data> next_model_data;
+    size_t next_model = 0;
+    ngn::jobs::Counter loading;
+    auto prefetch = [&](size_t model) {
+        next_model = model;
+        if (model < batch.models.size())
+            ngn::jobs::run([&, model] { next_model_data = ngn::Model::load(batch.models[model]); }, &loading);
+    };
+
+    std::optional<ngn::Model> model;
+    std::optional<ngn::Scene> scene;
+    ngn::StaticBatches batches;
+    ngn::Bounds bounds;
+    size_t loaded_model = SIZE_MAX;
+    prefetch(0);
+
+    // Encoding runs on every thread, the GL one included whenever it waits for the encoders.
+    ngn::jobs::Counter encoding;
+    std::atomic<size_t> queued_encodes = 0;
+    std::atomic<size_t> failures = 0;
+    size_t max_queued_encodes = (ngn::jobs::worker_count() + 1) * ENCODES_PER_THREAD;
+    double readback_wait_ms = 0, encoder_wait_ms = 0;
+
+    auto collect = [&](bool wait) {
+        uint64_t shot = 0;
+        auto image = std::make_shared<ngn::Image>();
+        auto wait_start = std::chrono::steady_clock::now();
+        bool collected = readbacks.collect(wait, shot, *image);
+        readback_wait_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wait_start).count();
+        if (!collected)
+            return false;
+        const std::string& output = batch.shots[shot].output;
+        if (image->pixels.empty()) {
+            LOGERRF("Failed to read back %s.", output.c_str());
+            failures++;
+            return true;
+        }
+
+        // Waiting for one encode only, rather than for all of them, keeps the workers busy meanwhile.
+        if (queued_encodes >= max_queued_encodes) {
+            auto encoder_wait_start = std::chrono::steady_clock::now();
+            ngn::jobs::wait_until([&] { return queued_encodes < max_queued_encodes; });
+            encoder_wait_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - encoder_wait_start).count();
+        }
+        queued_encodes++;
+        ngn::jobs::run([&, image] {
+            if (!ngn::write_png(output, *image, true)) {
+                LOGERRF("Failed to write %s.", output.c_str());
+                failures++;
+            }
+            queued_encodes--;
+        }, &encoding);
+        return true;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < batch.shots.size(); i++) {
+        const Shot& shot = batch.shots[i];
+        if (shot.model != loaded_model) {
+            // Scene and batches refer to the model's meshes: they go first. The pool keeps textures until
+            // told otherwise, so the ones of the previous model are released with it.
+            batches.clear();
+            scene.reset();
+            model.reset();
+            ngn::TexturePool::release_unused();
+            ngn::jobs::wait(loading);
+            // A model without shots is skipped, so the prefetched one may not be the next one after all.
+            if (next_model != shot.model)
+                next_model_data = ngn::Model::load(batch.models[shot.model]);
+            model.emplace(std::move(*next_model_data), batch.models[shot.model]);
+            next_model_data.reset();
+            loaded_model = shot.model;
+            prefetch(shot.model + 1);
+
+            scene.emplace();
+            ngn::Scene::Node root = scene->create_node();
+            scene->set_static(root, true);
+            model->instantiate(*scene, root);
+            scene->update();
+            batches.build(*scene);
+            bounds = batches_bounds(batches);
+        }
+        if (bounds.empty()) {
+            LOGERRF("Nothing to render in %s for %s.", batch.models[shot.model].c_str(), shot.output.c_str());
+            failures++;
+            continue;
+        }
+
+        glm::vec3 center = (bounds.min + bounds.max) * .5f;
+        float radius = glm::length(bounds.max - bounds.min) * .5f;
+        float fov = glm::radians(shot.fov);
+        glm::vec3 eye = shot.eye, target = shot.target;
+        if (shot.orbit) {
+            float azimuth = glm::radians(shot.azimuth);
+            float elevation = glm::radians(std::clamp(shot.elevation, -MAX_ELEVATION, MAX_ELEVATION));
+            float distance = shot.distance * radius / std::sin(std::min(fov, fov * shot.width / shot.height) * .5f);
+            eye = center + distance * glm::vec3 { std::cos(elevation) * std::sin(azimuth), std::sin(elevation), std::cos(elevation) * std::cos(azimuth) };
+            target = center;
+        }
+        // Depth range fitted to the bounds, for the best precision on whatever scale the model has.
+        float eye_distance = glm::length(eye - center);
+        float far = eye_distance + radius;
+        float near = std::max(eye_distance - radius, far * .001f);
+
+        framebuffer.bind(shot.width, shot.height);
+        glClearColor(0, 0, 0, 0);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        shader.use();
+        shader.set("projection", glm::perspective(fov, static_cast<float>(shot.width) / shot.height, near, far));
+        shader.set("view", glm::lookAt(eye, target, glm::vec3 { 0, 1, 0 }));
+        shader.set("viewPos", eye);
+        draw_batches(batches, shader);
+
+        // Only wait for the GPU when every buffer is in flight, then take whatever else it finished.
+        if (readbacks.full())
+            collect(true);
+        readbacks.read(shot.width, shot.height, i);
+        while (collect(false)) { }
+    }
+    while (!readbacks.empty())
+        collect(true);
+    ngn::jobs::wait(encoding);
+    ngn::jobs::wait(loading);
+
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    size_t written = batch.shots.size() - failures;
+    printf("%zu / %zu shots written in %.3f s, %.1f shots/s, %.3f ms waiting for readbacks, %.3f ms for encoders\n",
+        written, batch.shots.size(), seconds.count(), batch.shots.size() / seconds.count(), readback_wait_ms, encoder_wait_ms);
+    return failures ? 1 : 0;
+}
+
+int run_batch(int argc, char** argv)
+{
+    if (argc < 1) {
+        LOGERR("Usage: app --batch <batch file>");
+        return 1;
+    }
+    Batch batch;
+    if (!parse_batch(argv[0], batch))
+        return 1;
+    for (auto& shot : batch.shots) {
+        std::filesystem::path directory = std::filesystem::path(shot.output).parent_path();
+        if (!directory.empty())
+            std::filesystem::create_directories(directory);
+    }
+
+    // Shots render to a framebuffer object: the window's own is never drawn to.
+    GLFWwindow* window = ngn::create_hidden_gl_context(1, 1, "batch");
+    if (!window)
+        return 1;
+    ngn::jobs::init();
+    // Without a pack, assets are read from the loose directory.
+    if (ngn::FileSystem::exists("assets.pack"))
+        ngn::FileSystem::mount("assets.pack");
+
+    int result = render_batch(batch);
+
+    ngn::jobs::shutdown();
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return result;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+/**
+ * @brief Renders the shots of a batch file offscreen, in a hidden window, and writes each one as a PNG.
+ *
+ * Usage: app --batch <batch file>. Each line of the file is a command, # starts a comment:
+ *   size <width> <height>                     size of the following shots, 256 by 256 by default
+ *   fov <degrees>                             vertical field of view of the following shots, 45 by default
+ *   model <path>                              model of the following shots
+ *   view <output> <eye xyz> <target xyz>      shot from a world space pose
+ *   orbit <output> <azimuth> <elevation> [distance]
+ *                                             shot looking at the model's bounds from angles in degrees, at
+ *                                             a multiple of the distance framing them (1 by default)
+ *   turntable <prefix> <frames> [elevation] [distance]
+ *                                             <frames> orbit shots around the model, <prefix>_0000.png on
+ *
+ * Without a display on Linux, the context comes from Mesa's OSMesa, so batches also run headless.
+ *
+ * @return The process exit code.
+ */
+int run_batch(int argc, char** argv);
@@ -0,0 +1,335 @@
+#include "benchmarks.h"
+
+#include "ngn/io/assimp_io_system.h"
+#include "ngn/io/image_decoder.h"
+#include "ngn/jobs/jobs.h"
+#include "ngn/math/batch_transform.h"
+#include "ngn/math/triangle_bvh.h"
+#include "ngn/rendering/command_buffer.h"
+#include "ngn/rendering/model.h"
+#include "ngn/utils/log.h"
+#include "ngn/utils/radix_sort.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+
+constexpr int BENCHMARK_REPETITIONS = 5;
+/**
+ * @brief Largest thread count accepted, far above any machine the benchmarks run on.
+ */
+constexpr unsigned MAX_THREADS = 1024;
+
+/**
+ * @brief Best wall time of a few runs of {{body}}, in milliseconds.
+ */
+static double best_time(const std::function<void()>& body)
+{
+    double best = INFINITY;
+    for (int i = 0; i < BENCHMARK_REPETITIONS; i++) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+        best = std::min(best, duration.count());
+    }
+    return best;
+}
+
+/**
+ * @brief Reads the thread count argument at {{index}} into {{threads}}, every hardware thread when it is missing.
+ *
+ * @return Whether it was missing or a count from 1 to MAX_THREADS. Otherwise, the error is logged.
+ */
+static bool thread_count(int argc, char** argv, int index, unsigned& threads)
+{
+    if (argc <= index) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+        return true;
+    }
+    char* end = nullptr;
+    unsigned long count = std::strtoul(argv[index], &end, 10);
+    if (*end != '\0' || argv[index][0] == '-' || count == 0 || count > MAX_THREADS) {
+        LOGERRF("Invalid thread count \"%s\", expected 1 to %u.", argv[index], MAX_THREADS);
+        return false;
+    }
+    threads = static_cast<unsigned>(count);
+    return true;
+}
+
+static int benchmark_jobs(int argc, char** argv)
+{
+    unsigned max_threads;
+    if (!thread_count(argc, argv, 0, max_threads))
+        return 1;
+
+    constexpr size_t COMPUTE_COUNT = 1 << 22;
+    constexpr size_t INSTANCE_COUNT = 1 << 20;
+    constexpr size_t GRAIN = 4096;
+
+    std::vector<float> results(COMPUTE_COUNT);
+    ngn::TransformBatch transforms;
+    transforms.resize(INSTANCE_COUNT);
+    std::vector<float> matrices(INSTANCE_COUNT * 16);
+
+    printf("threads   compute (ms)  speedup   transforms (ms)  speedup\n");
+    double compute_base = 0, transforms_base = 0;
+    for (unsigned threads = 1; threads <= max_threads; threads++) {
+        ngn::jobs::init(threads - 1);
+
+        double compute = best_time([&] {
+            ngn::jobs::parallel_for(0, COMPUTE_COUNT, GRAIN, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++)
+                    results[i] = std::sin(i * .001f) * std::cos(i * .002f) + std::sqrt(static_cast<float>(i));
+            });
+        });
+        double transform = best_time([&] {
+            ngn::jobs::parallel_for(0, INSTANCE_COUNT, GRAIN, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++)
+                    transforms.set(i, glm::vec3(i, 0, 0), glm::angleAxis(i * .01f, glm::vec3 { 0, 1, 0 }), glm::vec3 { 1 });
+                ngn::compose_transforms(transforms, begin, end, matrices.data());
+            });
+        });
+
+        ngn::jobs::shutdown();
+
+        if (threads == 1) {
+            compute_base = compute;
+            transforms_base = transform;
+        }
+        printf("%7u %14.3f %8.2fx %17.3f %8.2fx\n", threads, compute, compute_base / compute, transform, transforms_base / transform);
+    }
+    return 0;
+}
+
+static int benchmark_import(int argc, char** argv)
+{
+    std::string path = argc > 0 ? argv[0] : "assets/models/backpack/backpack.obj";
+    unsigned max_threads;
+    if (!thread_count(argc, argv, 1, max_threads))
+        return 1;
+
+    // Parsing stays serial: measure it alone to tell it apart from the conversion.
+    double parse = best_time([&] {
+        Assimp::Importer import;
+        import.SetIOHandler(new ngn::AssimpIOSystem);
+        import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+    });
+
+    size_t vertex_count = 0;
+    for (auto& mesh : ngn::Model::load(path).meshes)
+        vertex_count += mesh.vertices.size();
+    printf("%s: %zu vertices, parse %.3f ms\n", path.c_str(), vertex_count, parse);
+
+    printf("threads    import (ms)  conversion (ms)  speedup\n");
+    double conversion_base = 0;
+    for (unsigned threads = 1; threads <= max_threads; threads++) {
+        ngn::jobs::init(threads - 1);
+        double import = best_time([&] { ngn::Model::load(path); });
+        ngn::jobs::shutdown();
+
+        double conversion = std::max(import - parse, 0.0);
+        if (threads == 1)
+            conversion_base = conversion;
+        printf("%7u %14.3f %16.3f %8.2fx\n", threads, import, conversion, conversion > 0 ? conversion_base / conversion : 0.0);
+    }
+    return 0;
+}
+
+static int benchmark_record(int argc, char** argv)
+{
+    unsigned max_threads;
+    if (!thread_count(argc, argv, 0, max_threads))
+        return 1;
+
+    constexpr size_t DRAW_COUNT = 1 << 20;
+    constexpr size_t GRAIN = 1024;
+    const glm::vec3 camera_position { 0, 0, 10 };
+    const glm::vec3 camera_front { 0, 0, -1 };
+
+    // What recording a draw costs without GL: its matrix, its depth key and the packet itself.
+    ngn::CommandList commands;
+    auto record = [&] {
+        commands.reset();
+        ngn::jobs::parallel_for(0, DRAW_COUNT, GRAIN, [&](size_t begin, size_t end) {
+            ngn::CommandBuffer& buffer = commands.local();
+            for (size_t i = begin; i < end; i++) {
+                glm::vec3 position { static_cast<float>(i % 1024), 0, -static_cast<float>(i / 1024) };
+                glm::mat4 model = glm::translate(glm::mat4(1), position) * glm::mat4_cast(glm::angleAxis(i * .01f, glm::vec3 { 0, 1, 0 }));
+                float depth = glm::dot(glm::vec3(model[3]) - camera_position, camera_front);
+                buffer.draw({ model, nullptr, ngn::sortable_float(depth), static_cast<uint32_t>(i), false });
+            }
+        });
+    };
+
+    printf("%zu draws\n", DRAW_COUNT);
+    printf("threads    record (ms)  speedup  Mdraws/s  merge+sort (ms)\n");
+    double record_base = 0;
+    for (unsigned threads = 1; threads <= max_threads; threads++) {
+        ngn::jobs::init(threads - 1);
+        double recording = best_time(record);
+        // Merging and sorting stay on one thread, like replaying on the GL thread.
+        double sorting = best_time([&] { commands.sort(); });
+        ngn::jobs::shutdown();
+
+        if (threads == 1)
+            record_base = recording;
+        printf("%7u %14.3f %7.2fx %9.1f %16.3f\n", threads, recording, record_base / recording, DRAW_COUNT / recording / 1e3, sorting);
+    }
+    return 0;
+}
+
+static int benchmark_rays(int argc, char** argv)
+{
+    std::string path = argc > 0 ? argv[0] : "assets/models/backpack/backpack.obj";
+    unsigned max_threads;
+    if (!thread_count(argc, argv, 1, max_threads))
+        return 1;
+
+    constexpr size_t RAY_COUNT = 1 << 20;
+    constexpr size_t GRAIN = 1024;
+
+    ngn::Model::Data data = ngn::Model::load(path);
+    std::vector<std::vector<glm::vec3>> positions(data.meshes.size());
+    size_t triangle_count = 0;
+    for (size_t i = 0; i < data.meshes.size(); i++) {
+        for (auto& vertex : data.meshes[i].vertices)
+            positions[i].push_back(vertex.position);
+        triangle_count += data.meshes[i].indices.size() / 3;
+    }
+
+    std::vector<ngn::TriangleBvh> bvhs(data.meshes.size());
+    auto build = [&](bool parallel) {
+        for (size_t i = 0; i < data.meshes.size(); i++)
+            bvhs[i] = ngn::TriangleBvh(positions[i], data.meshes[i].indices, parallel);
+    };
+    double serial_build = best_time([&] { build(false); });
+    ngn::jobs::init(max_threads - 1);
+    double parallel_build = best_time([&] { build(true); });
+    ngn::jobs::shutdown();
+    printf("%s: %zu triangles, build %.3f ms, %.3f ms on %u threads\n", path.c_str(), triangle_count, serial_build, parallel_build, max_threads);
+
+    // From a sphere around the model towards points within its bounds: a mix of hits and misses.
+    ngn::Bounds bounds;
+    for (auto& bvh : bvhs)
+        bounds.extend(bvh.bounds());
+    glm::vec3 center = (bounds.min + bounds.max) * .5f;
+    glm::vec3 half_extent = (bounds.max - bounds.min) * .5f;
+    float radius = glm::length(half_extent) * 2;
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(-1, 1);
+    std::vector<ngn::Ray> rays(RAY_COUNT);
+    for (auto& ray : rays) {
+        ray.origin = center + glm::normalize(glm::vec3(unit(random), unit(random), unit(random))) * radius;
+        glm::vec3 target = center + glm::vec3(unit(random), unit(random), unit(random)) * half_extent;
+        ray.direction = glm::normalize(target - ray.origin);
+    }
+
+    std::vector<uint8_t> hits(RAY_COUNT);
+    auto cast = [&] {
+        ngn::jobs::parallel_for(0, RAY_COUNT, GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                float closest = INFINITY;
+                for (auto& bvh : bvhs) {
+                    if (auto hit = bvh.intersect(rays[i], closest))
+                        closest = hit->distance;
+                }
+                hits[i] = closest != INFINITY;
+            }
+        });
+    };
+
+    printf("threads      time (ms)  Mrays/s  speedup\n");
+    double base = 0;
+    for (unsigned threads = 1; threads <= max_threads; threads++) {
+        ngn::jobs::init(threads - 1);
+        double time = best_time(cast);
+        ngn::jobs::shutdown();
+
+        if (threads == 1)
+            base = time;
+        printf("%7u %14.3f %8.2f %7.2fx\n", threads, time, RAY_COUNT / time / 1e3, base / time);
+    }
+    printf("%zu of %zu rays hit\n", static_cast<size_t>(std::count(hits.begin(), hits.end(), 1)), RAY_COUNT);
+    return 0;
+}
+
+static int benchmark_decode(int argc, char** argv)
+{
+    std::vector<std::string> directories { "assets/images", "assets/models/backpack" };
+    if (argc > 0)
+        directories.assign(argv, argv + argc);
+
+    // Every backend built in for the format of each image, flipped as textures are.
+    struct Total {
+        double milliseconds = 0;
+        double megapixels = 0;
+    };
+    std::map<std::string, Total> totals;
+    printf("%-44s %11s  %-14s %10s %8s\n", "image", "size", "decoder", "time (ms)", "MP/s");
+    for (auto& directory : directories) {
+        std::vector<std::filesystem::path> paths;
+        for (auto& entry : std::filesystem::directory_iterator(directory)) {
+            if (entry.is_regular_file())
+                paths.push_back(entry.path());
+        }
+        std::sort(paths.begin(), paths.end());
+
+        for (auto& path : paths) {
+            std::ifstream stream(path, std::ios::binary);
+            std::vector<char> contents((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+            auto* data = reinterpret_cast<const std::byte*>(contents.data());
+            ngn::ImageFormat format = ngn::detect_image_format(data, contents.size());
+            if (format == ngn::ImageFormat::Unknown)
+                continue;
+
+            for (auto* decoder : ngn::ImageDecoder::decoders(format)) {
+                ngn::Image image;
+                if (!decoder->decode(data, contents.size(), true, image)) {
+                    printf("%-44s %11s  %-14s failed\n", path.string().c_str(), "", decoder->name());
+                    continue;
+                }
+                double time = best_time([&] { decoder->decode(data, contents.size(), true, image); });
+                double megapixels = static_cast<double>(image.width) * image.height / 1e6;
+                printf("%-44s %5dx%-5d  %-14s %10.3f %8.1f\n", path.string().c_str(), image.width, image.height, decoder->name(), time, megapixels / time * 1e3);
+                totals[decoder->name()].milliseconds += time;
+                totals[decoder->name()].megapixels += megapixels;
+            }
+        }
+    }
+
+    for (auto& [name, total] : totals)
+        printf("%s: %.3f ms, %.1f MP/s\n", name.c_str(), total.milliseconds, total.megapixels / total.milliseconds * 1e3);
+    return 0;
+}
+
+int run_benchmark(const std::string& name, int argc, char** argv)
+{
+    if (name == "jobs")
+        return benchmark_jobs(argc, argv);
+    if (name == "import")
+        return benchmark_import(argc, argv);
+    if (name == "record")
+        return benchmark_record(argc, argv);
+    if (name == "rays")
+        return benchmark_rays(argc, argv);
+    if (name == "decode")
+        return benchmark_decode(argc, argv);
+
+    LOGERRF("Unknown benchmark \"%s\".", name.c_str());
+    return 1;
+}
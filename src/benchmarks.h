@@ -0,0 +1,10 @@
+#pragma once
+
+#include <string>
+
+/**
+ * @brief Runs the CPU-only benchmark {{name}}, without creating a window, and prints its results.
+ *
+ * @return The process exit code.
+ */
+int run_benchmark(const std::string& name, int argc, char** argv);
@@ -1,3 +1,5 @@
+#include "batch_renderer.h"
+#include "benchmarks.h"
 #include "ngn/ngn.h"
 
 #include <glad/glad.h>
@@ -9,7 +11,22 @@
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <map>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 struct ImGuiControls {
@@ -17,6 +34,7 @@ struct ImGuiControls {
         glm::vec3 color;
         float ambient_strength;
         float diffuse_strength;
+        glm::vec3 direction;
     } direction_light;
     struct {
         glm::vec3 color;
@@ -33,6 +51,180 @@ struct ImGuiControls {
     struct {
         float cubes_rotation_speed;
     } elements;
+    struct {
+        bool depth_prepass;
+        bool occlusion_culling;
+        /**
+         * @brief One of OcclusionMode.
+         */
+        int occlusion_mode;
+        /**
+         * @brief Draw the static scenery from the merged batches rather than mesh by mesh.
+         */
+        bool static_batching;
+    } rendering;
+    struct {
+        int count;
+        /**
+         * @brief Highest ngn::SimdLevel the transform kernel may use.
+         */
+        int simd_level;
+        /**
+         * @brief Frustum cull the instances in a compute shader, when GL 4.3 is available.
+         */
+        bool gpu_culling;
+    } instancing;
+    struct {
+        bool enable;
+        /**
+         * @brief One of TransparencyMode.
+         */
+        int mode;
+    } transparency;
+    struct {
+        bool enable;
+        /**
+         * @brief Set by the UI to re-render the static shadow casters on the next frame.
+         */
+        bool invalidate;
+    } shadows;
+    struct {
+        bool enable;
+        ngn::DynamicResolutionTarget target;
+    } dynamic_resolution;
+    struct {
+        /**
+         * @brief Busy work added to every simulated frame, standing in for game logic.
+         */
+        float simulation_ms;
+    } threading;
+    struct {
+        /**
+         * @brief One of ngn::SwapMode.
+         */
+        int swap_mode;
+        /**
+         * @brief Frame rate limit of the main thread, 0 for none.
+         */
+        float max_fps;
+        int max_frames_in_flight;
+    } pacing;
+};
+
+enum TransparencyMode : int {
+    Sorted,
+    WeightedBlended,
+};
+
+enum OcclusionMode : int {
+    CpuVisibility,
+    ConditionalRender,
+};
+
+/**
+ * @brief Written by the thread owning the GL context, published to the main thread once per frame.
+ */
+struct RenderStats {
+    float depth_prepass_ms;
+    /**
+     * @brief Last measured cost of the opaque colour pass, indexed by whether the depth pre-pass was enabled.
+     */
+    std::array<float, 2> shading_ms;
+    unsigned shadow_cascades_rendered;
+    float frame_ms;
+    int render_width;
+    int render_height;
+    ngn::GLState::Counters gl_calls;
+    ngn::OcclusionStats occlusion;
+    /**
+     * @brief Draw calls of the opaque colour pass, and static clusters it drew out of every merged one.
+     */
+    unsigned opaque_draw_calls;
+    unsigned static_clusters_drawn;
+    unsigned static_clusters;
+    ngn::FramePacingStats pacing;
+    /**
+     * @brief CPU time of the last frame, swap included, and of every frame so far.
+     */
+    float thread_ms;
+    double total_thread_ms;
+    size_t frames;
+};
+
+/**
+ * @brief Written by the main thread while it produces frames.
+ */
+struct SimulationStats {
+    size_t scene_nodes_updated;
+    size_t scene_nodes;
+    float instance_transforms_ms;
+    /**
+     * @brief Heap allocations of both threads, and frame arena usage of the main thread, over the previous frame.
+     */
+    size_t heap_allocations;
+    size_t frame_arena_bytes;
+    /**
+     * @brief Time the last frame waited for the frame rate limit.
+     */
+    float limiter_wait_ms;
+    /**
+     * @brief CPU time of the last frame, waits for a free snapshot or the limit excluded, and of every frame so far.
+     */
+    float thread_ms;
+    double total_thread_ms;
+    size_t frames;
+    /**
+     * @brief Result and cost of the last click on the scene.
+     */
+    std::optional<ngn::Scene::RayHit> picked;
+    float pick_ms;
+};
+
+/**
+ * @brief Copy of the ImGui draw data of a frame, for the render thread to draw while the next one is built.
+ */
+struct UiSnapshot {
+    ImDrawData draw_data;
+    /**
+     * @brief Reused from frame to frame: once grown, copying allocates nothing.
+     */
+    std::vector<std::unique_ptr<ImDrawList>> lists;
+};
+
+/**
+ * @brief Everything the render thread needs to draw a frame. The main thread fills it, then leaves it
+ * untouched until rendered.
+ */
+struct FrameSnapshot {
+    /**
+     * @brief Controls as they were when the frame was simulated.
+     */
+    ImGuiControls controls;
+    int width;
+    int height;
+    float current_time;
+    /**
+     * @brief When the input the camera was moved by was sampled.
+     */
+    std::chrono::steady_clock::time_point input_time;
+    glm::mat4 projection;
+    glm::mat4 view;
+    /**
+     * @brief Vertical field of view, in radians.
+     */
+    float fov;
+    glm::vec3 camera_position;
+    glm::vec3 camera_front;
+    /**
+     * @brief Every scene renderable, recorded by the job threads, sorted front to back by the render thread.
+     */
+    ngn::CommandList opaque_commands;
+    size_t instance_count;
+    /**
+     * @brief Model matrices of the instanced cubes, 16 floats each.
+     */
+    std::vector<float> instance_matrices;
+    UiSnapshot ui;
 };
 
 constexpr auto WINDOW_WIDTH = 800;
@@ -43,6 +235,25 @@ constexpr float MOUSE_SENSITIVITY = .1;
 
 constexpr float AMBIENT_STRENGTH = .1;
 
+constexpr size_t INSTANCE_GRAIN = 4096;
+constexpr size_t RECORD_GRAIN = 256;
+
+/**
+ * @brief The main thread simulates the next frame while the render thread draws the previous one.
+ */
+constexpr size_t SNAPSHOT_COUNT = 2;
+constexpr size_t MEASURE_WARMUP_FRAMES = 60;
+/**
+ * @brief Limits of the load controls, on the command line as in the UI.
+ */
+constexpr int MAX_INSTANCE_COUNT = 200000;
+constexpr float MAX_SIMULATION_MS = 30;
+
+constexpr double MIB = 1024 * 1024;
+
+// Units 0 to 2 are used by the material textures.
+constexpr int SHADOW_MAP_UNIT = 3;
+
 const std::vector<ngn::Vertex> cube_vertices {
     { { -0.5f, -0.5f, -0.5f }, { 0, 0, -1 }, { 0.0f, 0.0f } },
     { { 0.5f, 0.5f, -0.5f }, { 0, 0, -1 }, { 1.0f, 1.0f } },
@@ -110,6 +321,15 @@ const std::vector<glm::vec3> cube_positions {
     glm::vec3(-1.3f, 1.0f, -1.5f),
 };
 
+const std::vector<glm::vec3> transparent_cube_positions {
+    glm::vec3(0.5f, 0.3f, 1.2f),
+    glm::vec3(-0.8f, 0.2f, 0.6f),
+    glm::vec3(1.0f, -0.5f, 0.4f),
+    glm::vec3(-2.0f, 1.0f, -1.0f),
+    glm::vec3(0.0f, 1.2f, -0.5f),
+    glm::vec3(2.5f, 1.0f, -1.0f),
+};
+
 const std::vector<glm::vec3> point_light_positions = {
     glm::vec3(.7, .2, 2),
     glm::vec3(2.3, -3.3, -4),
@@ -128,25 +348,108 @@ float last_frame = 0;
 float last_x = WINDOW_WIDTH / 2.;
 float last_y = WINDOW_HEIGHT / 2.;
 
+/**
+ * @brief Set by a click on the scene, in window coordinates, for the main loop to pick under the cursor.
+ */
+bool pick_requested = false;
+glm::vec2 pick_cursor;
+
+void usage();
+bool parse_integer(const char* text, long min, long max, long& value);
+bool parse_float(const char* text, float min, float max, float& value);
 GLFWwindow* init_glfw();
 void init_imgui(GLFWwindow* window);
-void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void process_input(GLFWwindow* window);
 void mouse_callback(GLFWwindow* window, double position_x, double position_y);
 void scroll_callback(GLFWwindow* window, double offset_x, double offset_y);
 void click_callback(GLFWwindow* window, int input, int action, int mods);
+void set_material_samplers(const ngn::Shader& shader);
+void bind_material(const ngn::Mesh& mesh, const ngn::Shader& shader);
 void draw_mesh(const ngn::Mesh& mesh, const ngn::Shader& shader);
+void draw_mesh_instanced(const ngn::Mesh& mesh, const ngn::Shader& shader, size_t count);
 void draw_model(const ngn::Model& model, const ngn::Shader& shader);
 
-void draw_the_cubes(const ngn::Shader& shader, const ngn::Mesh& mesh, float current_time, const ImGuiControls& imgui_controls);
-void draw_the_transparent_cubes(const ngn::Shader& shader, const ngn::Mesh& mesh, float current_time, const ImGuiControls& imgui_controls);
-void display_imgui_controls(bool& is_open, ImGuiControls& imgui_controls);
+glm::quat cube_rotation(size_t index, float current_time, const ImGuiControls& imgui_controls);
+void record_renderables(ngn::CommandList& commands, const ngn::Scene& scene, const glm::vec3& camera_position, const glm::vec3& camera_front, const ngn::StaticBatches* batched);
+void draw_opaque_depth(const std::vector<ngn::DrawPacket>& draws, const ngn::Shader& shader, const ngn::OcclusionCuller* conditional);
+void draw_opaque(const std::vector<ngn::DrawPacket>& draws, const ngn::Shader& shader, const ngn::OcclusionCuller* conditional);
+void draw_shadow_casters(const std::vector<ngn::DrawPacket>& draws, const ngn::Shader& shader, bool is_static);
+unsigned draw_static_batches(const ngn::StaticBatches& batches, const ngn::Shader& shader, const glm::mat4* view_projection, bool depth_only, const ngn::OcclusionCuller* occlusion = nullptr);
+glm::mat4 transparent_cube_model_matrix(size_t index, float current_time, const ImGuiControls& imgui_controls);
+void draw_the_transparent_cubes(const ngn::Shader& shader, const ngn::Mesh& mesh, const FrameSnapshot& frame, std::vector<uint64_t>& sort_keys, std::vector<uint64_t>& sort_scratch);
+void draw_the_transparent_cubes_unsorted(const ngn::Shader& shader, const ngn::Mesh& mesh, const FrameSnapshot& frame);
+void animate_instances(ngn::TransformBatch& transforms, size_t begin, size_t end, float current_time, const ImGuiControls& imgui_controls);
+void simulate_load(float milliseconds);
+void set_point_light_constants(const ngn::Shader& shader);
+void set_lighting_uniforms(const ngn::Shader& shader, const FrameSnapshot& frame);
+void display_imgui_controls(bool& is_open, ImGuiControls& imgui_controls, const RenderStats& render_stats, const SimulationStats& simulation_stats);
+void copy_draw_data(const ImDrawData& source, UiSnapshot& snapshot);
 
 int main(int argc, char** argv)
 {
+    if (argc > 2 && std::string(argv[1]) == "--bench")
+        return run_benchmark(argv[2], argc - 3, argv + 3);
+    if (argc > 1 && std::string(argv[1]) == "--batch")
+        return run_batch(argc - 2, argv + 2);
+
+    // --single-threaded renders on the main thread, --measure N prints the throughput of N frames then
+    // exits, --instances N and --simulation-ms M make the scene CPU heavy. --capture PATH records the GL
+    // calls of --capture-frames N frames (1 by default), after the same warm-up as --measure, for the replayer.
+    bool single_threaded = false;
+    size_t measured_frames = 0;
+    int instance_count = 0;
+    float simulation_ms = 0;
+    std::string capture_path;
+    size_t capture_frames = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string_view argument = argv[i];
+        bool has_value = i + 1 < argc;
+        long integer = 0;
+        bool valid = true;
+        if (argument == "--single-threaded") {
+            single_threaded = true;
+        } else if (argument == "--measure" && has_value) {
+            valid = parse_integer(argv[++i], 1, LONG_MAX, integer);
+            measured_frames = integer;
+        } else if (argument == "--instances" && has_value) {
+            valid = parse_integer(argv[++i], 0, MAX_INSTANCE_COUNT, integer);
+            instance_count = integer;
+        } else if (argument == "--simulation-ms" && has_value) {
+            valid = parse_float(argv[++i], 0, MAX_SIMULATION_MS, simulation_ms);
+        } else if (argument == "--capture" && has_value) {
+            capture_path = argv[++i];
+        } else if (argument == "--capture-frames" && has_value) {
+            valid = parse_integer(argv[++i], 1, LONG_MAX, integer);
+            capture_frames = integer;
+        }
+        if (!valid) {
+            LOGERRF("Invalid value \"%s\" for %s.", argv[i], argv[i - 1]);
+            usage();
+            return 1;
+        }
+    }
+
     GLFWwindow* window = init_glfw();
+    // Before anything is created, so that the capture holds every resource its frames use.
+    if (!capture_path.empty())
+        ngn::GLCapture::begin(capture_path, MEASURE_WARMUP_FRAMES, capture_frames);
     init_imgui(window);
-
+    ngn::jobs::init();
+    // Without a pack, assets are read from the loose directory.
+    if (ngn::FileSystem::exists("assets.pack"))
+        ngn::FileSystem::mount("assets.pack");
+
+    // Submitted before the assets load, so the driver compiles meanwhile. Each is checked on first use.
+    ngn::ShaderLibrary shaders;
+    const ngn::Shader& lighted_shader = shaders.add("assets/shaders/light.vert", "assets/shaders/light_all.frag");
+    const ngn::Shader& light_source_shader = shaders.add("assets/shaders/light.vert", "assets/shaders/light_source.frag");
+    const ngn::Shader& white_shader = shaders.add("assets/shaders/light.vert", "assets/shaders/white.frag");
+    const ngn::Shader& depth_shader = shaders.add("assets/shaders/depth.vert", "assets/shaders/depth.frag");
+    const ngn::Shader& oit_shader = shaders.add("assets/shaders/light.vert", "assets/shaders/light_all_oit.frag");
+    const ngn::Shader& instanced_shader = shaders.add("assets/shaders/light_instanced.vert", "assets/shaders/light_all.frag");
+
+    std::optional<ngn::GpuMemory::Scope> cube_memory_scope;
+    cube_memory_scope.emplace("Cube meshes");
     ngn::Mesh light_mesh {
         cube_vertices,
         indices,
@@ -170,15 +473,40 @@ int main(int argc, char** argv)
             ngn::TexturePool::load("assets/images/black.png", ngn::TextureType::Emission),
         },
     };
+    cube_memory_scope.reset();
     LOG("Cube mesh loaded.");
 
     ngn::Model backpack_model { "assets/models/backpack/backpack.obj" };
 
+    ngn::TexturePool::pack();
+    LOGF("Textures packed in %zu arrays.", ngn::TexturePool::array_count());
+
+    ngn::Scene scene;
+    std::vector<ngn::Scene::Node> cube_nodes;
+    for (auto& cube_position : cube_positions) {
+        ngn::Scene::Node node = scene.create_node();
+        scene.set_translation(node, cube_position);
+        scene.attach(node, container_mesh);
+        cube_nodes.push_back(node);
+    }
+    ngn::Scene::Node backpack_node = scene.create_node();
+    scene.set_translation(backpack_node, { 5, 0, 0 });
+    // Never moves: its shadows are only rendered again when the light or the cascades change.
+    scene.set_static(backpack_node, true);
+    backpack_model.instantiate(scene, backpack_node);
+
+    // Static nodes never move, so their meshes are merged once in world space.
+    scene.update();
+    ngn::StaticBatches static_batches;
+    static_batches.build(scene);
+    LOGF("%zu static meshes merged in %zu batches.", static_batches.cluster_count(), static_batches.batches().size());
+
     ImGuiControls imgui_controls {
         .direction_light {
             .color { 1, 1, 1 },
             .ambient_strength = AMBIENT_STRENGTH,
-            .diffuse_strength = 1. },
+            .diffuse_strength = 1.,
+            .direction { -.2, -1, -.3 } },
         .point_light {
             .color { 1, 1, 1 },
             .diffuse_strength = 1. },
@@ -189,24 +517,71 @@ int main(int argc, char** argv)
         .material {
             .shininess = 32 },
         .elements {
-            .cubes_rotation_speed = 10 }
+            .cubes_rotation_speed = 10 },
+        .rendering {
+            .depth_prepass = false,
+            .occlusion_culling = false,
+            .occlusion_mode = OcclusionMode::CpuVisibility,
+            .static_batching = true },
+        .instancing {
+            .count = instance_count,
+            .simd_level = static_cast<int>(ngn::SimdLevel::AVX2),
+            .gpu_culling = false },
+        .transparency {
+            .enable = false,
+            .mode = TransparencyMode::Sorted },
+        .shadows {
+            .enable = true,
+            .invalidate = false },
+        .dynamic_resolution {
+            .enable = false,
+            .target {} },
+        .threading {
+            .simulation_ms = simulation_ms },
+        .pacing {
+            // Measures are of throughput, not of the display rate.
+            .swap_mode = static_cast<int>(measured_frames ? ngn::SwapMode::Off : ngn::SwapMode::VSync),
+            .max_fps = 0,
+            .max_frames_in_flight = 2 }
     };
 
-    ngn::Shader lighted_shader("assets/shaders/light.vert", "assets/shaders/light_all.frag");
-    ngn::Shader light_source_shader("assets/shaders/light.vert", "assets/shaders/light_source.frag");
-    ngn::Shader white_shader("assets/shaders/light.vert", "assets/shaders/white.frag");
-    LOG("Shaders loaded.");
-
-    glm::mat4 projection;
-
-    lighted_shader.use();
-    for (size_t i = 0; i < point_light_positions.size(); i++) {
-        lighted_shader.set(std::string("pointLights[") + std::to_string(i) + "].position", point_light_positions[i]);
-        lighted_shader.set(std::string("pointLights[") + std::to_string(i) + "].ambient", glm::vec3 { 0 });
-        lighted_shader.set(std::string("pointLights[") + std::to_string(i) + "].constant", 1.f);
-        lighted_shader.set(std::string("pointLights[") + std::to_string(i) + "].linear", .09f);
-        lighted_shader.set(std::string("pointLights[") + std::to_string(i) + "].quadratic", .032f);
+    LOGF("%zu / %zu shaders compiled while loading.", shaders.ready_count(), shaders.size());
+    LOGF("%u files opened while loading.", ngn::FileSystem::files_opened());
+    ngn::WeightedBlendedOIT weighted_blended_oit;
+    std::vector<uint64_t> transparent_sort_keys(transparent_cube_positions.size());
+    std::vector<uint64_t> transparent_sort_scratch(transparent_cube_positions.size());
+
+    ngn::GpuTimer depth_prepass_timer;
+    std::array<ngn::GpuTimer, 2> shading_timers;
+    std::vector<ngn::DrawPacket> visible_draws;
+    ngn::OcclusionCuller occlusion_culler;
+
+    ngn::CascadedShadowMap shadow_map({});
+
+    ngn::Framebuffer scene_framebuffer("Scene framebuffer");
+    ngn::DynamicResolution dynamic_resolution;
+    ngn::GpuTimer frame_timer;
+    ngn::FramePacer frame_pacer;
+
+    set_point_light_constants(lighted_shader);
+    set_point_light_constants(oit_shader);
+    set_point_light_constants(instanced_shader);
+    set_material_samplers(lighted_shader);
+    set_material_samplers(oit_shader);
+    set_material_samplers(instanced_shader);
+
+    ngn::TransformBatch instance_transforms;
+    ngn::InstanceBuffer instance_buffer;
+    instance_buffer.attach(container_mesh.VAO(), 3);
+    std::optional<ngn::GpuInstanceCuller> gpu_instance_culler;
+    if (ngn::GpuInstanceCuller::supported())
+        gpu_instance_culler.emplace();
+    LOGF("Transform kernels: %s.", ngn::to_string(ngn::detect_simd_level()));
+#ifndef NDEBUG
+    if (ngn::validate_compose_transforms()) {
+        LOG("Transform kernels match glm.");
     }
+#endif
 
     glm::mat4 lighted_model(1.0);
 
@@ -219,12 +594,34 @@ int main(int argc, char** argv)
     glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 #endif
 
-    // Main loop
-    while (!glfwWindowShouldClose(window)) {
-        process_input(window);
+    // Only the thread owning the GL context touches what this captures, apart from the snapshot queue,
+    // the published stats and the ImGui context, each behind its lock.
+    ngn::SnapshotQueue<FrameSnapshot> snapshots(SNAPSHOT_COUNT);
+    RenderStats render_stats {};
+    RenderStats published_render_stats {};
+    std::mutex render_stats_mutex;
+    std::mutex ui_mutex;
+
+    auto render_frame = [&](FrameSnapshot& frame) {
+        const ImGuiControls& controls = frame.controls;
+        frame_pacer.set_swap_mode(static_cast<ngn::SwapMode>(controls.pacing.swap_mode));
+        frame_pacer.begin_frame(controls.pacing.max_frames_in_flight);
+        auto render_start = std::chrono::steady_clock::now();
+        ngn::GLState::reset_counters();
+
+        // The scene renders offscreen at a scale of the window size, then gets upscaled before the UI.
+        float resolution_scale = 1;
+        if (controls.dynamic_resolution.enable)
+            resolution_scale = dynamic_resolution.update(render_stats.frame_ms, controls.dynamic_resolution.target);
+        int render_width = std::max(1, static_cast<int>(frame.width * resolution_scale));
+        int render_height = std::max(1, static_cast<int>(frame.height * resolution_scale));
+        render_stats.render_width = render_width;
+        render_stats.render_height = render_height;
+        scene_framebuffer.bind(render_width, render_height);
+        frame_timer.begin();
 
 #ifdef OUTLINE
-        glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+        ngn::GLState::stencil_op(GL_KEEP, GL_KEEP, GL_REPLACE);
 #endif
 
         // Draw
@@ -236,29 +633,15 @@ int main(int argc, char** argv)
 #endif
 
 #ifdef OUTLINE
-        glStencilMask(0x00);
+        ngn::GLState::stencil_mask(0x00);
 #endif
 
-        float current_time = glfwGetTime();
-        delta_time = current_time - last_frame;
-        last_frame = glfwGetTime();
-
-        // Temporary ?
-        int width, height;
-        glfwGetFramebufferSize(window, &width, &height);
-        //
-        projection = glm::perspective(glm::radians(camera.fov()), (float)width / (float)height, .1f, 100.f);
-
-        glm::mat4 view = camera.get_view_matrix();
-
-        glm::vec3 point_diffuse_color = imgui_controls.point_light.color * imgui_controls.point_light.diffuse_strength;
-        glm::vec3 dir_diffuse_color = imgui_controls.direction_light.color * imgui_controls.direction_light.diffuse_strength;
-
-        glm::vec3 ambient_color = glm::vec3 { imgui_controls.direction_light.ambient_strength };
+        glm::vec3 point_diffuse_color = controls.point_light.color * controls.point_light.diffuse_strength;
 
+        ngn::GLCapture::group("Light sources");
         light_source_shader.use();
-        light_source_shader.set("projection", projection);
-        light_source_shader.set("view", view);
+        light_source_shader.set("projection", frame.projection);
+        light_source_shader.set("view", frame.view);
         light_source_shader.set("color", point_diffuse_color);
 
         for (size_t i = 0; i < point_light_positions.size(); i++) {
@@ -267,79 +650,342 @@ int main(int argc, char** argv)
             glm::mat4 model(1);
             model = glm::translate(model, point_light_position);
             model = glm::scale(model, glm::vec3 { .2 });
-            light_source_shader.use();
             light_source_shader.set("model", model);
             draw_mesh(light_mesh, light_source_shader);
-
-            lighted_shader.use();
-            lighted_shader.set(std::string("pointLights[") + std::to_string(i) + "].diffuse", point_diffuse_color);
-            lighted_shader.set(std::string("pointLights[") + std::to_string(i) + "].specular", imgui_controls.point_light.color);
         }
 
-        lighted_shader.use();
-        lighted_shader.set("projection", projection);
+        set_lighting_uniforms(lighted_shader, frame);
         lighted_shader.set("model", lighted_model);
-        lighted_shader.set("view", view);
-        lighted_shader.set("viewPos", camera.position());
-        lighted_shader.set("material.shininess", imgui_controls.material.shininess);
-        lighted_shader.set("dirLight.direction", glm::vec3 { -.2, -1, -.3 });
-        lighted_shader.set("dirLight.ambient", ambient_color);
-        lighted_shader.set("dirLight.diffuse", dir_diffuse_color);
-        lighted_shader.set("dirLight.specular", imgui_controls.direction_light.color);
-        lighted_shader.set("spotLight.direction", camera.front());
-        lighted_shader.set("spotLight.position", camera.position());
-        lighted_shader.set("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-        lighted_shader.set("spotLight.outerCutOff", glm::cos(glm::radians(17.5f)));
-        lighted_shader.set("spotLight.ambient", glm::vec3 { 0 });
-        lighted_shader.set("spotLight.diffuse", imgui_controls.spot_light.color * imgui_controls.spot_light.diffuse_strength * static_cast<float>(imgui_controls.spot_light.enable));
-        lighted_shader.set("spotLight.specular", imgui_controls.spot_light.color * static_cast<float>(imgui_controls.spot_light.enable));
 
 #ifdef OUTLINE
-        glStencilFunc(GL_ALWAYS, 1, 0xFF); // all fragments should pass the stencil test
-        glStencilMask(0xFF);
+        ngn::GLState::stencil_func(GL_ALWAYS, 1, 0xFF); // all fragments should pass the stencil test
+        ngn::GLState::stencil_mask(0xFF);
 #endif
 
-        draw_the_cubes(lighted_shader, container_mesh, current_time, imgui_controls);
-        // draw_the_transparent_cubes(lighted_shader, glass_cube, current_time, imgui_controls);
+        // Shadow casters are drawn from every draw, the camera passes only from the visible ones.
+        frame.opaque_commands.sort();
+        const std::vector<ngn::DrawPacket>& opaque_draws = frame.opaque_commands.sorted();
+        bool occlusion_culling = controls.rendering.occlusion_culling;
+        bool static_batching = controls.rendering.static_batching;
+        glm::mat4 view_projection = frame.projection * frame.view;
+        const std::vector<ngn::DrawPacket>* camera_draws = &opaque_draws;
+        const ngn::OcclusionCuller* conditional = nullptr;
+        // Batched clusters are culled on the CPU side results in either mode.
+        const ngn::OcclusionCuller* cluster_occlusion = occlusion_culling ? &occlusion_culler : nullptr;
+        if (occlusion_culling) {
+            occlusion_culler.begin_frame();
+            if (controls.rendering.occlusion_mode == OcclusionMode::ConditionalRender) {
+                conditional = &occlusion_culler;
+            } else {
+                visible_draws.clear();
+                std::copy_if(opaque_draws.begin(), opaque_draws.end(), std::back_inserter(visible_draws), [&](const ngn::DrawPacket& draw) {
+                    return occlusion_culler.is_visible(draw.object);
+                });
+                camera_draws = &visible_draws;
+            }
+        }
+
+        ngn::GLCapture::group("Shadows");
+        if (controls.shadows.invalidate)
+            shadow_map.invalidate();
+        if (controls.shadows.enable) {
+            shadow_map.update(frame.view, frame.fov, (float)frame.width / (float)frame.height, .1f, controls.direction_light.direction,
+                [&](const ngn::Shader& shader) {
+                    draw_shadow_casters(opaque_draws, shader, true);
+                    if (static_batching)
+                        draw_static_batches(static_batches, shader, nullptr, true);
+                },
+                [&](const ngn::Shader& shader) { draw_shadow_casters(opaque_draws, shader, false); });
+            scene_framebuffer.bind(render_width, render_height);
+            render_stats.shadow_cascades_rendered = shadow_map.cascades_rendered();
+        }
+        lighted_shader.use();
+        shadow_map.apply(lighted_shader, SHADOW_MAP_UNIT);
+
+        bool depth_prepass = controls.rendering.depth_prepass;
+        if (depth_prepass) {
+            ngn::GLCapture::group("Depth pre-pass");
+            // Lay down depth only, so the expensive lighting runs once per pixel.
+            depth_shader.use();
+            depth_shader.set("projection", frame.projection);
+            depth_shader.set("view", frame.view);
+            ngn::GLState::color_mask(false);
+            depth_prepass_timer.begin();
+            draw_opaque_depth(*camera_draws, depth_shader, conditional);
+            if (static_batching)
+                draw_static_batches(static_batches, depth_shader, &view_projection, true, cluster_occlusion);
+            depth_prepass_timer.end();
+            ngn::GLState::color_mask(true);
+            ngn::GLState::depth_func(GL_EQUAL);
+            ngn::GLState::depth_mask(false);
+            render_stats.depth_prepass_ms = depth_prepass_timer.milliseconds();
+        }
+
+        ngn::GLCapture::group("Opaque");
+        lighted_shader.use();
+        shading_timers[depth_prepass].begin();
+        draw_opaque(*camera_draws, lighted_shader, conditional);
+        render_stats.opaque_draw_calls = camera_draws->size();
+        render_stats.static_clusters_drawn = 0;
+        render_stats.static_clusters = static_batches.cluster_count();
+        if (static_batching) {
+            render_stats.static_clusters_drawn = draw_static_batches(static_batches, lighted_shader, &view_projection, false, cluster_occlusion);
+            render_stats.opaque_draw_calls += static_batches.batches().size();
+        }
+        shading_timers[depth_prepass].end();
+        render_stats.shading_ms[depth_prepass] = shading_timers[depth_prepass].milliseconds();
+
+        if (depth_prepass) {
+            ngn::GLState::depth_func(GL_LESS);
+            ngn::GLState::depth_mask(true);
+        }
+
+        if (occlusion_culling) {
+            ngn::GLCapture::group("Occlusion queries");
+            // Every object is tested, hidden ones included, against the depth of what was drawn.
+            occlusion_culler.begin_queries(frame.projection, frame.view, frame.camera_position, .1f);
+            for (auto& draw : opaque_draws)
+                occlusion_culler.query(draw.object, draw.model, draw.mesh->bounds());
+            // Clusters go by the index of the renderable they merged, which is no longer drawn on its own.
+            if (static_batching) {
+                for (auto& batch : static_batches.batches()) {
+                    for (auto& cluster : batch.clusters)
+                        occlusion_culler.query(cluster.renderable, glm::mat4(1), cluster.bounds);
+                }
+            }
+            occlusion_culler.end_queries();
+            render_stats.occlusion = occlusion_culler.stats();
+        }
 
 #ifdef OUTLINE
         white_shader.use();
-        white_shader.set("projection", projection);
-        white_shader.set("view", view);
+        white_shader.set("projection", frame.projection);
+        white_shader.set("view", frame.view);
 
-        glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-        glStencilMask(0x00); // disable writing to the stencil buffer
-        glDisable(GL_DEPTH_TEST);
+        ngn::GLState::stencil_func(GL_NOTEQUAL, 1, 0xFF);
+        ngn::GLState::stencil_mask(0x00); // disable writing to the stencil buffer
+        ngn::GLState::set_enabled(GL_DEPTH_TEST, false);
         white_shader.use();
-        for (size_t i = 0; i < cube_positions.size(); i++) {
-            glm::mat4 model(1);
-            model = glm::translate(model, cube_positions[i]);
-            float angle = 20.0f * i;
-            model = glm::rotate(model, current_time * glm::radians(imgui_controls.elements.cubes_rotation_speed * (i + 1)) + glm::radians(angle), { 1.f, .3f, .5f });
-            model = glm::scale(model, glm::vec3 { 1.1 });
+        for (auto& draw : opaque_draws) {
+            if (draw.mesh != &container_mesh)
+                continue;
+            glm::mat4 model = glm::scale(draw.model, glm::vec3 { 1.1 });
             white_shader.set("model", model);
             draw_mesh(container_mesh, white_shader);
         }
-        glStencilMask(0xFF);
-        glStencilFunc(GL_ALWAYS, 1, 0xFF);
-        glEnable(GL_DEPTH_TEST);
+        ngn::GLState::stencil_mask(0xFF);
+        ngn::GLState::stencil_func(GL_ALWAYS, 1, 0xFF);
+        ngn::GLState::set_enabled(GL_DEPTH_TEST, true);
 #endif
 
-        glm::mat4 backpack_model_matrix { 1 };
-        backpack_model_matrix = glm::translate(backpack_model_matrix, { 5, 0, 0 });
-        lighted_shader.use();
-        lighted_shader.set("model", backpack_model_matrix);
-        draw_model(backpack_model, lighted_shader);
+        size_t instance_count = frame.instance_count;
+        if (instance_count > 0) {
+            ngn::GLCapture::group("Instances");
+            // With GPU culling the matrices go to the culler, which packs the visible ones into the instance buffer.
+            bool gpu_culling = controls.instancing.gpu_culling && gpu_instance_culler;
+            float* instance_matrices = gpu_culling ? gpu_instance_culler->map(instance_count) : instance_buffer.map(instance_count);
+            std::memcpy(instance_matrices, frame.instance_matrices.data(), instance_count * 16 * sizeof(float));
+            if (gpu_culling)
+                gpu_instance_culler->unmap();
+            else
+                instance_buffer.unmap();
+
+            if (gpu_culling)
+                gpu_instance_culler->cull(view_projection, container_mesh, instance_count, instance_buffer);
+            set_lighting_uniforms(instanced_shader, frame);
+            shadow_map.apply(instanced_shader, SHADOW_MAP_UNIT);
+            if (gpu_culling) {
+                bind_material(container_mesh, instanced_shader);
+                gpu_instance_culler->draw(container_mesh);
+            } else {
+                draw_mesh_instanced(container_mesh, instanced_shader, instance_count);
+            }
+        }
 
-        glBindVertexArray(0);
+        if (controls.transparency.enable) {
+            ngn::GLCapture::group("Transparency");
+            if (controls.transparency.mode == TransparencyMode::WeightedBlended) {
+                set_lighting_uniforms(oit_shader, frame);
+                weighted_blended_oit.begin(scene_framebuffer.id(), render_width, render_height);
+                draw_the_transparent_cubes_unsorted(oit_shader, glass_cube, frame);
+                weighted_blended_oit.end();
+                weighted_blended_oit.composite();
+            } else {
+                lighted_shader.use();
+                ngn::GLState::depth_mask(false);
+                draw_the_transparent_cubes(lighted_shader, glass_cube, frame, transparent_sort_keys, transparent_sort_scratch);
+                ngn::GLState::depth_mask(true);
+            }
+        }
 
-        display_imgui_controls(is_material_controls_open, imgui_controls);
+        frame_timer.end();
+        render_stats.frame_ms = frame_timer.milliseconds();
+        render_stats.gl_calls = ngn::GLState::counters();
+        ngn::GLCapture::group("Upscale");
+        scene_framebuffer.upscale(render_width, render_height, 0, frame.width, frame.height);
+
+        {
+            std::lock_guard lock(ui_mutex);
+            ImGui_ImplOpenGL3_NewFrame();
+            ImGui_ImplOpenGL3_RenderDrawData(&frame.ui.draw_data);
+        }
 
         // After draw
+        ngn::GLCapture::end_frame(frame.width, frame.height);
         glfwSwapBuffers(window);
+        frame_pacer.end_frame(frame.input_time);
+        render_stats.pacing = frame_pacer.stats();
+
+        std::chrono::duration<float, std::milli> render_duration = std::chrono::steady_clock::now() - render_start;
+        render_stats.thread_ms = render_duration.count();
+        render_stats.total_thread_ms += render_stats.thread_ms;
+        render_stats.frames++;
+        {
+            std::lock_guard lock(render_stats_mutex);
+            published_render_stats = render_stats;
+        }
+        ngn::frame_arena().reset();
+    };
+
+    // The context moves to the render thread, which draws each snapshot as soon as it is submitted.
+    std::thread render_thread;
+    if (!single_threaded) {
+        glfwMakeContextCurrent(nullptr);
+        render_thread = std::thread([&] {
+            glfwMakeContextCurrent(window);
+            while (FrameSnapshot* frame = snapshots.acquire_read()) {
+                render_frame(*frame);
+                snapshots.release();
+            }
+            glfwMakeContextCurrent(nullptr);
+        });
+    }
+
+    SimulationStats simulation_stats {};
+    std::chrono::steady_clock::time_point measure_start;
+    SimulationStats measure_start_simulation {};
+    RenderStats measure_start_render {};
+
+    // Main loop
+    while (!glfwWindowShouldClose(window)) {
+        // Waits while the render thread is still busy with every other snapshot.
+        FrameSnapshot* frame = snapshots.acquire_write();
+        simulation_stats.limiter_wait_ms = frame_pacer.limit(imgui_controls.pacing.max_fps);
+        auto simulation_start = std::chrono::steady_clock::now();
+        size_t heap_allocations_start = ngn::heap_allocation_count();
+        ngn::jobs::pump_main();
+
+        // What does not depend on input is simulated first, so that input is sampled as late as possible
+        // before the frame is submitted.
+        float current_time = glfwGetTime();
+        frame->current_time = current_time;
+
+        for (size_t i = 0; i < cube_nodes.size(); i++)
+            scene.set_rotation(cube_nodes[i], cube_rotation(i, current_time, imgui_controls));
+        simulation_stats.scene_nodes_updated = scene.update();
+        simulation_stats.scene_nodes = scene.size();
+
+        size_t instance_count = imgui_controls.instancing.count;
+        frame->instance_count = instance_count;
+        if (instance_count > 0) {
+            instance_transforms.resize(instance_count);
+            frame->instance_matrices.resize(instance_count * 16);
+            float* instance_matrices = frame->instance_matrices.data();
+            auto simd_level = static_cast<ngn::SimdLevel>(imgui_controls.instancing.simd_level);
+
+            auto transforms_start = std::chrono::steady_clock::now();
+            ngn::jobs::parallel_for(0, instance_count, INSTANCE_GRAIN, [&](size_t begin, size_t end) {
+                animate_instances(instance_transforms, begin, end, current_time, imgui_controls);
+                ngn::compose_transforms(instance_transforms, begin, end, instance_matrices, simd_level);
+            });
+            std::chrono::duration<float, std::milli> transforms_duration = std::chrono::steady_clock::now() - transforms_start;
+            simulation_stats.instance_transforms_ms = transforms_duration.count();
+        }
+
+        simulate_load(imgui_controls.threading.simulation_ms);
+
         glfwPollEvents();
+        frame->input_time = std::chrono::steady_clock::now();
+        float input_time = glfwGetTime();
+        delta_time = input_time - last_frame;
+        last_frame = input_time;
+        process_input(window);
+
+        glfwGetFramebufferSize(window, &frame->width, &frame->height);
+        frame->fov = glm::radians(camera.fov());
+        frame->projection = glm::perspective(frame->fov, (float)frame->width / (float)frame->height, .1f, 100.f);
+        frame->view = camera.get_view_matrix();
+        frame->camera_position = camera.position();
+        frame->camera_front = camera.front();
+
+        if (pick_requested) {
+            int window_width, window_height;
+            glfwGetWindowSize(window, &window_width, &window_height);
+            auto pick_start = std::chrono::steady_clock::now();
+            simulation_stats.picked = scene.raycast(camera.screen_ray(pick_cursor, glm::vec2(window_width, window_height)));
+            std::chrono::duration<float, std::milli> pick_duration = std::chrono::steady_clock::now() - pick_start;
+            simulation_stats.pick_ms = pick_duration.count();
+            pick_requested = false;
+        }
+
+        record_renderables(frame->opaque_commands, scene, frame->camera_position, frame->camera_front,
+            imgui_controls.rendering.static_batching ? &static_batches : nullptr);
+
+        frame->controls = imgui_controls;
+        imgui_controls.shadows.invalidate = false;
+
+        RenderStats displayed_render_stats;
+        {
+            std::lock_guard lock(render_stats_mutex);
+            displayed_render_stats = published_render_stats;
+        }
+        {
+            std::lock_guard lock(ui_mutex);
+            display_imgui_controls(is_material_controls_open, imgui_controls, displayed_render_stats, simulation_stats);
+            copy_draw_data(*ImGui::GetDrawData(), frame->ui);
+        }
+
+        std::chrono::duration<float, std::milli> simulation_duration = std::chrono::steady_clock::now() - simulation_start;
+        simulation_stats.thread_ms = simulation_duration.count();
+        simulation_stats.total_thread_ms += simulation_stats.thread_ms;
+        simulation_stats.frames++;
+        snapshots.submit();
+
+        if (single_threaded) {
+            render_frame(*snapshots.acquire_read());
+            snapshots.release();
+        }
+
+        // Transient data only lives until here.
+        simulation_stats.heap_allocations = ngn::heap_allocation_count() - heap_allocations_start;
+        simulation_stats.frame_arena_bytes = ngn::frame_arena().used();
+        ngn::frame_arena().reset();
+
+        if (measured_frames && simulation_stats.frames == MEASURE_WARMUP_FRAMES) {
+            measure_start = std::chrono::steady_clock::now();
+            measure_start_simulation = simulation_stats;
+            measure_start_render = displayed_render_stats;
+        } else if (measured_frames && simulation_stats.frames == MEASURE_WARMUP_FRAMES + measured_frames) {
+            std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - measure_start;
+            size_t simulated = simulation_stats.frames - measure_start_simulation.frames;
+            size_t rendered = std::max<size_t>(displayed_render_stats.frames - measure_start_render.frames, 1);
+            printf("%s: %zu frames in %.3f s, %.1f fps, main thread %.3f ms, render thread %.3f ms per frame\n",
+                single_threaded ? "single threaded" : "render thread", simulated, seconds.count(), simulated / seconds.count(),
+                (simulation_stats.total_thread_ms - measure_start_simulation.total_thread_ms) / simulated,
+                (displayed_render_stats.total_thread_ms - measure_start_render.total_thread_ms) / rendered);
+            glfwSetWindowShouldClose(window, true);
+        }
+    }
+
+    // Let the render thread draw what was submitted, then take the context back to release the GL objects.
+    snapshots.close();
+    if (render_thread.joinable()) {
+        render_thread.join();
+        glfwMakeContextCurrent(window);
     }
+    ngn::GLCapture::finish();
 
+    ngn::jobs::shutdown();
     glfwDestroyWindow(window);
     glfwTerminate();
     LOG("GLFW terminated. Exiting...");
@@ -389,8 +1035,6 @@ GLFWwindow* init_glfw()
 
     // Viewport
     glViewport(0, 0, 800, 600);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    LOG("Framebuffer size callback set.");
 
     // Mouse
     glfwSetCursorPosCallback(window, mouse_callback);
@@ -399,20 +1043,20 @@ GLFWwindow* init_glfw()
     LOG("Mouse callbacks set.");
 
     // Enable z sorting
-    glEnable(GL_DEPTH_TEST);
+    ngn::GLState::set_enabled(GL_DEPTH_TEST, true);
     LOG("Depth test enabled.");
 
     // Stencil test
 #ifdef OUTLINE
-    glEnable(GL_STENCIL_TEST);
+    ngn::GLState::set_enabled(GL_STENCIL_TEST, true);
 #endif
 
     // Blend
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    ngn::GLState::set_enabled(GL_BLEND, true);
+    ngn::GLState::blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     // Face culling
-    glEnable(GL_CULL_FACE);
+    ngn::GLState::set_enabled(GL_CULL_FACE, true);
     glCullFace(GL_BACK);
     glFrontFace(GL_CCW);
     return window;
@@ -433,11 +1077,8 @@ void init_imgui(GLFWwindow* window)
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330 core");
     ImGui::StyleColorsDark();
-}
-
-void framebuffer_size_callback(GLFWwindow* window, int width, int height)
-{
-    glViewport(0, 0, width, height);
+    // Creates the device objects while this thread still owns the context.
+    ImGui_ImplOpenGL3_NewFrame();
 }
 
 void process_input(GLFWwindow* window)
@@ -487,36 +1128,46 @@ void click_callback(GLFWwindow* window, int input, int action, int mods)
         glfwGetCursorPos(window, &position_x, &position_y);
         last_x = position_x;
         last_y = position_y;
+    } else if (input == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS && glfwGetInputMode(window, GLFW_CURSOR) == GLFW_CURSOR_NORMAL && !ImGui::GetIO().WantCaptureMouse) {
+        double position_x, position_y;
+        glfwGetCursorPos(window, &position_x, &position_y);
+        pick_cursor = glm::vec2(position_x, position_y);
+        pick_requested = true;
     }
 }
 
-void draw_mesh(const ngn::Mesh& mesh, const ngn::Shader& shader)
+void set_material_samplers(const ngn::Shader& shader)
 {
-    // unsigned int diffuse_number = 1;
-    // unsigned int specular_number = 1;
-    // unsigned int emission_number = 1;
-    auto& textures = mesh.textures();
-    for (int i = 0; i < textures.size(); i++) {
-        glActiveTexture(GL_TEXTURE0 + i);
-        // std::string number;
-        std::string name = ngn::TextureType::to_string(textures[i].type());
-        // if (name == "diffuse")
-        //     number = std::to_string(diffuse_number++);
-        // else if (name == "specular")
-        //     number = std::to_string(specular_number++);
-        // else if (name == "emission")
-        //     number = std::to_string(specular_number++);
-
-        shader.set(("material." + name).c_str(), i);
-        // shader.set(("material." + name + number).c_str(), i);
-        glBindTexture(GL_TEXTURE_2D, textures[i].id());
+    shader.use();
+    for (int type : { ngn::TextureType::Diffuse, ngn::TextureType::Specular, ngn::TextureType::Emission })
+        shader.set(std::string("material.") + ngn::TextureType::to_string(static_cast<ngn::TextureType::Value>(type)), type);
+}
+
+void bind_material(const ngn::Mesh& mesh, const ngn::Shader& shader)
+{
+    // Samplers are set once per shader: a unit per texture type. Packed textures share arrays,
+    // so switching material is mostly a matter of layer uniforms.
+    for (auto& texture : mesh.textures()) {
+        ngn::GLState::bind_texture(texture.type(), GL_TEXTURE_2D_ARRAY, texture.id());
+        shader.set(ngn::frame_arena().format("material.%sLayer", ngn::TextureType::to_string(texture.type())), static_cast<float>(texture.layer()));
     }
-    glActiveTexture(GL_TEXTURE0);
+}
+
+void draw_mesh(const ngn::Mesh& mesh, const ngn::Shader& shader)
+{
+    bind_material(mesh, shader);
 
     // draw mesh
-    glBindVertexArray(mesh.VAO());
+    ngn::GLState::bind_vertex_array(mesh.VAO());
     glDrawElements(GL_TRIANGLES, mesh.indices().size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+}
+
+void draw_mesh_instanced(const ngn::Mesh& mesh, const ngn::Shader& shader, size_t count)
+{
+    bind_material(mesh, shader);
+
+    ngn::GLState::bind_vertex_array(mesh.VAO());
+    glDrawElementsInstanced(GL_TRIANGLES, mesh.indices().size(), GL_UNSIGNED_INT, 0, count);
 }
 
 void draw_model(const ngn::Model& model, const ngn::Shader& shader)
@@ -525,10 +1176,9 @@ void draw_model(const ngn::Model& model, const ngn::Shader& shader)
         draw_mesh(mesh, shader);
 }
 
-void display_imgui_controls(bool& is_open, ImGuiControls& imgui_controls)
+void display_imgui_controls(bool& is_open, ImGuiControls& imgui_controls, const RenderStats& render_stats, const SimulationStats& simulation_stats)
 {
-    // Start the Dear ImGui frame
-    ImGui_ImplOpenGL3_NewFrame();
+    // Start the Dear ImGui frame, drawn later by the thread owning the context
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
 
@@ -551,6 +1201,7 @@ void display_imgui_controls(bool& is_open, ImGuiControls& imgui_controls)
             ImGui::ColorEdit3("Color", glm::value_ptr(imgui_controls.direction_light.color));
             ImGui::SliderFloat("Diffuse strength", &imgui_controls.direction_light.diffuse_strength, 0, 1);
             ImGui::SliderFloat("Ambient strength", &imgui_controls.direction_light.ambient_strength, 0, 1);
+            ImGui::DragFloat3("Direction", glm::value_ptr(imgui_controls.direction_light.direction), .01f, -1, 1);
         }
 
         if (ImGui::CollapsingHeader("Point Lights")) {
@@ -572,41 +1223,352 @@ void display_imgui_controls(bool& is_open, ImGuiControls& imgui_controls)
             ImGui::DragFloat("Cubes rotation speed", &imgui_controls.elements.cubes_rotation_speed);
         }
 
+        if (ImGui::CollapsingHeader("Rendering")) {
+            ImGui::Text("Scene nodes updated: %zu / %zu", simulation_stats.scene_nodes_updated, simulation_stats.scene_nodes);
+            ImGui::Checkbox("Depth pre-pass", &imgui_controls.rendering.depth_prepass);
+            ImGui::Text("Depth pre-pass: %.3f ms", render_stats.depth_prepass_ms);
+            ImGui::Text("Shading with pre-pass: %.3f ms", render_stats.shading_ms[true]);
+            ImGui::Text("Shading without pre-pass: %.3f ms", render_stats.shading_ms[false]);
+            ImGui::Checkbox("Occlusion culling", &imgui_controls.rendering.occlusion_culling);
+            ImGui::RadioButton("CPU visibility", &imgui_controls.rendering.occlusion_mode, OcclusionMode::CpuVisibility);
+            ImGui::SameLine();
+            ImGui::RadioButton("Conditional render", &imgui_controls.rendering.occlusion_mode, OcclusionMode::ConditionalRender);
+            ImGui::Text("Occlusion: %u visible, %u occluded of %u tested", render_stats.occlusion.visible, render_stats.occlusion.occluded, render_stats.occlusion.tested);
+            ImGui::Checkbox("Static batching", &imgui_controls.rendering.static_batching);
+            ImGui::Text("Opaque draw calls: %u, static clusters drawn: %u / %u", render_stats.opaque_draw_calls, render_stats.static_clusters_drawn, render_stats.static_clusters);
+            ImGui::Text("Texture arrays: %zu", ngn::TexturePool::array_count());
+            ImGui::Text("GL state calls: %zu issued, %zu elided", render_stats.gl_calls.issued, render_stats.gl_calls.elided);
+            ImGui::Text("Heap allocations: %zu, frame arena: %.1f KiB", simulation_stats.heap_allocations, simulation_stats.frame_arena_bytes / 1024.);
+        }
+
+        if (ImGui::CollapsingHeader("Instancing")) {
+            const char* simd_levels[] = { "Scalar", "SSE", "AVX2" };
+            ImGui::SliderInt("Instanced cubes", &imgui_controls.instancing.count, 0, MAX_INSTANCE_COUNT);
+            ImGui::Combo("Transform kernel", &imgui_controls.instancing.simd_level, simd_levels, 3);
+            if (ngn::GpuInstanceCuller::supported())
+                ImGui::Checkbox("GPU frustum culling", &imgui_controls.instancing.gpu_culling);
+            else
+                ImGui::Text("GPU frustum culling needs GL 4.3");
+            ImGui::Text("Supported: %s", ngn::to_string(ngn::detect_simd_level()));
+            ImGui::Text("Animation and transforms: %.3f ms on %u threads", simulation_stats.instance_transforms_ms, ngn::jobs::worker_count() + 1);
+        }
+
+        if (ImGui::CollapsingHeader("Transparency")) {
+            ImGui::Checkbox("Transparent cubes", &imgui_controls.transparency.enable);
+            ImGui::RadioButton("Sorted", &imgui_controls.transparency.mode, TransparencyMode::Sorted);
+            ImGui::SameLine();
+            ImGui::RadioButton("Weighted blended OIT", &imgui_controls.transparency.mode, TransparencyMode::WeightedBlended);
+        }
+
+        if (ImGui::CollapsingHeader("Shadows")) {
+            ImGui::Checkbox("Directional light shadows", &imgui_controls.shadows.enable);
+            ImGui::Text("Static cascades re-rendered: %u / %u", render_stats.shadow_cascades_rendered, ngn::CascadedShadowMap::CASCADE_COUNT);
+            if (ImGui::Button("Invalidate static cache"))
+                imgui_controls.shadows.invalidate = true;
+        }
+
+        if (ImGui::CollapsingHeader("Dynamic Resolution")) {
+            auto& target = imgui_controls.dynamic_resolution.target;
+            ImGui::Checkbox("Dynamic resolution", &imgui_controls.dynamic_resolution.enable);
+            ImGui::SliderFloat("Target frame time (ms)", &target.frame_milliseconds, 4, 50);
+            ImGui::SliderFloat("Min scale", &target.min_scale, .25, 1);
+            ImGui::SliderFloat("Max scale", &target.max_scale, target.min_scale, 1);
+            ImGui::Text("GPU frame: %.3f ms", render_stats.frame_ms);
+            ImGui::Text("Render resolution: %dx%d", render_stats.render_width, render_stats.render_height);
+        }
+
+        if (ImGui::CollapsingHeader("Picking")) {
+            ImGui::Text("Click the scene to pick, Ctrl+click to look around.");
+            if (auto& picked = simulation_stats.picked) {
+                ImGui::Text("Node %u, triangle %u, at %.2f", picked->node, picked->triangle.triangle, picked->triangle.distance);
+                ImGui::Text("Barycentrics: %.3f, %.3f", picked->triangle.barycentrics.x, picked->triangle.barycentrics.y);
+                ImGui::Text("Mesh BVH: %zu nodes over %zu triangles", picked->mesh->bvh().node_count(), picked->mesh->bvh().triangle_count());
+            } else {
+                ImGui::Text("Nothing picked.");
+            }
+            ImGui::Text("Ray query: %.3f ms", simulation_stats.pick_ms);
+        }
+
+        if (ImGui::CollapsingHeader("Threading")) {
+            ImGui::SliderFloat("Simulation load (ms)", &imgui_controls.threading.simulation_ms, 0, MAX_SIMULATION_MS);
+            ImGui::Text("Main thread: %.3f ms", simulation_stats.thread_ms);
+            ImGui::Text("Render thread: %.3f ms", render_stats.thread_ms);
+            ImGui::Text("Frame rate: %.1f fps", ImGui::GetIO().Framerate);
+        }
+
+        if (ImGui::CollapsingHeader("Frame Pacing")) {
+            const ngn::FramePacingStats& pacing = render_stats.pacing;
+            ImGui::RadioButton("VSync", &imgui_controls.pacing.swap_mode, static_cast<int>(ngn::SwapMode::VSync));
+            ImGui::SameLine();
+            ImGui::RadioButton("Adaptive", &imgui_controls.pacing.swap_mode, static_cast<int>(ngn::SwapMode::Adaptive));
+            ImGui::SameLine();
+            ImGui::RadioButton("Off", &imgui_controls.pacing.swap_mode, static_cast<int>(ngn::SwapMode::Off));
+            ImGui::SliderFloat("Max fps (0 for none)", &imgui_controls.pacing.max_fps, 0, 240);
+            ImGui::SliderInt("Max frames in flight", &imgui_controls.pacing.max_frames_in_flight, 1, ngn::FramePacer::MAX_FRAMES_IN_FLIGHT);
+            ImGui::Text("Input to GPU done: %.2f ms (average %.2f ms)", pacing.latency_ms, pacing.average_latency_ms);
+            ImGui::Text("Frame interval: %.2f ms, jitter %.2f ms", pacing.interval_ms, pacing.jitter_ms);
+            ImGui::Text("Frames in flight: %u, GPU wait %.3f ms", pacing.frames_in_flight, pacing.gpu_wait_ms);
+            ImGui::Text("Limiter wait: %.3f ms", simulation_stats.limiter_wait_ms);
+        }
+
+        if (ImGui::CollapsingHeader("GPU Memory")) {
+            ImGui::Text("Total: %.1f MiB", ngn::GpuMemory::total() / MIB);
+            for (int i = 0; i < ngn::GpuMemory::CATEGORY_COUNT; i++) {
+                auto category = static_cast<ngn::GpuMemory::Category>(i);
+                float budget = ngn::GpuMemory::budget(category) / MIB;
+                ImGui::PushID(i);
+                ImGui::Text("%s: %.1f MiB", ngn::GpuMemory::to_string(category), ngn::GpuMemory::used(category) / MIB);
+                if (ImGui::DragFloat("Budget (MiB, 0 for none)", &budget, 1, 0, 65536))
+                    ngn::GpuMemory::set_budget(category, static_cast<size_t>(budget * MIB));
+                ImGui::PopID();
+            }
+            if (ImGui::TreeNode("By owner")) {
+                std::pmr::map<std::string_view, size_t> owners(&ngn::frame_arena());
+                ngn::GpuMemory::visit_allocations([&owners](const ngn::GpuMemory::Allocation& allocation) {
+                    owners[allocation.owner] += allocation.bytes;
+                });
+                for (auto& [owner, bytes] : owners)
+                    ImGui::Text("%.*s: %.2f MiB", static_cast<int>(owner.size()), owner.data(), bytes / MIB);
+                ImGui::TreePop();
+            }
+        }
+
         ImGui::End();
     }
 
     ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
-void draw_the_cubes(const ngn::Shader& shader, const ngn::Mesh& mesh, float current_time, const ImGuiControls& imgui_controls)
+template <class T>
+void copy_vector(const ImVector<T>& source, ImVector<T>& destination)
 {
-    for (size_t i = 0; i < cube_positions.size(); i++) {
-        glm::mat4 model(1);
-        model = glm::translate(model, cube_positions[i]);
-        float angle = 20.0f * i;
-        model = glm::rotate(model, current_time * glm::radians(imgui_controls.elements.cubes_rotation_speed * (i + 1)) + glm::radians(angle), { 1.f, .3f, .5f });
-        shader.set("model", model);
-        draw_mesh(mesh, shader);
+    destination.resize(source.Size);
+    if (source.Size > 0)
+        std::memcpy(destination.Data, source.Data, source.Size * sizeof(T));
+}
+
+void copy_draw_data(const ImDrawData& source, UiSnapshot& snapshot)
+{
+    while (snapshot.lists.size() < static_cast<size_t>(source.CmdListsCount))
+        snapshot.lists.push_back(std::make_unique<ImDrawList>(ImGui::GetDrawListSharedData()));
+
+    snapshot.draw_data.Clear();
+    for (int i = 0; i < source.CmdListsCount; i++) {
+        const ImDrawList& list = *source.CmdLists[i];
+        ImDrawList& copy = *snapshot.lists[i];
+        copy_vector(list.CmdBuffer, copy.CmdBuffer);
+        copy_vector(list.IdxBuffer, copy.IdxBuffer);
+        copy_vector(list.VtxBuffer, copy.VtxBuffer);
+        copy.Flags = list.Flags;
+        snapshot.draw_data.AddDrawList(&copy);
     }
+    snapshot.draw_data.Valid = source.Valid;
+    snapshot.draw_data.DisplayPos = source.DisplayPos;
+    snapshot.draw_data.DisplaySize = source.DisplaySize;
+    snapshot.draw_data.FramebufferScale = source.FramebufferScale;
+#if IMGUI_VERSION_NUM >= 19200
+    // Texture updates are applied by the renderer, under the same lock as the frame that requested them.
+    snapshot.draw_data.Textures = source.Textures;
+#endif
+}
+
+glm::quat cube_rotation(size_t index, float current_time, const ImGuiControls& imgui_controls)
+{
+    float angle = 20.0f * index;
+    return glm::angleAxis(current_time * glm::radians(imgui_controls.elements.cubes_rotation_speed * (index + 1)) + glm::radians(angle), glm::normalize(glm::vec3 { 1.f, .3f, .5f }));
+}
+
+void record_renderables(ngn::CommandList& commands, const ngn::Scene& scene, const glm::vec3& camera_position, const glm::vec3& camera_front, const ngn::StaticBatches* batched)
+{
+    // Keyed on the view depth, for the render thread to sort front to back. Renderables merged in
+    // {{batched}} are drawn with their batch instead.
+    auto& renderables = scene.renderables();
+    commands.reset();
+    ngn::jobs::parallel_for(0, renderables.size(), RECORD_GRAIN, [&](size_t begin, size_t end) {
+        ngn::CommandBuffer& buffer = commands.local();
+        for (size_t i = begin; i < end; i++) {
+            if (batched && batched->contains(i))
+                continue;
+            const glm::mat4& model = scene.world_matrix(renderables[i].node);
+            float depth = glm::dot(glm::vec3(model[3]) - camera_position, camera_front);
+            buffer.draw({ model, renderables[i].mesh, ngn::sortable_float(depth), static_cast<uint32_t>(i), scene.is_static(renderables[i].node) });
+        }
+    });
 }
 
-void draw_the_transparent_cubes(const ngn::Shader& shader, const ngn::Mesh& mesh, float current_time, const ImGuiControls& imgui_controls)
+void draw_opaque_depth(const std::vector<ngn::DrawPacket>& draws, const ngn::Shader& shader, const ngn::OcclusionCuller* conditional)
 {
-    std::map<float, glm::vec3> sorted;
-    for (unsigned int i = 0; i < cube_positions.size(); i++) {
-        float distance = glm::length(camera.position() - cube_positions[i]);
-        sorted[distance] = cube_positions[i];
+    for (auto& draw : draws) {
+        bool is_conditional = conditional && conditional->begin_conditional_render(draw.object);
+        shader.set("model", draw.model);
+        ngn::GLState::bind_vertex_array(draw.mesh->depth_VAO());
+        glDrawElements(GL_TRIANGLES, draw.mesh->indices().size(), GL_UNSIGNED_INT, 0);
+        if (is_conditional)
+            conditional->end_conditional_render();
     }
+}
+
+void draw_opaque(const std::vector<ngn::DrawPacket>& draws, const ngn::Shader& shader, const ngn::OcclusionCuller* conditional)
+{
+    for (auto& draw : draws) {
+        bool is_conditional = conditional && conditional->begin_conditional_render(draw.object);
+        shader.set("model", draw.model);
+        draw_mesh(*draw.mesh, shader);
+        if (is_conditional)
+            conditional->end_conditional_render();
+    }
+}
+
+void draw_shadow_casters(const std::vector<ngn::DrawPacket>& draws, const ngn::Shader& shader, bool is_static)
+{
+    for (auto& draw : draws) {
+        if (draw.is_static != is_static)
+            continue;
+        shader.set("model", draw.model);
+        ngn::GLState::bind_vertex_array(draw.mesh->depth_VAO());
+        glDrawElements(GL_TRIANGLES, draw.mesh->indices().size(), GL_UNSIGNED_INT, 0);
+    }
+}
+
+unsigned draw_static_batches(const ngn::StaticBatches& batches, const ngn::Shader& shader, const glm::mat4* view_projection, bool depth_only, const ngn::OcclusionCuller* occlusion)
+{
+    // Batches are in world space. Without {{view_projection}} every cluster is drawn, as for shadow maps.
+    unsigned clusters_drawn = 0;
+    shader.set("model", glm::mat4(1));
+    for (auto& batch : batches.batches()) {
+        if (!depth_only)
+            bind_material(batch.mesh, shader);
+        if (view_projection) {
+            clusters_drawn += ngn::StaticBatches::draw_visible(batch, *view_projection, depth_only, occlusion);
+        } else {
+            ngn::StaticBatches::draw(batch, depth_only);
+            clusters_drawn += batch.clusters.size();
+        }
+    }
+    return clusters_drawn;
+}
 
-    int i = 0;
-    for (std::map<float, glm::vec3>::reverse_iterator it = sorted.rbegin(); it != sorted.rend(); ++it) {
-        glm::mat4 model(1);
-        model = glm::translate(model, it->second);
-        float angle = 20.0f * i;
-        model = glm::rotate(model, current_time * glm::radians(imgui_controls.elements.cubes_rotation_speed * (i + 1)) + glm::radians(angle), { 1.f, .3f, .5f });
-        shader.set("model", model);
+glm::mat4 transparent_cube_model_matrix(size_t index, float current_time, const ImGuiControls& imgui_controls)
+{
+    glm::mat4 model(1);
+    model = glm::translate(model, transparent_cube_positions[index]);
+    float angle = 20.0f * index;
+    model = glm::rotate(model, current_time * glm::radians(imgui_controls.elements.cubes_rotation_speed * (index + 1)) + glm::radians(angle), { 1.f, .3f, .5f });
+    return model;
+}
+
+void draw_the_transparent_cubes(const ngn::Shader& shader, const ngn::Mesh& mesh, const FrameSnapshot& frame, std::vector<uint64_t>& sort_keys, std::vector<uint64_t>& sort_scratch)
+{
+    // Back to front: the negated view depth sorts ascending, ties keep their draw order.
+    for (size_t i = 0; i < transparent_cube_positions.size(); i++) {
+        float depth = glm::dot(transparent_cube_positions[i] - frame.camera_position, frame.camera_front);
+        sort_keys[i] = ngn::depth_sort_key(-depth, i);
+    }
+    ngn::radix_sort(sort_keys.data(), sort_scratch.data(), transparent_cube_positions.size());
+
+    for (size_t i = 0; i < transparent_cube_positions.size(); i++) {
+        size_t index = static_cast<uint32_t>(sort_keys[i]);
+        shader.set("model", transparent_cube_model_matrix(index, frame.current_time, frame.controls));
         draw_mesh(mesh, shader);
-        i++;
     }
 }
+
+void draw_the_transparent_cubes_unsorted(const ngn::Shader& shader, const ngn::Mesh& mesh, const FrameSnapshot& frame)
+{
+    for (size_t i = 0; i < transparent_cube_positions.size(); i++) {
+        shader.set("model", transparent_cube_model_matrix(i, frame.current_time, frame.controls));
+        draw_mesh(mesh, shader);
+    }
+}
+
+void animate_instances(ngn::TransformBatch& transforms, size_t begin, size_t end, float current_time, const ImGuiControls& imgui_controls)
+{
+    // A grid of spinning cubes under the scene.
+    constexpr float SPACING = 1.5;
+    size_t side = std::ceil(std::sqrt(static_cast<float>(transforms.size())));
+    for (size_t i = begin; i < end; i++) {
+        glm::vec3 position {
+            (static_cast<float>(i % side) - side / 2.f) * SPACING,
+            -6,
+            -static_cast<float>(i / side) * SPACING,
+        };
+        float angle = current_time * glm::radians(imgui_controls.elements.cubes_rotation_speed) + i;
+        transforms.set(i, position, glm::angleAxis(angle, glm::vec3 { 0, 1, 0 }), glm::vec3 { .5 });
+    }
+}
+
+void usage()
+{
+    fprintf(stderr,
+        "usage: app [--single-threaded] [--measure <frames>] [--instances <0-%d>] [--simulation-ms <0-%g>]\n"
+        "           [--capture <path>] [--capture-frames <frames>]\n"
+        "       app --batch <batch file>\n"
+        "       app --bench <jobs|import|record|rays|decode> [arguments]\n",
+        MAX_INSTANCE_COUNT, MAX_SIMULATION_MS);
+}
+
+bool parse_integer(const char* text, long min, long max, long& value)
+{
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtol(text, &end, 10);
+    return end != text && *end == '\0' && errno == 0 && value >= min && value <= max;
+}
+
+bool parse_float(const char* text, float min, float max, float& value)
+{
+    char* end = nullptr;
+    value = std::strtof(text, &end);
+    // NaN fails both comparisons.
+    return end != text && *end == '\0' && value >= min && value <= max;
+}
+
+void simulate_load(float milliseconds)
+{
+    auto end = std::chrono::steady_clock::now() + std::chrono::duration<float, std::milli>(milliseconds);
+    while (std::chrono::steady_clock::now() < end) { }
+}
+
+void set_point_light_constants(const ngn::Shader& shader)
+{
+    shader.use();
+    for (size_t i = 0; i < point_light_positions.size(); i++) {
+        shader.set(std::string("pointLights[") + std::to_string(i) + "].position", point_light_positions[i]);
+        shader.set(std::string("pointLights[") + std::to_string(i) + "].ambient", glm::vec3 { 0 });
+        shader.set(std::string("pointLights[") + std::to_string(i) + "].constant", 1.f);
+        shader.set(std::string("pointLights[") + std::to_string(i) + "].linear", .09f);
+        shader.set(std::string("pointLights[") + std::to_string(i) + "].quadratic", .032f);
+    }
+}
+
+void set_lighting_uniforms(const ngn::Shader& shader, const FrameSnapshot& frame)
+{
+    const ImGuiControls& imgui_controls = frame.controls;
+    glm::vec3 point_diffuse_color = imgui_controls.point_light.color * imgui_controls.point_light.diffuse_strength;
+    glm::vec3 dir_diffuse_color = imgui_controls.direction_light.color * imgui_controls.direction_light.diffuse_strength;
+
+    glm::vec3 ambient_color = glm::vec3 { imgui_controls.direction_light.ambient_strength };
+
+    shader.use();
+    for (size_t i = 0; i < point_light_positions.size(); i++) {
+        shader.set(ngn::frame_arena().format("pointLights[%zu].diffuse", i), point_diffuse_color);
+        shader.set(ngn::frame_arena().format("pointLights[%zu].specular", i), imgui_controls.point_light.color);
+    }
+
+    shader.set("projection", frame.projection);
+    shader.set("view", frame.view);
+    shader.set("viewPos", frame.camera_position);
+    shader.set("material.shininess", imgui_controls.material.shininess);
+    shader.set("dirLight.direction", imgui_controls.direction_light.direction);
+    shader.set("dirLight.ambient", ambient_color);
+    shader.set("dirLight.diffuse", dir_diffuse_color);
+    shader.set("dirLight.specular", imgui_controls.direction_light.color);
+    shader.set("shadowsEnabled", static_cast<int>(imgui_controls.shadows.enable));
+    shader.set("spotLight.direction", frame.camera_front);
+    shader.set("spotLight.position", frame.camera_position);
+    shader.set("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
+    shader.set("spotLight.outerCutOff", glm::cos(glm::radians(17.5f)));
+    shader.set("spotLight.ambient", glm::vec3 { 0 });
+    shader.set("spotLight.diffuse", imgui_controls.spot_light.color * imgui_controls.spot_light.diffuse_strength * static_cast<float>(imgui_controls.spot_light.enable));
+    shader.set("spotLight.specular", imgui_controls.spot_light.color * static_cast<float>(imgui_controls.spot_light.enable));
+}
@@ -0,0 +1,109 @@
+#include "assimp_io_system.h"
+
+#include "../utils/log.h"
+#include "file_system.h"
+
+#include <assimp/IOStream.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace ngn {
+
+/**
+ * @brief Assimp stream reading straight from a mapped file.
+ */
+class FileViewStream : public Assimp::IOStream {
+public:
+    FileViewStream(FileView&& view)
+        : view_(std::move(view))
+    {
+    }
+
+    size_t Read(void* buffer, size_t size, size_t count) override
+    {
+        if (size == 0)
+            return 0;
+        // Like fread, only whole elements are read.
+        count = std::min(count, (view_.size() - position_) / size);
+        std::memcpy(buffer, view_.data() + position_, size * count);
+        position_ += size * count;
+        return count;
+    }
+
+    size_t Write(const void*, size_t, size_t) override
+    {
+        return 0;
+    }
+
+    aiReturn Seek(size_t offset, aiOrigin origin) override
+    {
+        size_t position;
+        switch (origin) {
+        case aiOrigin_SET:
+            position = offset;
+            break;
+        case aiOrigin_CUR:
+            position = position_ + offset;
+            break;
+        case aiOrigin_END:
+            position = view_.size() - offset;
+            break;
+        default:
+            return aiReturn_FAILURE;
+        }
+        if (position > view_.size())
+            return aiReturn_FAILURE;
+        position_ = position;
+        return aiReturn_SUCCESS;
+    }
+
+    size_t Tell() const override
+    {
+        return position_;
+    }
+
+    size_t FileSize() const override
+    {
+        return view_.size();
+    }
+
+    void Flush() override { }
+
+private:
+    FileView view_;
+    size_t position_ { 0 };
+};
+
+bool AssimpIOSystem::Exists(const char* path) const
+{
+    return FileSystem::exists(path);
+}
+
+char AssimpIOSystem::getOsSeparator() const
+{
+    return '/';
+}
+
+Assimp::IOStream* AssimpIOSystem::Open(const char* path, const char* mode)
+{
+    if (std::strpbrk(mode, "wa+")) {
+        LOGERRF("Cannot open \"%s\" for writing.", path);
+        return nullptr;
+    }
+    // Assimp probes for optional files, do not log those as errors.
+    if (!FileSystem::exists(path))
+        return nullptr;
+    FileView view = FileSystem::open(path);
+    if (!view)
+        return nullptr;
+    return new FileViewStream(std::move(view));
+}
+
+void AssimpIOSystem::Close(Assimp::IOStream* stream)
+{
+    delete stream;
+}
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <assimp/IOSystem.hpp>
+
+namespace ngn {
+
+/**
+ * @brief Routes Assimp file reads, including the files a model references, through FileSystem.
+ *
+ * Give a new instance to Assimp::Importer::SetIOHandler, which takes ownership of it. Writing is not supported.
+ */
+class AssimpIOSystem : public Assimp::IOSystem {
+public:
+    AssimpIOSystem() = default;
+    ~AssimpIOSystem() override = default;
+
+    AssimpIOSystem(const AssimpIOSystem&) = delete;
+    AssimpIOSystem& operator=(const AssimpIOSystem&) = delete;
+    AssimpIOSystem(AssimpIOSystem&&) = delete;
+
+    bool Exists(const char* path) const override;
+    char getOsSeparator() const override;
+    Assimp::IOStream* Open(const char* path, const char* mode = "rb") override;
+    void Close(Assimp::IOStream* stream) override;
+};
+
+}
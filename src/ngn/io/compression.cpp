@@ -0,0 +1,90 @@
+#include "compression.h"
+
+#include "../utils/log.h"
+
+#ifdef NGN_HAVE_LZ4
+#include <lz4.h>
+#include <lz4hc.h>
+#endif
+#ifdef NGN_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <algorithm>
+
+namespace ngn {
+
+bool compression_supported(pack::Compression compression)
+{
+    switch (compression) {
+    case pack::Compression::None:
+        return true;
+    case pack::Compression::LZ4:
+#ifdef NGN_HAVE_LZ4
+        return true;
+#else
+        return false;
+#endif
+    case pack::Compression::Zstd:
+#ifdef NGN_HAVE_ZSTD
+        return true;
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+std::vector<std::byte> compress(pack::Compression compression, const std::byte* source, size_t size, int level)
+{
+    std::vector<std::byte> compressed;
+    switch (compression) {
+    case pack::Compression::None:
+        compressed.assign(source, source + size);
+        break;
+    case pack::Compression::LZ4:
+#ifdef NGN_HAVE_LZ4
+        compressed.resize(LZ4_compressBound(size));
+        // High compression: packing is offline, decompression speed is the same.
+        compressed.resize(LZ4_compress_HC(reinterpret_cast<const char*>(source), reinterpret_cast<char*>(compressed.data()), size, compressed.size(), level));
+#endif
+        break;
+    case pack::Compression::Zstd:
+#ifdef NGN_HAVE_ZSTD
+    {
+        compressed.resize(ZSTD_compressBound(size));
+        size_t compressed_size = ZSTD_compress(compressed.data(), compressed.size(), source, size, level);
+        compressed.resize(ZSTD_isError(compressed_size) ? 0 : compressed_size);
+    }
+#endif
+        break;
+    }
+    return compressed;
+}
+
+bool decompress(pack::Compression compression, const std::byte* source, size_t source_size, std::byte* destination, size_t size)
+{
+    switch (compression) {
+    case pack::Compression::None:
+        if (source_size != size)
+            return false;
+        std::copy_n(source, size, destination);
+        return true;
+    case pack::Compression::LZ4:
+#ifdef NGN_HAVE_LZ4
+        return LZ4_decompress_safe(reinterpret_cast<const char*>(source), reinterpret_cast<char*>(destination), source_size, size) == static_cast<int>(size);
+#else
+        break;
+#endif
+    case pack::Compression::Zstd:
+#ifdef NGN_HAVE_ZSTD
+        return ZSTD_decompress(destination, size, source, source_size) == size;
+#else
+        break;
+#endif
+    }
+    LOGERRF("Compression %u is not supported by this build.", static_cast<unsigned>(compression));
+    return false;
+}
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "pack_format.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace ngn {
+
+/**
+ * @brief Whether {{compression}} was available at build time (NGN_HAVE_LZ4, NGN_HAVE_ZSTD).
+ */
+bool compression_supported(pack::Compression compression);
+
+/**
+ * @brief Compresses {{size}} bytes of {{source}}.
+ *
+ * @return The compressed bytes, empty when the codec is not supported or fails.
+ */
+std::vector<std::byte> compress(pack::Compression compression, const std::byte* source, size_t size, int level);
+
+/**
+ * @brief Decompresses {{source_size}} bytes of {{source}} into exactly {{size}} bytes of {{destination}}.
+ */
+bool decompress(pack::Compression compression, const std::byte* source, size_t source_size, std::byte* destination, size_t size);
+
+}
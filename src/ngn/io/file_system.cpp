@@ -0,0 +1,219 @@
+#include "file_system.h"
+
+#include "../utils/log.h"
+#include "pack_archive.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ngn {
+
+std::vector<std::unique_ptr<PackArchive>> FileSystem::archives_;
+std::atomic<unsigned> FileSystem::files_opened_ { 0 };
+
+FileView::FileView(const std::byte* data, size_t size, Storage storage)
+    : data_(data)
+    , size_(size)
+    , valid_(true)
+    , storage_(storage)
+{
+}
+
+FileView::~FileView()
+{
+    release();
+}
+
+FileView::FileView(FileView&& other)
+    : data_(std::exchange(other.data_, nullptr))
+    , size_(std::exchange(other.size_, 0))
+    , valid_(std::exchange(other.valid_, false))
+    , storage_(other.storage_)
+{
+}
+
+FileView& FileView::operator=(FileView&& other)
+{
+    if (this != &other) {
+        release();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        valid_ = std::exchange(other.valid_, false);
+        storage_ = other.storage_;
+    }
+    return *this;
+}
+
+const std::byte* FileView::data() const
+{
+    return data_;
+}
+
+size_t FileView::size() const
+{
+    return size_;
+}
+
+std::string_view FileView::text() const
+{
+    return { reinterpret_cast<const char*>(data_), size_ };
+}
+
+FileView::operator bool() const
+{
+    return valid_;
+}
+
+void FileView::release()
+{
+    if (data_ && storage_ == Mapped) {
+#ifdef _WIN32
+        UnmapViewOfFile(data_);
+#else
+        munmap(const_cast<std::byte*>(data_), size_);
+#endif
+    } else if (storage_ == Owned) {
+        delete[] data_;
+    }
+    data_ = nullptr;
+    size_ = 0;
+    valid_ = false;
+}
+
+FileView FileSystem::open(const std::string& path)
+{
+    if (!archives_.empty()) {
+        std::string normalized = pack::normalize_path(path);
+        for (auto& archive : archives_) {
+            if (const pack::Entry* entry = archive->find(normalized))
+                return archive->read(*entry);
+        }
+    }
+    return open_on_disk(path);
+}
+
+bool FileSystem::mount(const std::string& path)
+{
+    FileView file = open_on_disk(path);
+    if (!file)
+        return false;
+    std::unique_ptr<PackArchive> archive = PackArchive::load(std::move(file), path);
+    if (!archive)
+        return false;
+    LOGF("Mounted \"%s\", %zu files.", path.c_str(), archive->entry_count());
+    archives_.push_back(std::move(archive));
+    return true;
+}
+
+void FileSystem::unmount_all()
+{
+    archives_.clear();
+}
+
+unsigned FileSystem::files_opened()
+{
+    return files_opened_;
+}
+
+bool FileSystem::exists(const std::string& path)
+{
+    if (!archives_.empty()) {
+        std::string normalized = pack::normalize_path(path);
+        for (auto& archive : archives_) {
+            if (archive->find(normalized))
+                return true;
+        }
+    }
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path.c_str());
+    return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat status;
+    return stat(path.c_str(), &status) == 0 && S_ISREG(status.st_mode);
+#endif
+}
+
+#ifdef _WIN32
+
+FileView FileSystem::open_on_disk(const std::string& path)
+{
+    FileView view;
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        LOGERRF("Failed to open \"%s\".", path.c_str());
+        return view;
+    }
+    files_opened_++;
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    view.size_ = size.QuadPart;
+    view.valid_ = true;
+
+    // Mapping an empty file fails: leave the view empty instead.
+    if (view.size_ > 0) {
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) {
+            // The view keeps the mapping alive on its own.
+            view.data_ = static_cast<const std::byte*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            CloseHandle(mapping);
+        }
+        if (!view.data_) {
+            LOGERRF("Failed to map \"%s\".", path.c_str());
+            view.size_ = 0;
+            view.valid_ = false;
+        }
+    }
+    CloseHandle(file);
+    return view;
+}
+
+#else
+
+FileView FileSystem::open_on_disk(const std::string& path)
+{
+    FileView view;
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        LOGERRF("Failed to open \"%s\".", path.c_str());
+        return view;
+    }
+    files_opened_++;
+    struct stat status;
+    if (fstat(file, &status) != 0 || !S_ISREG(status.st_mode)) {
+        LOGERRF("Failed to open \"%s\": not a regular file.", path.c_str());
+        close(file);
+        return view;
+    }
+    view.size_ = status.st_size;
+    view.valid_ = true;
+
+    // Mapping an empty file fails: leave the view empty instead.
+    if (view.size_ > 0) {
+        void* data = mmap(nullptr, view.size_, PROT_READ, MAP_PRIVATE, file, 0);
+        if (data == MAP_FAILED) {
+            LOGERRF("Failed to map \"%s\".", path.c_str());
+            view.size_ = 0;
+            view.valid_ = false;
+        } else {
+            madvise(data, view.size_, MADV_WILLNEED);
+            view.data_ = static_cast<const std::byte*>(data);
+        }
+    }
+    // The mapping keeps its own reference to the file.
+    close(file);
+    return view;
+}
+
+#endif
+
+}
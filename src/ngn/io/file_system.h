@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ngn {
+
+class PackArchive;
+
+/**
+ * @brief Read-only view of a whole file, valid for as long as the view lives.
+ *
+ * Loose files are mapped into memory. Files from a mounted pack point into the pack mapping, or into a
+ * buffer of their own when they were compressed.
+ */
+class FileView {
+public:
+    FileView() = default;
+    ~FileView();
+
+    FileView(const FileView&) = delete;
+    FileView& operator=(const FileView&) = delete;
+    FileView(FileView&& other);
+    FileView& operator=(FileView&& other);
+
+    const std::byte* data() const;
+    size_t size() const;
+    std::string_view text() const;
+
+    /**
+     * @brief Whether the file could be opened. An empty file is valid but has no data.
+     */
+    explicit operator bool() const;
+
+private:
+    friend class FileSystem;
+    friend class PackArchive;
+
+    enum Storage {
+        Mapped,
+        Borrowed,
+        Owned,
+    };
+
+    FileView(const std::byte* data, size_t size, Storage storage);
+
+    void release();
+
+    const std::byte* data_ { nullptr };
+    size_t size_ { 0 };
+    bool valid_ { false };
+    Storage storage_ { Mapped };
+};
+
+/**
+ * @brief Single entry point for reading asset files.
+ *
+ * Paths are looked up in the mounted packs first, in mount order, then on disk.
+ */
+class FileSystem {
+public:
+    FileSystem() = delete;
+
+    /**
+     * @brief Maps {{path}}, asking the OS to read it ahead since assets are consumed whole.
+     *
+     * @return An invalid view, after logging, when the file cannot be opened.
+     */
+    static FileView open(const std::string& path);
+
+    static bool exists(const std::string& path);
+
+    /**
+     * @brief Serves the files of the pack at {{path}}. Views into it stay valid until unmount_all().
+     */
+    static bool mount(const std::string& path);
+    static void unmount_all();
+
+    /**
+     * @brief Files opened on disk since the start, packs included.
+     */
+    static unsigned files_opened();
+
+private:
+    static FileView open_on_disk(const std::string& path);
+
+    static std::vector<std::unique_ptr<PackArchive>> archives_;
+    static std::atomic<unsigned> files_opened_;
+};
+
+}
@@ -0,0 +1,224 @@
+#include "image_decoder.h"
+
+#include "../utils/log.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#ifdef NGN_HAVE_TURBOJPEG
+#include <turbojpeg.h>
+#endif
+#ifdef NGN_HAVE_SPNG
+#include <spng.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <memory>
+
+namespace ngn {
+
+ImageFormat detect_image_format(const std::byte* data, size_t size)
+{
+    static constexpr unsigned char PNG_SIGNATURE[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    static constexpr unsigned char JPEG_SIGNATURE[] = { 0xFF, 0xD8, 0xFF };
+    if (size >= sizeof(PNG_SIGNATURE) && std::memcmp(data, PNG_SIGNATURE, sizeof(PNG_SIGNATURE)) == 0)
+        return ImageFormat::Png;
+    if (size >= sizeof(JPEG_SIGNATURE) && std::memcmp(data, JPEG_SIGNATURE, sizeof(JPEG_SIGNATURE)) == 0)
+        return ImageFormat::Jpeg;
+    return ImageFormat::Unknown;
+}
+
+const char* to_string(ImageFormat format)
+{
+    switch (format) {
+    case ImageFormat::Png:
+        return "PNG";
+    case ImageFormat::Jpeg:
+        return "JPEG";
+    default:
+        return "unknown";
+    }
+}
+
+namespace {
+
+    class StbDecoder final : public ImageDecoder {
+    public:
+        const char* name() const override
+        {
+            return "stb_image";
+        }
+
+        bool supports(ImageFormat) const override
+        {
+            return true;
+        }
+
+        bool decode(const std::byte* data, size_t size, bool flip_vertically, Image& image) const override
+        {
+            auto* source = reinterpret_cast<const stbi_uc*>(data);
+            int width, height, channels;
+            if (!stbi_info_from_memory(source, size, &width, &height, &channels))
+                return false;
+            int output_channels = channels == 2 || channels == 4 ? 4 : 3;
+
+            // Per thread, so concurrent decodes do not race on the setting. stb flips in a pass of its own.
+            stbi_set_flip_vertically_on_load_thread(flip_vertically);
+            stbi_uc* pixels = stbi_load_from_memory(source, size, &width, &height, &channels, output_channels);
+            if (!pixels)
+                return false;
+            image.width = width;
+            image.height = height;
+            image.channels = output_channels;
+            image.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * output_channels);
+            stbi_image_free(pixels);
+            return true;
+        }
+    };
+
+#ifdef NGN_HAVE_TURBOJPEG
+    class TurboJpegDecoder final : public ImageDecoder {
+    public:
+        const char* name() const override
+        {
+            return "libjpeg-turbo";
+        }
+
+        bool supports(ImageFormat format) const override
+        {
+            return format == ImageFormat::Jpeg;
+        }
+
+        bool decode(const std::byte* data, size_t size, bool flip_vertically, Image& image) const override
+        {
+            // A handle must not be shared between threads: each thread keeps its own.
+            thread_local std::unique_ptr<void, int (*)(tjhandle)> handle(tjInitDecompress(), tjDestroy);
+            if (!handle)
+                return false;
+
+            auto* source = reinterpret_cast<const unsigned char*>(data);
+            int width, height, subsampling, colorspace;
+            if (tjDecompressHeader3(handle.get(), source, size, &width, &height, &subsampling, &colorspace) != 0)
+                return false;
+            image.width = width;
+            image.height = height;
+            image.channels = 3;
+            image.pixels.resize(static_cast<size_t>(width) * height * 3);
+
+            // Bottom up output writes every row to its flipped place as it is decoded.
+            int flags = flip_vertically ? TJFLAG_BOTTOMUP : 0;
+            return tjDecompress2(handle.get(), source, size, image.pixels.data(), width, 0, height, TJPF_RGB, flags) == 0;
+        }
+    };
+#endif
+
+#ifdef NGN_HAVE_SPNG
+    class SpngDecoder final : public ImageDecoder {
+    public:
+        const char* name() const override
+        {
+            return "libspng";
+        }
+
+        bool supports(ImageFormat format) const override
+        {
+            return format == ImageFormat::Png;
+        }
+
+        bool decode(const std::byte* data, size_t size, bool flip_vertically, Image& image) const override
+        {
+            std::unique_ptr<spng_ctx, void (*)(spng_ctx*)> context(spng_ctx_new(0), spng_ctx_free);
+            if (!context || spng_set_png_buffer(context.get(), data, size) != 0)
+                return false;
+            spng_ihdr header;
+            if (spng_get_ihdr(context.get(), &header) != 0)
+                return false;
+
+            // Alpha is kept when stored, as a channel or as a transparent colour.
+            spng_trns transparency;
+            bool has_alpha = header.color_type == SPNG_COLOR_TYPE_TRUECOLOR_ALPHA
+                || header.color_type == SPNG_COLOR_TYPE_GRAYSCALE_ALPHA
+                || spng_get_trns(context.get(), &transparency) == 0;
+            int format = has_alpha ? SPNG_FMT_RGBA8 : SPNG_FMT_RGB8;
+            size_t image_size;
+            if (spng_decoded_image_size(context.get(), format, &image_size) != 0)
+                return false;
+            image.width = header.width;
+            image.height = header.height;
+            image.channels = has_alpha ? 4 : 3;
+            image.pixels.resize(image_size);
+
+            // Row by row, each one decoded straight to its flipped place.
+            if (spng_decode_image(context.get(), nullptr, 0, format, SPNG_DECODE_PROGRESSIVE | (has_alpha ? SPNG_DECODE_TRNS : 0)) != 0)
+                return false;
+            size_t row_size = image_size / header.height;
+            spng_row_info row;
+            int error;
+            while ((error = spng_get_row_info(context.get(), &row)) == 0) {
+                size_t destination = flip_vertically ? header.height - 1 - row.row_num : row.row_num;
+                error = spng_decode_row(context.get(), image.pixels.data() + destination * row_size, row_size);
+                if (error)
+                    break;
+            }
+            return error == SPNG_EOI;
+        }
+    };
+#endif
+
+    const StbDecoder stb_decoder;
+#ifdef NGN_HAVE_TURBOJPEG
+    const TurboJpegDecoder turbojpeg_decoder;
+#endif
+#ifdef NGN_HAVE_SPNG
+    const SpngDecoder spng_decoder;
+#endif
+
+    // Fastest first.
+    const ImageDecoder* const all_decoders[] = {
+#ifdef NGN_HAVE_TURBOJPEG
+        &turbojpeg_decoder,
+#endif
+#ifdef NGN_HAVE_SPNG
+        &spng_decoder,
+#endif
+        &stb_decoder,
+    };
+
+}
+
+std::vector<const ImageDecoder*> ImageDecoder::decoders(ImageFormat format)
+{
+    std::vector<const ImageDecoder*> decoders;
+    std::copy_if(std::begin(all_decoders), std::end(all_decoders), std::back_inserter(decoders), [format](const ImageDecoder* decoder) {
+        return decoder->supports(format);
+    });
+    return decoders;
+}
+
+const ImageDecoder& ImageDecoder::for_format(ImageFormat format)
+{
+    for (auto* decoder : all_decoders) {
+        if (decoder->supports(format))
+            return *decoder;
+    }
+    return stb_decoder;
+}
+
+bool decode_image(const std::byte* data, size_t size, bool flip_vertically, Image& image)
+{
+    // Backends are stricter than stb_image (libspng checks CRCs, libjpeg-turbo rejects some JPEGs stb
+    // reads): on failure, the next one gets a try, down to stb_image, which supports every format.
+    ImageFormat format = detect_image_format(data, size);
+    for (auto* decoder : all_decoders) {
+        if (!decoder->supports(format))
+            continue;
+        if (decoder->decode(data, size, flip_vertically, image))
+            return true;
+        LOGERRF("WARNING::IMAGE::%s failed to decode a %s image, trying the next decoder.", decoder->name(), to_string(format));
+    }
+    return false;
+}
+
+}
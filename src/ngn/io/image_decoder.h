@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace ngn {
+
+enum class ImageFormat {
+    Unknown,
+    Png,
+    Jpeg,
+};
+
+/**
+ * @brief Format of an encoded image, from its signature.
+ */
+ImageFormat detect_image_format(const std::byte* data, size_t size);
+const char* to_string(ImageFormat format);
+
+/**
+ * @brief Decoded 8 bit image, rows tightly packed.
+ */
+struct Image {
+    int width = 0;
+    int height = 0;
+    /**
+     * @brief 3 (RGB) or 4 (RGBA): grey images are expanded, and an alpha channel is only kept when present.
+     */
+    int channels = 0;
+    std::vector<unsigned char> pixels;
+};
+
+/**
+ * @brief Decoding backend of one or more image formats.
+ *
+ * Backends are stateless and may decode from several threads at once. stb_image handles every format,
+ * libjpeg-turbo (NGN_HAVE_TURBOJPEG) and libspng (NGN_HAVE_SPNG) take over JPEG and PNG when built in.
+ */
+class ImageDecoder {
+public:
+    virtual ~ImageDecoder() = default;
+
+    virtual const char* name() const = 0;
+    virtual bool supports(ImageFormat format) const = 0;
+
+    /**
+     * @brief Decodes {{size}} bytes of {{data}} into {{image}}, the last row first when {{flip_vertically}}.
+     */
+    virtual bool decode(const std::byte* data, size_t size, bool flip_vertically, Image& image) const = 0;
+
+    /**
+     * @brief Backends built in for {{format}}, fastest first. stb_image always comes last.
+     */
+    static std::vector<const ImageDecoder*> decoders(ImageFormat format);
+
+    /**
+     * @brief Fastest backend built in for {{format}}.
+     */
+    static const ImageDecoder& for_format(ImageFormat format);
+};
+
+/**
+ * @brief Decodes with the fastest backend for the format of {{data}}, then the slower ones if it fails.
+ */
+bool decode_image(const std::byte* data, size_t size, bool flip_vertically, Image& image);
+
+}
@@ -0,0 +1,20 @@
+#include "image_encoder.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+namespace ngn {
+
+bool write_png(const std::string& path, const Image& image, bool flip_vertically)
+{
+    // stb_image_write's own flag is global: a negative stride starting at the last row flips per call.
+    int stride = image.width * image.channels;
+    const unsigned char* first_row = image.pixels.data();
+    if (flip_vertically) {
+        first_row += static_cast<size_t>(image.height - 1) * stride;
+        stride = -stride;
+    }
+    return stbi_write_png(path.c_str(), image.width, image.height, image.channels, first_row, stride) != 0;
+}
+
+}
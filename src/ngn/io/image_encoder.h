@@ -0,0 +1,18 @@
+#pragma once
+
+#include "image_decoder.h"
+
+#include <string>
+
+namespace ngn {
+
+/**
+ * @brief Writes {{image}} to {{path}} as a PNG, the last row first when {{flip_vertically}}, as GL reads them.
+ *
+ * May run on several threads at once.
+ *
+ * @return Whether the file was written.
+ */
+bool write_png(const std::string& path, const Image& image, bool flip_vertically);
+
+}
@@ -0,0 +1,97 @@
+#include "pack_archive.h"
+
+#include "../utils/log.h"
+#include "compression.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ngn {
+
+PackArchive::PackArchive(FileView&& file, const std::string& name)
+    : file_(std::move(file))
+    , name_(name)
+{
+}
+
+std::unique_ptr<PackArchive> PackArchive::load(FileView&& file, const std::string& name)
+{
+    if (file.size() < sizeof(pack::Header)) {
+        LOGERRF("\"%s\" is not a pack.", name.c_str());
+        return nullptr;
+    }
+    pack::Header header;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, pack::MAGIC, sizeof(pack::MAGIC)) != 0 || header.version != pack::VERSION) {
+        LOGERRF("\"%s\" is not a version %u pack.", name.c_str(), pack::VERSION);
+        return nullptr;
+    }
+    size_t entries_size = header.entry_count * sizeof(pack::Entry);
+    if (header.toc_offset % alignof(pack::Entry) != 0 || header.toc_offset > file.size() || file.size() - header.toc_offset < entries_size) {
+        LOGERRF("\"%s\" has a truncated table of contents.", name.c_str());
+        return nullptr;
+    }
+
+    std::unique_ptr<PackArchive> archive(new PackArchive(std::move(file), name));
+    const std::byte* toc = archive->file_.data() + header.toc_offset;
+    archive->entries_ = reinterpret_cast<const pack::Entry*>(toc);
+    archive->entry_count_ = header.entry_count;
+    archive->paths_ = reinterpret_cast<const char*>(toc + entries_size);
+    archive->paths_size_ = archive->file_.size() - header.toc_offset - entries_size;
+
+    for (size_t i = 0; i < archive->entry_count_; i++) {
+        const pack::Entry& entry = archive->entries_[i];
+        bool in_bounds = entry.offset <= header.toc_offset && entry.stored_size <= header.toc_offset - entry.offset
+            && entry.path_offset <= archive->paths_size_ && entry.path_length <= archive->paths_size_ - entry.path_offset;
+        // Uncompressed entries are read in place: their size must be what is stored.
+        bool known_compression = entry.compression == pack::Compression::None || entry.compression == pack::Compression::LZ4
+            || entry.compression == pack::Compression::Zstd;
+        bool consistent = known_compression && (entry.compression != pack::Compression::None || entry.size == entry.stored_size);
+        if (!in_bounds || !consistent || (i > 0 && archive->entries_[i - 1].hash > entry.hash)) {
+            LOGERRF("\"%s\" has an invalid entry %zu.", name.c_str(), i);
+            return nullptr;
+        }
+    }
+    return archive;
+}
+
+const pack::Entry* PackArchive::find(std::string_view path) const
+{
+    uint64_t hash = pack::hash(path);
+    const pack::Entry* end = entries_ + entry_count_;
+    const pack::Entry* entry = std::lower_bound(entries_, end, hash, [](const pack::Entry& entry, uint64_t hash) {
+        return entry.hash < hash;
+    });
+    // The packer rejects collisions, but check the path anyway for files the pack does not contain.
+    for (; entry != end && entry->hash == hash; entry++) {
+        if (this->path(*entry) == path)
+            return entry;
+    }
+    return nullptr;
+}
+
+FileView PackArchive::read(const pack::Entry& entry) const
+{
+    const std::byte* data = file_.data() + entry.offset;
+    if (entry.compression == pack::Compression::None)
+        return FileView(data, entry.size, FileView::Borrowed);
+
+    FileView view(new std::byte[entry.size], entry.size, FileView::Owned);
+    if (!decompress(entry.compression, data, entry.stored_size, const_cast<std::byte*>(view.data()), entry.size)) {
+        LOGERRF("Failed to decompress \"%.*s\" from \"%s\".", static_cast<int>(entry.path_length), paths_ + entry.path_offset, name_.c_str());
+        return FileView();
+    }
+    return view;
+}
+
+size_t PackArchive::entry_count() const
+{
+    return entry_count_;
+}
+
+std::string_view PackArchive::path(const pack::Entry& entry) const
+{
+    return { paths_ + entry.path_offset, entry.path_length };
+}
+
+}
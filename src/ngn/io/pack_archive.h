@@ -0,0 +1,53 @@
+#pragma once
+
+#include "file_system.h"
+#include "pack_format.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace ngn {
+
+/**
+ * @brief Mapped pack file, looked up through its table of contents.
+ */
+class PackArchive {
+public:
+    /**
+     * @brief Validates the header and table of contents of {{file}}.
+     *
+     * @return nullptr, after logging, when {{file}} is not a pack this build can read.
+     */
+    static std::unique_ptr<PackArchive> load(FileView&& file, const std::string& name);
+
+    PackArchive(const PackArchive&) = delete;
+    PackArchive& operator=(const PackArchive&) = delete;
+    PackArchive(PackArchive&&) = delete;
+
+    /**
+     * @brief Entry of the normalized {{path}}, nullptr when the pack does not contain it.
+     */
+    const pack::Entry* find(std::string_view path) const;
+
+    /**
+     * @brief Borrows the bytes of {{entry}}, or decompresses them into a view of their own.
+     */
+    FileView read(const pack::Entry& entry) const;
+
+    size_t entry_count() const;
+
+private:
+    PackArchive(FileView&& file, const std::string& name);
+
+    std::string_view path(const pack::Entry& entry) const;
+
+    FileView file_;
+    std::string name_;
+    const pack::Entry* entries_ { nullptr };
+    size_t entry_count_ { 0 };
+    const char* paths_ { nullptr };
+    size_t paths_size_ { 0 };
+};
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief On-disk layout of asset packs, shared by the runtime and the packer.
+ *
+ * A pack is a Header, entry data each starting on an ALIGNMENT boundary, then the table of contents at
+ * Header::toc_offset: Entry records sorted by hash, followed by their paths.
+ */
+namespace ngn::pack {
+
+constexpr char MAGIC[8] = { 'N', 'G', 'N', 'P', 'A', 'C', 'K', '\0' };
+constexpr uint32_t VERSION = 1;
+constexpr uint64_t ALIGNMENT = 64;
+
+enum class Compression : uint32_t {
+    None,
+    LZ4,
+    Zstd,
+};
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_count;
+    uint64_t toc_offset;
+};
+
+struct Entry {
+    uint64_t hash;
+    uint64_t offset;
+    /**
+     * @brief Bytes in the pack, equal to size when not compressed.
+     */
+    uint64_t stored_size;
+    uint64_t size;
+    /**
+     * @brief Relative to the end of the Entry records.
+     */
+    uint32_t path_offset;
+    uint32_t path_length;
+    Compression compression;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(Header) == 24);
+static_assert(sizeof(Entry) == 48);
+
+/**
+ * @brief Forward slashes, no empty, "." or resolvable ".." segments.
+ */
+inline std::string normalize_path(std::string_view path)
+{
+    std::string normalized;
+    normalized.reserve(path.size());
+    size_t begin = 0;
+    while (begin <= path.size()) {
+        size_t end = path.find_first_of("/\\", begin);
+        if (end == std::string_view::npos)
+            end = path.size();
+        std::string_view segment = path.substr(begin, end - begin);
+        begin = end + 1;
+
+        if (segment.empty() || segment == ".")
+            continue;
+        if (segment == "..") {
+            size_t parent = normalized.find_last_of('/');
+            std::string_view last = std::string_view(normalized).substr(parent == std::string::npos ? 0 : parent + 1);
+            if (!normalized.empty() && last != "..") {
+                normalized.resize(parent == std::string::npos ? 0 : parent);
+                continue;
+            }
+        }
+        if (!normalized.empty())
+            normalized += '/';
+        normalized += segment;
+    }
+    return normalized;
+}
+
+/**
+ * @brief 64-bit FNV-1a of a normalized path.
+ */
+constexpr uint64_t hash(std::string_view path)
+{
+    uint64_t hash = 0xcbf29ce484222325;
+    for (char character : path) {
+        hash ^= static_cast<unsigned char>(character);
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+}
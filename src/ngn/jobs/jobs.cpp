@@ -0,0 +1,268 @@
+#include "jobs.h"
+
+#include "../utils/log.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <thread>
+
+namespace ngn::jobs {
+
+struct Task {
+    Job job;
+    Counter* counter;
+};
+
+struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+};
+
+/**
+ * @brief One queue per thread, index 0 being the main thread.
+ */
+static std::vector<std::unique_ptr<Queue>> queues;
+static std::vector<std::thread> workers;
+static Queue main_queue;
+
+static std::atomic<bool> running { false };
+static std::atomic<int> queued { 0 };
+static std::mutex sleep_mutex;
+static std::condition_variable wake;
+
+static thread_local unsigned current_thread_index = 0;
+
+void finish(Counter* counter);
+
+bool Counter::done() const
+{
+    return pending_.load(std::memory_order_acquire) == 0;
+}
+
+static void push(Task task)
+{
+    // Before init() or after shutdown() there is no queue to push to: run in place.
+    if (queues.empty()) {
+        task.job();
+        finish(task.counter);
+        return;
+    }
+
+    Queue& queue = *queues[current_thread_index];
+    {
+        std::lock_guard lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    queued.fetch_add(1, std::memory_order_release);
+    // Taking the lock orders the notification after a sleeping worker checked its predicate.
+    {
+        std::lock_guard lock(sleep_mutex);
+    }
+    wake.notify_one();
+}
+
+static std::optional<Task> pop()
+{
+    if (queues.empty() || queued.load(std::memory_order_acquire) == 0)
+        return std::nullopt;
+
+    // Own jobs first, newest first, while they are still warm in cache.
+    {
+        Queue& queue = *queues[current_thread_index];
+        std::lock_guard lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            Task task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return task;
+        }
+    }
+
+    // Then steal the oldest job of another thread.
+    for (size_t offset = 1; offset < queues.size(); offset++) {
+        Queue& queue = *queues[(current_thread_index + offset) % queues.size()];
+        std::lock_guard lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            Task task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return task;
+        }
+    }
+    return std::nullopt;
+}
+
+static void execute(Task& task)
+{
+    task.job();
+    finish(task.counter);
+}
+
+void finish(Counter* counter)
+{
+    if (!counter)
+        return;
+
+    // Decrement under the lock: wait() takes it too before returning, so the counter cannot be
+    // destroyed while it is still in use here.
+    std::vector<std::pair<Job, Counter*>> continuations;
+    {
+        std::lock_guard lock(counter->mutex_);
+        if (counter->pending_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        continuations.swap(counter->continuations_);
+    }
+    // Continuations were counted when scheduled, so push them directly.
+    for (auto& [job, continuation_counter] : continuations)
+        push({ std::move(job), continuation_counter });
+}
+
+static void worker_loop(unsigned index)
+{
+    current_thread_index = index;
+    while (true) {
+        if (auto task = pop()) {
+            execute(*task);
+            continue;
+        }
+        std::unique_lock lock(sleep_mutex);
+        wake.wait(lock, [] {
+            return queued.load(std::memory_order_acquire) > 0 || !running.load(std::memory_order_acquire);
+        });
+        if (!running.load(std::memory_order_acquire) && queued.load(std::memory_order_acquire) == 0)
+            return;
+    }
+}
+
+void init(unsigned worker_count)
+{
+    if (running.exchange(true))
+        return;
+
+    current_thread_index = 0;
+    for (unsigned i = 0; i <= worker_count; i++)
+        queues.push_back(std::make_unique<Queue>());
+    for (unsigned i = 1; i <= worker_count; i++)
+        workers.emplace_back(worker_loop, i);
+    LOGF("Job system started with %u workers.", worker_count);
+}
+
+void init()
+{
+    unsigned cores = std::thread::hardware_concurrency();
+    init(cores > 1 ? cores - 1 : 0);
+}
+
+void shutdown()
+{
+    if (!running.load())
+        return;
+
+    // Let the main thread take its part of the remaining jobs.
+    while (auto task = pop())
+        execute(*task);
+    pump_main();
+
+    {
+        std::lock_guard lock(sleep_mutex);
+        running.store(false);
+    }
+    wake.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+    workers.clear();
+    queues.clear();
+    LOG("Job system stopped.");
+}
+
+unsigned worker_count()
+{
+    return workers.size();
+}
+
+unsigned thread_index()
+{
+    return current_thread_index;
+}
+
+void run(Job job, Counter* counter)
+{
+    if (counter)
+        counter->pending_.fetch_add(1, std::memory_order_relaxed);
+    push({ std::move(job), counter });
+}
+
+void run_after(Counter& dependency, Job job, Counter* counter)
+{
+    if (counter)
+        counter->pending_.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard lock(dependency.mutex_);
+        if (!dependency.done()) {
+            dependency.continuations_.emplace_back(std::move(job), counter);
+            return;
+        }
+    }
+    push({ std::move(job), counter });
+}
+
+void run_on_main(Job job, Counter* counter)
+{
+    if (counter)
+        counter->pending_.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard lock(main_queue.mutex);
+    main_queue.tasks.push_back({ std::move(job), counter });
+}
+
+static bool pump_main_once()
+{
+    std::optional<Task> task;
+    {
+        std::lock_guard lock(main_queue.mutex);
+        if (main_queue.tasks.empty())
+            return false;
+        task = std::move(main_queue.tasks.front());
+        main_queue.tasks.pop_front();
+    }
+    execute(*task);
+    return true;
+}
+
+void pump_main()
+{
+    while (pump_main_once()) { }
+}
+
+void wait(Counter& counter)
+{
+    wait_until([&counter] { return counter.done(); });
+    std::lock_guard lock(counter.mutex_);
+}
+
+void wait_until(const std::function<bool()>& condition)
+{
+    while (!condition()) {
+        if (current_thread_index == 0 && pump_main_once())
+            continue;
+        if (auto task = pop())
+            execute(*task);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void parallel_for(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body)
+{
+    if (grain == 0)
+        grain = 1;
+    Counter counter;
+    for (size_t range_begin = begin; range_begin < end; range_begin += grain) {
+        size_t range_end = std::min(range_begin + grain, end);
+        run([&body, range_begin, range_end] { body(range_begin, range_end); }, &counter);
+    }
+    wait(counter);
+}
+
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Work-stealing job scheduler.
+ *
+ * Every thread, the main one included, owns a deque: it pushes and pops its own jobs at the back and
+ * steals from the front of the others' when it runs dry. Jobs that must run on the main thread (GL
+ * calls) go to a separate queue drained by pump_main().
+ */
+namespace ngn::jobs {
+
+using Job = std::function<void()>;
+
+/**
+ * @brief Number of unfinished jobs attached to it. Jobs can wait on it or be scheduled after it.
+ */
+class Counter {
+public:
+    Counter() = default;
+
+    Counter(const Counter&) = delete;
+    Counter& operator=(const Counter&) = delete;
+    Counter(Counter&&) = delete;
+
+    bool done() const;
+
+private:
+    std::atomic<int> pending_ { 0 };
+    std::mutex mutex_;
+    /**
+     * @brief Jobs to schedule when the counter reaches zero.
+     */
+    std::vector<std::pair<Job, Counter*>> continuations_;
+
+    friend void run(Job job, Counter* counter);
+    friend void run_after(Counter& dependency, Job job, Counter* counter);
+    friend void run_on_main(Job job, Counter* counter);
+    friend void finish(Counter* counter);
+    friend void wait(Counter& counter);
+};
+
+/**
+ * @brief Starts {{worker_count}} worker threads. By default, one per core besides the main thread.
+ */
+void init(unsigned worker_count);
+void init();
+/**
+ * @brief Runs the remaining jobs and joins the workers.
+ */
+void shutdown();
+
+unsigned worker_count();
+/**
+ * @brief 0 on the main thread, 1 to worker_count() on workers.
+ */
+unsigned thread_index();
+
+/**
+ * @brief Schedules {{job}} on any thread. {{counter}}, if any, is decremented when it is done.
+ */
+void run(Job job, Counter* counter = nullptr);
+/**
+ * @brief Schedules {{job}} on any thread once {{dependency}} reaches zero.
+ */
+void run_after(Counter& dependency, Job job, Counter* counter = nullptr);
+/**
+ * @brief Schedules {{job}} on the main thread, the one owning the GL context.
+ */
+void run_on_main(Job job, Counter* counter = nullptr);
+/**
+ * @brief Runs the pending main thread jobs. Must be called from the main thread.
+ */
+void pump_main();
+
+/**
+ * @brief Runs jobs until {{counter}} reaches zero.
+ */
+void wait(Counter& counter);
+/**
+ * @brief Runs jobs until {{condition}} holds, e.g. until a queue has room again.
+ */
+void wait_until(const std::function<bool()>& condition);
+
+/**
+ * @brief Calls {{body}} on [begin, end) split in ranges of at most {{grain}} elements, and waits for all of them.
+ */
+void parallel_for(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+}
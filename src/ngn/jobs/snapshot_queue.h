@@ -0,0 +1,100 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace ngn {
+
+/**
+ * @brief Fixed ring of reusable snapshots handed from one producer thread to one consumer thread, in order.
+ *
+ * The producer fills a free slot while the consumer reads an older one, so with N slots the producer may run
+ * up to N - 1 snapshots ahead before waiting. Slots are recycled, not reallocated: containers in a snapshot
+ * keep their capacity from one use to the next.
+ */
+template <class T>
+class SnapshotQueue {
+public:
+    SnapshotQueue(size_t slot_count)
+        : slots_(slot_count)
+    {
+    }
+
+    SnapshotQueue(const SnapshotQueue&) = delete;
+    SnapshotQueue& operator=(const SnapshotQueue&) = delete;
+    SnapshotQueue(SnapshotQueue&&) = delete;
+
+    /**
+     * @brief Waits for a free slot to fill, then submit().
+     *
+     * @return nullptr once closed.
+     */
+    T* acquire_write()
+    {
+        std::unique_lock lock(mutex_);
+        changed_.wait(lock, [this] { return closed_ || submitted_ + reading_ < slots_.size(); });
+        if (closed_)
+            return nullptr;
+        return &slots_[(read_ + submitted_ + reading_) % slots_.size()];
+    }
+
+    void submit()
+    {
+        {
+            std::lock_guard lock(mutex_);
+            submitted_++;
+        }
+        changed_.notify_all();
+    }
+
+    /**
+     * @brief Waits for the oldest submitted snapshot, to release() once consumed.
+     *
+     * @return nullptr once closed and every submitted snapshot was consumed.
+     */
+    T* acquire_read()
+    {
+        std::unique_lock lock(mutex_);
+        changed_.wait(lock, [this] { return closed_ || submitted_ > 0; });
+        if (submitted_ == 0)
+            return nullptr;
+        submitted_--;
+        reading_ = 1;
+        return &slots_[read_];
+    }
+
+    void release()
+    {
+        {
+            std::lock_guard lock(mutex_);
+            read_ = (read_ + 1) % slots_.size();
+            reading_ = 0;
+        }
+        changed_.notify_all();
+    }
+
+    /**
+     * @brief Wakes both sides up: the producer stops, the consumer drains what was submitted.
+     */
+    void close()
+    {
+        {
+            std::lock_guard lock(mutex_);
+            closed_ = true;
+        }
+        changed_.notify_all();
+    }
+
+private:
+    std::vector<T> slots_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    size_t read_ { 0 };
+    size_t submitted_ { 0 };
+    size_t reading_ { 0 };
+    bool closed_ { false };
+};
+
+}
@@ -0,0 +1,305 @@
+#include "batch_transform.h"
+
+#include "../utils/log.h"
+
+#include <glm/ext/matrix_transform.hpp>
+
+#include <cmath>
+#include <random>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NGN_X86
+#include <immintrin.h>
+#endif
+
+namespace ngn {
+
+void TransformBatch::resize(size_t count)
+{
+    for (auto& component : translation)
+        component.resize(count);
+    for (auto& component : rotation)
+        component.resize(count);
+    for (auto& component : scale)
+        component.resize(count);
+}
+
+size_t TransformBatch::size() const
+{
+    return translation[0].size();
+}
+
+void TransformBatch::set(size_t index, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+{
+    for (int i = 0; i < 3; i++) {
+        this->translation[i][index] = translation[i];
+        this->scale[i][index] = scale[i];
+    }
+    this->rotation[0][index] = rotation.x;
+    this->rotation[1][index] = rotation.y;
+    this->rotation[2][index] = rotation.z;
+    this->rotation[3][index] = rotation.w;
+}
+
+const char* to_string(SimdLevel level)
+{
+    switch (level) {
+    case SimdLevel::Scalar:
+        return "scalar";
+    case SimdLevel::SSE:
+        return "SSE";
+    case SimdLevel::AVX2:
+        return "AVX2";
+    default:
+        return "scalar";
+    }
+}
+
+SimdLevel detect_simd_level()
+{
+#ifdef NGN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse2"))
+        return SimdLevel::SSE;
+#endif
+    return SimdLevel::Scalar;
+}
+
+// Kernels write instances [begin, end) to out, indexed from the start of the batch.
+static void compose_scalar(const TransformBatch& batch, size_t begin, size_t end, float* out)
+{
+    for (size_t i = begin; i < end; i++) {
+        float x = batch.rotation[0][i], y = batch.rotation[1][i], z = batch.rotation[2][i], w = batch.rotation[3][i];
+        float sx = batch.scale[0][i], sy = batch.scale[1][i], sz = batch.scale[2][i];
+        float xx = x * x, yy = y * y, zz = z * z;
+        float xy = x * y, xz = x * z, yz = y * z;
+        float wx = w * x, wy = w * y, wz = w * z;
+
+        float* m = out + 16 * i;
+        m[0] = (1 - 2 * (yy + zz)) * sx;
+        m[1] = 2 * (xy + wz) * sx;
+        m[2] = 2 * (xz - wy) * sx;
+        m[3] = 0;
+        m[4] = 2 * (xy - wz) * sy;
+        m[5] = (1 - 2 * (xx + zz)) * sy;
+        m[6] = 2 * (yz + wx) * sy;
+        m[7] = 0;
+        m[8] = 2 * (xz + wy) * sz;
+        m[9] = 2 * (yz - wx) * sz;
+        m[10] = (1 - 2 * (xx + yy)) * sz;
+        m[11] = 0;
+        m[12] = batch.translation[0][i];
+        m[13] = batch.translation[1][i];
+        m[14] = batch.translation[2][i];
+        m[15] = 1;
+    }
+}
+
+#ifdef NGN_X86
+
+__attribute__((target("sse2"))) static size_t compose_sse(const TransformBatch& batch, size_t begin, size_t end, float* out)
+{
+    const __m128 one = _mm_set1_ps(1);
+    const __m128 two = _mm_set1_ps(2);
+    const __m128 zero = _mm_setzero_ps();
+
+    size_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m128 x = _mm_loadu_ps(&batch.rotation[0][i]);
+        __m128 y = _mm_loadu_ps(&batch.rotation[1][i]);
+        __m128 z = _mm_loadu_ps(&batch.rotation[2][i]);
+        __m128 w = _mm_loadu_ps(&batch.rotation[3][i]);
+        __m128 sx = _mm_loadu_ps(&batch.scale[0][i]);
+        __m128 sy = _mm_loadu_ps(&batch.scale[1][i]);
+        __m128 sz = _mm_loadu_ps(&batch.scale[2][i]);
+
+        __m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+        __m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+        __m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+
+        // One register per matrix element, one lane per instance.
+        __m128 columns[4][4] = {
+            {
+                _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+                _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx),
+                _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx),
+                zero,
+            },
+            {
+                _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy),
+                _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+                _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy),
+                zero,
+            },
+            {
+                _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz),
+                _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz),
+                _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz),
+                zero,
+            },
+            {
+                _mm_loadu_ps(&batch.translation[0][i]),
+                _mm_loadu_ps(&batch.translation[1][i]),
+                _mm_loadu_ps(&batch.translation[2][i]),
+                one,
+            },
+        };
+
+        // Transpose to one register per instance column.
+        for (auto& column : columns)
+            _MM_TRANSPOSE4_PS(column[0], column[1], column[2], column[3]);
+
+        // Stores in address order, friendly to write-combined mapped memory.
+        float* m = out + 16 * i;
+        for (int instance = 0; instance < 4; instance++)
+            for (int column = 0; column < 4; column++)
+                _mm_storeu_ps(m + 16 * instance + 4 * column, columns[column][instance]);
+    }
+    return i;
+}
+
+__attribute__((target("avx2,fma"))) static size_t compose_avx2(const TransformBatch& batch, size_t begin, size_t end, float* out)
+{
+    const __m256 one = _mm256_set1_ps(1);
+    const __m256 two = _mm256_set1_ps(2);
+    const __m256 zero = _mm256_setzero_ps();
+
+    size_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m256 x = _mm256_loadu_ps(&batch.rotation[0][i]);
+        __m256 y = _mm256_loadu_ps(&batch.rotation[1][i]);
+        __m256 z = _mm256_loadu_ps(&batch.rotation[2][i]);
+        __m256 w = _mm256_loadu_ps(&batch.rotation[3][i]);
+        __m256 sx = _mm256_loadu_ps(&batch.scale[0][i]);
+        __m256 sy = _mm256_loadu_ps(&batch.scale[1][i]);
+        __m256 sz = _mm256_loadu_ps(&batch.scale[2][i]);
+
+        __m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), zz = _mm256_mul_ps(z, z);
+        __m256 xy = _mm256_mul_ps(x, y), xz = _mm256_mul_ps(x, z), yz = _mm256_mul_ps(y, z);
+        __m256 wx = _mm256_mul_ps(w, x), wy = _mm256_mul_ps(w, y), wz = _mm256_mul_ps(w, z);
+
+        // 1 - 2 * (a + b) as a single fused multiply-add
+        __m256 minus_two = _mm256_set1_ps(-2);
+        __m256 columns[4][4] = {
+            {
+                _mm256_mul_ps(_mm256_fmadd_ps(minus_two, _mm256_add_ps(yy, zz), one), sx),
+                _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xy, wz)), sx),
+                _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xz, wy)), sx),
+                zero,
+            },
+            {
+                _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(xy, wz)), sy),
+                _mm256_mul_ps(_mm256_fmadd_ps(minus_two, _mm256_add_ps(xx, zz), one), sy),
+                _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(yz, wx)), sy),
+                zero,
+            },
+            {
+                _mm256_mul_ps(_mm256_mul_ps(two, _mm256_add_ps(xz, wy)), sz),
+                _mm256_mul_ps(_mm256_mul_ps(two, _mm256_sub_ps(yz, wx)), sz),
+                _mm256_mul_ps(_mm256_fmadd_ps(minus_two, _mm256_add_ps(xx, yy), one), sz),
+                zero,
+            },
+            {
+                _mm256_loadu_ps(&batch.translation[0][i]),
+                _mm256_loadu_ps(&batch.translation[1][i]),
+                _mm256_loadu_ps(&batch.translation[2][i]),
+                one,
+            },
+        };
+
+        // Transpose each 4x8 block: afterwards the low half of columns[c][k] is instance k's column c,
+        // and the high half is instance k + 4's.
+        for (auto& column : columns) {
+            __m256 t0 = _mm256_unpacklo_ps(column[0], column[1]);
+            __m256 t1 = _mm256_unpackhi_ps(column[0], column[1]);
+            __m256 t2 = _mm256_unpacklo_ps(column[2], column[3]);
+            __m256 t3 = _mm256_unpackhi_ps(column[2], column[3]);
+            column[0] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+            column[1] = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+            column[2] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+            column[3] = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+        }
+
+        // Two columns per 256 bit store, in address order.
+        float* m = out + 16 * i;
+        for (int instance = 0; instance < 4; instance++) {
+            _mm256_storeu_ps(m + 16 * instance, _mm256_permute2f128_ps(columns[0][instance], columns[1][instance], 0x20));
+            _mm256_storeu_ps(m + 16 * instance + 8, _mm256_permute2f128_ps(columns[2][instance], columns[3][instance], 0x20));
+        }
+        for (int instance = 0; instance < 4; instance++) {
+            _mm256_storeu_ps(m + 16 * (instance + 4), _mm256_permute2f128_ps(columns[0][instance], columns[1][instance], 0x31));
+            _mm256_storeu_ps(m + 16 * (instance + 4) + 8, _mm256_permute2f128_ps(columns[2][instance], columns[3][instance], 0x31));
+        }
+    }
+    return i;
+}
+
+#endif
+
+void compose_transforms(const TransformBatch& batch, float* out, SimdLevel level)
+{
+    compose_transforms(batch, 0, batch.size(), out, level);
+}
+
+void compose_transforms(const TransformBatch& batch, size_t begin, size_t end, float* out, SimdLevel level)
+{
+    static const SimdLevel supported_level = detect_simd_level();
+    if (static_cast<int>(level) > static_cast<int>(supported_level))
+        level = supported_level;
+
+    // Each kernel handles what it can and leaves the tail to the next one.
+    size_t done = begin;
+#ifdef NGN_X86
+    if (level == SimdLevel::AVX2)
+        done = compose_avx2(batch, done, end, out);
+    if (level >= SimdLevel::SSE)
+        done = compose_sse(batch, done, end, out);
+#endif
+    compose_scalar(batch, done, end, out);
+}
+
+bool validate_compose_transforms()
+{
+    // Odd count, to exercise every kernel's tail.
+    constexpr size_t COUNT = 67;
+    std::mt19937 generator(42);
+    std::uniform_real_distribution<float> distribution(-10, 10);
+
+    TransformBatch batch;
+    batch.resize(COUNT);
+    std::vector<glm::mat4> expected(COUNT);
+    for (size_t i = 0; i < COUNT; i++) {
+        glm::vec3 translation { distribution(generator), distribution(generator), distribution(generator) };
+        glm::vec3 axis = glm::normalize(glm::vec3 { distribution(generator), distribution(generator), distribution(generator) });
+        glm::quat rotation = glm::angleAxis(distribution(generator), axis);
+        glm::vec3 scale { distribution(generator), distribution(generator), distribution(generator) };
+        batch.set(i, translation, rotation, scale);
+
+        glm::mat4 model(1);
+        model = glm::translate(model, translation);
+        model = model * glm::mat4_cast(rotation);
+        model = glm::scale(model, scale);
+        expected[i] = model;
+    }
+
+    bool valid = true;
+    std::vector<float> out(COUNT * 16);
+    for (int level = 0; level <= static_cast<int>(detect_simd_level()); level++) {
+        compose_transforms(batch, out.data(), static_cast<SimdLevel>(level));
+        for (size_t i = 0; i < COUNT; i++) {
+            for (int element = 0; element < 16; element++) {
+                float difference = std::abs(out[16 * i + element] - expected[i][element / 4][element % 4]);
+                if (difference > 1e-3f) {
+                    LOGERRF("ERROR::BATCH_TRANSFORM::%s kernel differs from glm at instance %zu", to_string(static_cast<SimdLevel>(level)), i);
+                    valid = false;
+                    break;
+                }
+            }
+        }
+    }
+    return valid;
+}
+
+}
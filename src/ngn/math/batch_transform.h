@@ -0,0 +1,58 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <array>
+#include <vector>
+
+namespace ngn {
+
+/**
+ * @brief Translations, rotations and scales of many instances, one array per component.
+ */
+struct TransformBatch {
+    std::array<std::vector<float>, 3> translation;
+    /**
+     * @brief Quaternion components, in x, y, z, w order.
+     */
+    std::array<std::vector<float>, 4> rotation;
+    std::array<std::vector<float>, 3> scale;
+
+    void resize(size_t count);
+    size_t size() const;
+    void set(size_t index, const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale);
+};
+
+enum class SimdLevel : int {
+    Scalar,
+    SSE,
+    AVX2,
+};
+
+const char* to_string(SimdLevel level);
+
+/**
+ * @brief Best instruction set supported by the running CPU.
+ */
+SimdLevel detect_simd_level();
+
+/**
+ * @brief Composes translation * rotation * scale for every instance of {{batch}}.
+ *
+ * Writes {{batch.size()}} column major 4x4 matrices, 16 floats each and in instance order, to {{out}},
+ * which may be a mapped buffer. Uses the best kernel available up to {{level}}.
+ */
+void compose_transforms(const TransformBatch& batch, float* out, SimdLevel level = SimdLevel::AVX2);
+/**
+ * @brief Same as above for instances [begin, end) only. {{out}} still points to the first instance's matrix,
+ * so disjoint ranges can be composed in parallel into the same buffer.
+ */
+void compose_transforms(const TransformBatch& batch, size_t begin, size_t end, float* out, SimdLevel level = SimdLevel::AVX2);
+
+/**
+ * @brief Checks every available kernel against glm.
+ */
+bool validate_compose_transforms();
+
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+
+namespace ngn {
+
+/**
+ * @brief Axis aligned bounding box. Empty until extended, with min above max.
+ */
+struct Bounds {
+    glm::vec3 min { INFINITY };
+    glm::vec3 max { -INFINITY };
+
+    bool empty() const
+    {
+        return min.x > max.x;
+    }
+
+    void extend(const glm::vec3& point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void extend(const Bounds& other)
+    {
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+    }
+
+    bool contains(const glm::vec3& point, float margin = 0) const
+    {
+        for (int axis = 0; axis < 3; axis++) {
+            if (point[axis] < min[axis] - margin || point[axis] > max[axis] + margin)
+                return false;
+        }
+        return true;
+    }
+};
+
+}
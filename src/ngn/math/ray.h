@@ -0,0 +1,15 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace ngn {
+
+/**
+ * @brief Half line from {{origin}}. Distances along it are in units of {{direction}}'s length.
+ */
+struct Ray {
+    glm::vec3 origin;
+    glm::vec3 direction;
+};
+
+}
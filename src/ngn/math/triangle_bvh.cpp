@@ -0,0 +1,319 @@
+#include "triangle_bvh.h"
+
+#include "../jobs/jobs.h"
+
+#include <algorithm>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define NGN_X86
+#include <immintrin.h>
+#endif
+
+namespace ngn {
+
+constexpr unsigned BIN_COUNT = 16;
+constexpr uint32_t MAX_LEAF_TRIANGLES = 8;
+/**
+ * @brief Cost of visiting a node, relative to testing a triangle.
+ */
+constexpr float TRAVERSAL_COST = 1;
+/**
+ * @brief Deeper nodes become leaves, which bounds the traversal stack.
+ */
+constexpr unsigned MAX_DEPTH = 60;
+constexpr unsigned STACK_SIZE = 64;
+constexpr uint32_t PARALLEL_TRIANGLES = 16384;
+constexpr size_t PREPARE_GRAIN = 16384;
+
+static float half_area(const Bounds& bounds)
+{
+    if (bounds.empty())
+        return 0;
+    glm::vec3 extent = bounds.max - bounds.min;
+    return extent.x * extent.y + extent.y * extent.z + extent.z * extent.x;
+}
+
+/**
+ * @brief Triangle being sorted into the tree, with what the splits read, partitioned in place.
+ */
+struct Reference {
+    Bounds bounds;
+    glm::vec3 centroid;
+    uint32_t triangle;
+};
+
+struct TriangleBvh::Builder {
+    std::vector<Node>& nodes;
+    std::vector<Reference> references;
+    std::atomic<uint32_t> next_node { 1 };
+    bool parallel;
+
+    void build(uint32_t node_index, uint32_t begin, uint32_t end, unsigned depth);
+};
+
+static int bin_index(float centroid, float axis_min, float scale)
+{
+    return std::min(static_cast<int>(BIN_COUNT) - 1, static_cast<int>((centroid - axis_min) * scale));
+}
+
+void TriangleBvh::Builder::build(uint32_t node_index, uint32_t begin, uint32_t end, unsigned depth)
+{
+    Bounds node_bounds, centroid_bounds;
+    for (uint32_t i = begin; i < end; i++) {
+        node_bounds.extend(references[i].bounds);
+        centroid_bounds.extend(references[i].centroid);
+    }
+    Node& node = nodes[node_index];
+    node.min = node_bounds.min;
+    node.max = node_bounds.max;
+    node.first = begin;
+    node.count = end - begin;
+    if (node.count == 1 || depth >= MAX_DEPTH)
+        return;
+
+    // Bin the centroids along each axis and sweep the bins from both sides.
+    float best_cost = INFINITY;
+    int best_axis = -1;
+    int best_bin = 0;
+    for (int axis = 0; axis < 3; axis++) {
+        float extent = centroid_bounds.max[axis] - centroid_bounds.min[axis];
+        if (extent <= 0)
+            continue;
+        float scale = BIN_COUNT / extent;
+
+        Bounds bin_bounds[BIN_COUNT];
+        uint32_t bin_counts[BIN_COUNT] {};
+        for (uint32_t i = begin; i < end; i++) {
+            int bin = bin_index(references[i].centroid[axis], centroid_bounds.min[axis], scale);
+            bin_counts[bin]++;
+            bin_bounds[bin].extend(references[i].bounds);
+        }
+
+        float left_costs[BIN_COUNT - 1];
+        Bounds left;
+        uint32_t left_count = 0;
+        for (unsigned bin = 0; bin < BIN_COUNT - 1; bin++) {
+            left.extend(bin_bounds[bin]);
+            left_count += bin_counts[bin];
+            left_costs[bin] = left_count ? half_area(left) * left_count : INFINITY;
+        }
+        Bounds right;
+        uint32_t right_count = 0;
+        for (unsigned bin = BIN_COUNT - 1; bin > 0; bin--) {
+            right.extend(bin_bounds[bin]);
+            right_count += bin_counts[bin];
+            if (right_count == 0)
+                continue;
+            float cost = left_costs[bin - 1] + half_area(right) * right_count;
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin = bin;
+            }
+        }
+    }
+
+    // Splitting must be cheaper than testing every triangle, unless the leaf would be too large.
+    float leaf_cost = half_area(node_bounds) * node.count;
+    float split_cost = TRAVERSAL_COST * half_area(node_bounds) + best_cost;
+    if (best_axis < 0 || (node.count <= MAX_LEAF_TRIANGLES && split_cost >= leaf_cost))
+        return;
+
+    float axis_min = centroid_bounds.min[best_axis];
+    float scale = BIN_COUNT / (centroid_bounds.max[best_axis] - axis_min);
+    auto middle = std::partition(references.begin() + begin, references.begin() + end, [&](const Reference& reference) {
+        return bin_index(reference.centroid[best_axis], axis_min, scale) < best_bin;
+    });
+    uint32_t split = middle - references.begin();
+
+    uint32_t left_child = next_node.fetch_add(2, std::memory_order_relaxed);
+    node.first = left_child;
+    node.count = 0;
+    // Subtrees cover disjoint ranges of references and nodes, so they build concurrently.
+    if (parallel && end - begin >= PARALLEL_TRIANGLES) {
+        jobs::Counter counter;
+        jobs::run([this, left_child, begin, split, depth] { build(left_child, begin, split, depth + 1); }, &counter);
+        build(left_child + 1, split, end, depth + 1);
+        jobs::wait(counter);
+    } else {
+        build(left_child, begin, split, depth + 1);
+        build(left_child + 1, split, end, depth + 1);
+    }
+}
+
+TriangleBvh::TriangleBvh(const std::vector<glm::vec3>& positions, const std::vector<unsigned>& indices, bool parallel)
+{
+    uint32_t count = indices.size() / 3;
+    if (count == 0)
+        return;
+
+    Builder builder { nodes_ };
+    builder.parallel = parallel;
+    builder.references.resize(count);
+    auto prepare = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Reference& reference = builder.references[i];
+            for (int corner = 0; corner < 3; corner++)
+                reference.bounds.extend(positions[indices[3 * i + corner]]);
+            reference.centroid = (reference.bounds.min + reference.bounds.max) * .5f;
+            reference.triangle = i;
+        }
+    };
+    if (parallel)
+        jobs::parallel_for(0, count, PREPARE_GRAIN, prepare);
+    else
+        prepare(0, count);
+
+    // A binary tree with at least one triangle per leaf has at most 2n - 1 nodes.
+    nodes_.resize(2 * count - 1);
+    builder.build(0, 0, count, 0);
+    nodes_.resize(builder.next_node.load());
+    nodes_.shrink_to_fit();
+
+    triangles_.resize(count);
+    triangle_ids_.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t id = builder.references[i].triangle;
+        const unsigned* triangle = &indices[3 * id];
+        glm::vec3 vertex = positions[triangle[0]];
+        triangles_[i] = { vertex, positions[triangle[1]] - vertex, positions[triangle[2]] - vertex };
+        triangle_ids_[i] = id;
+    }
+}
+
+#ifdef NGN_X86
+/**
+ * @brief Entry distance of the ray into the node's bounds, clamped to 0, or INFINITY if it misses them
+ * before {{max_distance}}. The three axes are tested at once.
+ */
+static float intersect_box(const float* min, const float* max, __m128 origin, __m128 inverse_direction, float max_distance)
+{
+    // Lane 3 holds the node's index and count: it is replaced by the ray's range.
+    const __m128 xyz = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+    __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(min), origin), inverse_direction);
+    __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(max), origin), inverse_direction);
+    __m128 entries = _mm_and_ps(_mm_min_ps(t1, t2), xyz);
+    __m128 exits = _mm_or_ps(_mm_and_ps(_mm_max_ps(t1, t2), xyz), _mm_andnot_ps(xyz, _mm_set1_ps(max_distance)));
+
+    entries = _mm_max_ps(entries, _mm_shuffle_ps(entries, entries, _MM_SHUFFLE(2, 3, 0, 1)));
+    entries = _mm_max_ps(entries, _mm_shuffle_ps(entries, entries, _MM_SHUFFLE(1, 0, 3, 2)));
+    exits = _mm_min_ps(exits, _mm_shuffle_ps(exits, exits, _MM_SHUFFLE(2, 3, 0, 1)));
+    exits = _mm_min_ps(exits, _mm_shuffle_ps(exits, exits, _MM_SHUFFLE(1, 0, 3, 2)));
+    float enter = _mm_cvtss_f32(entries);
+    return enter <= _mm_cvtss_f32(exits) ? enter : INFINITY;
+}
+#else
+static float intersect_box(const glm::vec3& min, const glm::vec3& max, const glm::vec3& origin, const glm::vec3& inverse_direction, float max_distance)
+{
+    glm::vec3 t1 = (min - origin) * inverse_direction;
+    glm::vec3 t2 = (max - origin) * inverse_direction;
+    glm::vec3 entries = glm::min(t1, t2);
+    glm::vec3 exits = glm::max(t1, t2);
+    float enter = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.f));
+    float leave = std::min(std::min(exits.x, exits.y), std::min(exits.z, max_distance));
+    return enter <= leave ? enter : INFINITY;
+}
+#endif
+
+std::optional<TriangleHit> TriangleBvh::intersect(const Ray& ray, float max_distance) const
+{
+    if (nodes_.empty())
+        return std::nullopt;
+
+    glm::vec3 inverse_direction = 1.f / ray.direction;
+#ifdef NGN_X86
+    __m128 origin = _mm_setr_ps(ray.origin.x, ray.origin.y, ray.origin.z, 0);
+    __m128 inverse = _mm_setr_ps(inverse_direction.x, inverse_direction.y, inverse_direction.z, 0);
+    auto box_distance = [&](const Node& node, float max_distance) {
+        return intersect_box(&node.min.x, &node.max.x, origin, inverse, max_distance);
+    };
+#else
+    auto box_distance = [&](const Node& node, float max_distance) {
+        return intersect_box(node.min, node.max, ray.origin, inverse_direction, max_distance);
+    };
+#endif
+
+    TriangleHit hit { max_distance, 0, {} };
+    bool found = false;
+
+    struct Entry {
+        uint32_t node;
+        float distance;
+    };
+    Entry stack[STACK_SIZE];
+    unsigned stack_size = 0;
+    float root_distance = box_distance(nodes_[0], hit.distance);
+    if (root_distance != INFINITY)
+        stack[stack_size++] = { 0, root_distance };
+
+    while (stack_size > 0) {
+        Entry entry = stack[--stack_size];
+        // A closer hit was found since this node was pushed.
+        if (entry.distance >= hit.distance)
+            continue;
+        const Node& node = nodes_[entry.node];
+
+        if (node.count > 0) {
+            // Möller-Trumbore, double sided.
+            for (uint32_t i = node.first; i < node.first + node.count; i++) {
+                const Triangle& triangle = triangles_[i];
+                glm::vec3 p = glm::cross(ray.direction, triangle.edge2);
+                float determinant = glm::dot(triangle.edge1, p);
+                if (std::abs(determinant) < 1e-12f)
+                    continue;
+                float inverse_determinant = 1 / determinant;
+                glm::vec3 s = ray.origin - triangle.vertex;
+                float u = glm::dot(s, p) * inverse_determinant;
+                if (u < 0 || u > 1)
+                    continue;
+                glm::vec3 q = glm::cross(s, triangle.edge1);
+                float v = glm::dot(ray.direction, q) * inverse_determinant;
+                if (v < 0 || u + v > 1)
+                    continue;
+                float distance = glm::dot(triangle.edge2, q) * inverse_determinant;
+                if (distance >= 0 && distance < hit.distance) {
+                    hit = { distance, triangle_ids_[i], { u, v } };
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        // Push the farther child first, so the nearer one is visited next.
+        uint32_t near_child = node.first, far_child = node.first + 1;
+        float near_distance = box_distance(nodes_[near_child], hit.distance);
+        float far_distance = box_distance(nodes_[far_child], hit.distance);
+        if (near_distance > far_distance) {
+            std::swap(near_child, far_child);
+            std::swap(near_distance, far_distance);
+        }
+        if (far_distance != INFINITY)
+            stack[stack_size++] = { far_child, far_distance };
+        if (near_distance != INFINITY)
+            stack[stack_size++] = { near_child, near_distance };
+    }
+
+    if (!found)
+        return std::nullopt;
+    return hit;
+}
+
+size_t TriangleBvh::node_count() const
+{
+    return nodes_.size();
+}
+
+size_t TriangleBvh::triangle_count() const
+{
+    return triangles_.size();
+}
+
+Bounds TriangleBvh::bounds() const
+{
+    if (nodes_.empty())
+        return {};
+    return { nodes_[0].min, nodes_[0].max };
+}
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "bounds.h"
+#include "ray.h"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace ngn {
+
+struct TriangleHit {
+    float distance;
+    /**
+     * @brief Index of the triangle: its vertices are indices 3 * triangle to 3 * triangle + 2.
+     */
+    uint32_t triangle;
+    /**
+     * @brief Weights of the triangle's second and third vertices, the first one weighing 1 - x - y.
+     */
+    glm::vec2 barycentrics;
+};
+
+/**
+ * @brief Bounding volume hierarchy over the triangles of a mesh, for ray queries.
+ *
+ * Built top down, splitting where the surface area heuristic, evaluated over a few bins per axis, is
+ * lowest. Nodes are 32 bytes, two per cache line, and siblings are stored next to each other. Triangles
+ * are copied in leaf order, as a vertex and two edges, so leaves are read sequentially.
+ */
+class TriangleBvh {
+public:
+    TriangleBvh() = default;
+    /**
+     * @brief Builds over the triangles of {{indices}}, 3 per triangle.
+     *
+     * With {{parallel}}, large subtrees are built on the job system.
+     */
+    TriangleBvh(const std::vector<glm::vec3>& positions, const std::vector<unsigned>& indices, bool parallel = false);
+
+    /**
+     * @brief Closest triangle hit by {{ray}} closer than {{max_distance}}. Triangles are double sided.
+     */
+    std::optional<TriangleHit> intersect(const Ray& ray, float max_distance = INFINITY) const;
+
+    size_t node_count() const;
+    size_t triangle_count() const;
+    Bounds bounds() const;
+
+private:
+    struct Node {
+        glm::vec3 min;
+        /**
+         * @brief First triangle of a leaf, or left child of an inner node, the right one following it.
+         */
+        uint32_t first;
+        glm::vec3 max;
+        /**
+         * @brief Triangles of a leaf, 0 for an inner node.
+         */
+        uint32_t count;
+    };
+    static_assert(sizeof(Node) == 32);
+
+    struct Triangle {
+        glm::vec3 vertex;
+        glm::vec3 edge1;
+        glm::vec3 edge2;
+    };
+
+    struct Builder;
+
+    std::vector<Node> nodes_;
+    std::vector<Triangle> triangles_;
+    /**
+     * @brief Index of every triangle of triangles_ in the mesh.
+     */
+    std::vector<uint32_t> triangle_ids_;
+};
+
+}
@@ -1,9 +1,45 @@
 #pragma once
 
+#include "io/assimp_io_system.h"
+#include "io/compression.h"
+#include "io/file_system.h"
+#include "io/image_decoder.h"
+#include "io/image_encoder.h"
+#include "io/pack_archive.h"
+#include "io/pack_format.h"
+#include "jobs/jobs.h"
+#include "jobs/snapshot_queue.h"
+#include "math/batch_transform.h"
+#include "math/bounds.h"
+#include "math/ray.h"
+#include "math/triangle_bvh.h"
 #include "rendering/camera.h"
+#include "rendering/cascaded_shadow_map.h"
+#include "rendering/command_buffer.h"
+#include "rendering/dynamic_resolution.h"
+#include "rendering/frame_pacer.h"
+#include "rendering/framebuffer.h"
+#include "rendering/gl_capture.h"
+#include "rendering/gl_capture_format.h"
+#include "rendering/gl_context.h"
+#include "rendering/gl_fence.h"
+#include "rendering/gl_state.h"
+#include "rendering/gpu_instance_culler.h"
+#include "rendering/gpu_memory.h"
+#include "rendering/gpu_timer.h"
+#include "rendering/instance_buffer.h"
 #include "rendering/mesh.h"
 #include "rendering/model.h"
+#include "rendering/occlusion_culler.h"
+#include "rendering/readback_ring.h"
 #include "rendering/shader.h"
+#include "rendering/shader_library.h"
 #include "rendering/texture.h"
 #include "rendering/vertex.h"
+#include "rendering/weighted_blended_oit.h"
+#include "scene/scene.h"
+#include "scene/static_batches.h"
+#include "utils/allocation_counter.h"
+#include "utils/frame_arena.h"
 #include "utils/log.h"
+#include "utils/radix_sort.h"
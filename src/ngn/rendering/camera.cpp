@@ -3,6 +3,8 @@
 #include "../utils/log.h"
 #include <glm/ext/matrix_transform.hpp>
 
+#include <cmath>
+
 namespace ngn {
 
 Camera::Camera(const CameraOptions& options)
@@ -85,6 +87,14 @@ glm::vec3 Camera::position() const
     return position_;
 }
 
+Ray Camera::screen_ray(const glm::vec2& cursor, const glm::vec2& viewport) const
+{
+    float tangent = std::tan(glm::radians(fov_) / 2);
+    float x = (2 * cursor.x / viewport.x - 1) * tangent * viewport.x / viewport.y;
+    float y = (1 - 2 * cursor.y / viewport.y) * tangent;
+    return { position_, glm::normalize(front_ + x * right_ + y * up_) };
+}
+
 void Camera::update_vectors()
 {
     glm::vec3 front;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "../math/ray.h"
+
 #include <glm/glm.hpp>
 
 #include <array>
@@ -51,6 +53,11 @@ public:
     glm::vec3 up() const;
     glm::vec3 position() const;
 
+    /**
+     * @brief Ray from the camera through {{cursor}}, in pixels from the top left of a {{viewport}} sized view.
+     */
+    Ray screen_ray(const glm::vec2& cursor, const glm::vec2& viewport) const;
+
 private:
     /**
      * @brief Updates the camera's vectors based on current yaw and pitch.
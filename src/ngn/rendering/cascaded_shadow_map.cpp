@@ -0,0 +1,205 @@
+#include "cascaded_shadow_map.h"
+
+#include "../utils/frame_arena.h"
+#include "../utils/log.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
+
+#include <glad/glad.h>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace ngn {
+
+static unsigned create_depth_array(unsigned resolution, unsigned layers)
+{
+    unsigned texture;
+    glGenTextures(1, &texture);
+    GLState::bind_texture(0, GL_TEXTURE_2D_ARRAY, texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, resolution, resolution, layers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    GpuMemory::track(GL_TEXTURE, texture, GpuMemory::RenderTarget,
+        GpuMemory::texture_bytes(GL_DEPTH_COMPONENT24, resolution, resolution, layers, false), "Shadow map");
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // Outside of the map is lit
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+    const float border[] = { 1, 1, 1, 1 };
+    glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+    return texture;
+}
+
+static unsigned create_layer_framebuffer(unsigned texture, unsigned layer)
+{
+    unsigned framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, layer);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        LOGERR("ERROR::SHADOW_MAP::FRAMEBUFFER_INCOMPLETE");
+    }
+    return framebuffer;
+}
+
+CascadedShadowMap::CascadedShadowMap(const ShadowOptions& options)
+    : options_(options)
+    , depth_shader_("assets/shaders/depth.vert", "assets/shaders/depth.frag")
+{
+    static_depth_ = create_depth_array(options.resolution, CASCADE_COUNT);
+    depth_ = create_depth_array(options.resolution, CASCADE_COUNT);
+    // Only the sampled map compares, giving hardware filtered PCF.
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    GLState::bind_texture(0, GL_TEXTURE_2D_ARRAY, 0);
+
+    for (unsigned i = 0; i < CASCADE_COUNT; i++) {
+        static_framebuffers_[i] = create_layer_framebuffer(static_depth_, i);
+        framebuffers_[i] = create_layer_framebuffer(depth_, i);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    depth_shader_.use();
+    depth_shader_.set("view", glm::mat4(1));
+    LOGF("Shadow map %u created.", depth_);
+}
+
+CascadedShadowMap::~CascadedShadowMap()
+{
+    LOGF("Shadow map %u deleted.", depth_);
+    glDeleteFramebuffers(CASCADE_COUNT, static_framebuffers_.data());
+    glDeleteFramebuffers(CASCADE_COUNT, framebuffers_.data());
+    GLState::forget_texture(static_depth_);
+    GLState::forget_texture(depth_);
+    GpuMemory::untrack(GL_TEXTURE, static_depth_);
+    GpuMemory::untrack(GL_TEXTURE, depth_);
+    glDeleteTextures(1, &static_depth_);
+    glDeleteTextures(1, &depth_);
+}
+
+void CascadedShadowMap::update(const glm::mat4& view, float fov, float aspect, float near, const glm::vec3& light_direction,
+    const DrawCasters& draw_static, const DrawCasters& draw_dynamic)
+{
+    cascades_rendered_ = 0;
+    if (glm::length(light_direction) == 0)
+        return;
+    glm::vec3 direction = glm::normalize(light_direction);
+    glm::vec3 up = std::abs(direction.y) > .99f ? glm::vec3 { 0, 0, 1 } : glm::vec3 { 0, 1, 0 };
+    glm::mat4 light_view = glm::lookAt(glm::vec3 { 0 }, direction, up);
+    glm::mat4 camera_to_light = light_view * glm::inverse(view);
+
+    float tan_half_fov = std::tan(fov / 2);
+    float far = options_.distance;
+    float resolution = options_.resolution;
+
+    glViewport(0, 0, options_.resolution, options_.resolution);
+    GLState::set_enabled(GL_POLYGON_OFFSET_FILL, true);
+    glPolygonOffset(2, 4);
+    depth_shader_.use();
+
+    float slice_near = near;
+    for (unsigned i = 0; i < CASCADE_COUNT; i++) {
+        Cascade& cascade = cascades_[i];
+
+        // Practical split scheme: blend of logarithmic and uniform splits.
+        float ratio = static_cast<float>(i + 1) / CASCADE_COUNT;
+        float logarithmic = near * std::pow(far / near, ratio);
+        float uniform = near + (far - near) * ratio;
+        float slice_far = options_.split_lambda * logarithmic + (1 - options_.split_lambda) * uniform;
+        cascade.split = slice_far;
+
+        // Bounding sphere of the frustum slice, in light space. A sphere does not change with the camera's
+        // orientation, which keeps the cached area valid while looking around.
+        glm::vec3 corners[8];
+        for (int corner = 0; corner < 8; corner++) {
+            float distance = corner & 4 ? slice_far : slice_near;
+            float half_height = distance * tan_half_fov;
+            glm::vec4 view_corner {
+                (corner & 1 ? 1 : -1) * half_height * aspect,
+                (corner & 2 ? 1 : -1) * half_height,
+                -distance,
+                1,
+            };
+            corners[corner] = glm::vec3(camera_to_light * view_corner);
+        }
+        glm::vec3 center { 0 };
+        for (auto& corner : corners)
+            center += corner;
+        center /= 8.f;
+        float radius = 0;
+        for (auto& corner : corners)
+            radius = std::max(radius, glm::length(corner - center));
+        slice_near = slice_far;
+
+        bool same_light = cascade.cached && glm::dot(direction, cascade.light_direction) > .99999f;
+        bool fits = std::abs(center.x - cascade.center.x) + radius <= cascade.radius
+            && std::abs(center.y - cascade.center.y) + radius <= cascade.radius
+            && std::abs(center.z - cascade.center.z) + radius <= cascade.radius
+            && radius * 2 >= cascade.radius;
+        if (!same_light || !fits) {
+            float cached_radius = radius * (1 + options_.cache_margin);
+            // Snap to whole texels so static shadow edges do not shimmer when the cache moves.
+            float texel = 2 * cached_radius / resolution;
+            cascade.center = {
+                std::floor(center.x / texel) * texel,
+                std::floor(center.y / texel) * texel,
+                center.z,
+            };
+            cascade.radius = cached_radius;
+            cascade.light_direction = direction;
+            cascade.cached = true;
+
+            glm::mat4 light_projection = glm::ortho(
+                cascade.center.x - cached_radius, cascade.center.x + cached_radius,
+                cascade.center.y - cached_radius, cascade.center.y + cached_radius,
+                -(cascade.center.z + cached_radius) - options_.caster_distance, -(cascade.center.z - cached_radius));
+            cascade.light_space = light_projection * light_view;
+
+            glBindFramebuffer(GL_FRAMEBUFFER, static_framebuffers_[i]);
+            glClear(GL_DEPTH_BUFFER_BIT);
+            depth_shader_.set("projection", cascade.light_space);
+            draw_static(depth_shader_);
+            cascades_rendered_++;
+        }
+
+        // Start from the cached static casters and add the dynamic ones.
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, static_framebuffers_[i]);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers_[i]);
+        glBlitFramebuffer(0, 0, options_.resolution, options_.resolution, 0, 0, options_.resolution, options_.resolution,
+            GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffers_[i]);
+        depth_shader_.set("projection", cascade.light_space);
+        draw_dynamic(depth_shader_);
+    }
+
+    GLState::set_enabled(GL_POLYGON_OFFSET_FILL, false);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void CascadedShadowMap::invalidate()
+{
+    for (auto& cascade : cascades_)
+        cascade.cached = false;
+}
+
+void CascadedShadowMap::apply(const Shader& shader, int texture_unit) const
+{
+    GLState::bind_texture(texture_unit, GL_TEXTURE_2D_ARRAY, depth_);
+
+    shader.set("shadowMap", texture_unit);
+    for (unsigned i = 0; i < CASCADE_COUNT; i++) {
+        shader.set(frame_arena().format("lightSpaceMatrices[%u]", i), cascades_[i].light_space);
+        shader.set(frame_arena().format("cascadeSplits[%u]", i), cascades_[i].split);
+    }
+}
+
+unsigned CascadedShadowMap::cascades_rendered() const
+{
+    return cascades_rendered_;
+}
+
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "shader.h"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <functional>
+
+namespace ngn {
+
+struct ShadowOptions {
+    unsigned resolution { 2048 };
+    /**
+     * @brief View distance covered by the cascades.
+     */
+    float distance { 50 };
+    /**
+     * @brief Blend between uniform (0) and logarithmic (1) cascade splits.
+     */
+    float split_lambda { .75 };
+    /**
+     * @brief Extra coverage rendered around a cascade so the static cache survives small camera moves.
+     */
+    float cache_margin { .25 };
+    /**
+     * @brief How far towards the light casters outside a cascade are still captured.
+     */
+    float caster_distance { 50 };
+};
+
+/**
+ * @brief Cascaded shadow maps for a directional light, with static casters cached across frames.
+ *
+ * Static casters are rendered into a cache layer per cascade, only when the light or the cascade bounds
+ * move out of what was cached. Every frame the cache is copied into the sampled layer and dynamic casters
+ * are drawn on top.
+ */
+class CascadedShadowMap {
+public:
+    static constexpr unsigned CASCADE_COUNT = 4;
+
+    /**
+     * @brief Draws shadow casters with the given depth shader, setting its "model" uniform.
+     */
+    using DrawCasters = std::function<void(const Shader&)>;
+
+    CascadedShadowMap(const ShadowOptions& options);
+    ~CascadedShadowMap();
+
+    CascadedShadowMap(const CascadedShadowMap&) = delete;
+    CascadedShadowMap& operator=(const CascadedShadowMap&) = delete;
+    CascadedShadowMap(CascadedShadowMap&&) = delete;
+
+    /**
+     * @brief Fits the cascades to the camera frustum and renders the casters.
+     *
+     * Leaves framebuffer 0 bound: the caller restores its own framebuffer and viewport.
+     */
+    void update(const glm::mat4& view, float fov, float aspect, float near, const glm::vec3& light_direction,
+        const DrawCasters& draw_static, const DrawCasters& draw_dynamic);
+    /**
+     * @brief Forces the static cache to be rendered again, e.g. when static geometry changed.
+     */
+    void invalidate();
+
+    /**
+     * @brief Binds the shadow map to {{texture_unit}} and sets the sampling uniforms of {{shader}}.
+     */
+    void apply(const Shader& shader, int texture_unit) const;
+
+    /**
+     * @brief Number of cascades whose static cache was rendered during the last update.
+     */
+    unsigned cascades_rendered() const;
+
+private:
+    struct Cascade {
+        glm::mat4 light_space { 1 };
+        /**
+         * @brief Light space bounding sphere of the cached area.
+         */
+        glm::vec3 center { 0 };
+        float radius { 0 };
+        glm::vec3 light_direction { 0 };
+        float split { 0 };
+        bool cached { false };
+    };
+
+    ShadowOptions options_;
+    Shader depth_shader_;
+    std::array<Cascade, CASCADE_COUNT> cascades_;
+    unsigned cascades_rendered_ { 0 };
+
+    unsigned static_depth_, depth_;
+    std::array<unsigned, CASCADE_COUNT> static_framebuffers_, framebuffers_;
+};
+
+}
@@ -0,0 +1,69 @@
+#include "command_buffer.h"
+
+#include "../jobs/jobs.h"
+#include "../utils/radix_sort.h"
+
+namespace ngn {
+
+void CommandBuffer::clear()
+{
+    packets_.clear();
+}
+
+void CommandBuffer::draw(const DrawPacket& packet)
+{
+    packets_.push_back(packet);
+}
+
+const std::vector<DrawPacket>& CommandBuffer::packets() const
+{
+    return packets_;
+}
+
+void CommandList::reset()
+{
+    if (buffers_.size() != jobs::worker_count() + 1)
+        buffers_ = std::vector<CommandBuffer>(jobs::worker_count() + 1);
+    for (auto& buffer : buffers_)
+        buffer.clear();
+    sorted_.clear();
+}
+
+CommandBuffer& CommandList::local()
+{
+    return buffers_[jobs::thread_index()];
+}
+
+void CommandList::sort()
+{
+    // Concatenate the buffers, then sort keys holding the merged index and gather the packets once in order.
+    merged_.clear();
+    for (auto& buffer : buffers_)
+        merged_.insert(merged_.end(), buffer.packets().begin(), buffer.packets().end());
+
+    size_t count = merged_.size();
+    keys_.resize(count);
+    scratch_.resize(count);
+    for (size_t i = 0; i < count; i++)
+        keys_[i] = static_cast<uint64_t>(merged_[i].sort_key) << 32 | i;
+    radix_sort(keys_.data(), scratch_.data(), count);
+
+    sorted_.resize(count);
+    for (size_t i = 0; i < count; i++)
+        sorted_[i] = merged_[static_cast<uint32_t>(keys_[i])];
+}
+
+const std::vector<DrawPacket>& CommandList::sorted() const
+{
+    return sorted_;
+}
+
+size_t CommandList::size() const
+{
+    size_t count = 0;
+    for (auto& buffer : buffers_)
+        count += buffer.packets().size();
+    return count;
+}
+
+}
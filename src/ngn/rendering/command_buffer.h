@@ -0,0 +1,84 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ngn {
+
+class Mesh;
+
+/**
+ * @brief One draw, independent of the graphics API: what to draw, where, and in which order.
+ */
+struct DrawPacket {
+    glm::mat4 model;
+    const Mesh* mesh;
+    /**
+     * @brief Replay order, ascending. Packets with equal keys keep their recording order within a buffer.
+     */
+    uint32_t sort_key;
+    /**
+     * @brief Caller chosen index, identifying the draw across frames.
+     */
+    uint32_t object;
+    bool is_static;
+};
+
+/**
+ * @brief Linear buffer of packets recorded by one thread. Keeps its capacity when cleared.
+ *
+ * Aligned to a cache line, so that threads appending to neighbouring buffers do not share one.
+ */
+class alignas(64) CommandBuffer {
+public:
+    void clear();
+    void draw(const DrawPacket& packet);
+
+    const std::vector<DrawPacket>& packets() const;
+
+private:
+    std::vector<DrawPacket> packets_;
+};
+
+/**
+ * @brief Draws recorded in parallel into one CommandBuffer per job thread, then merged and sorted for replay.
+ *
+ * Recording happens on the job threads through local(), which never contends. Merging and sorting do not
+ * use the job system, so they can run on the thread owning the GL context.
+ */
+class CommandList {
+public:
+    /**
+     * @brief Clears every buffer, one per thread of the job system as currently started.
+     */
+    void reset();
+
+    /**
+     * @brief Buffer of the calling job thread.
+     */
+    CommandBuffer& local();
+
+    /**
+     * @brief Merges the buffers into one list, sorted by key.
+     */
+    void sort();
+
+    /**
+     * @brief Packets in replay order, valid after sort() until the next reset().
+     */
+    const std::vector<DrawPacket>& sorted() const;
+
+    size_t size() const;
+
+private:
+    std::vector<CommandBuffer> buffers_;
+    std::vector<DrawPacket> merged_;
+    std::vector<DrawPacket> sorted_;
+    std::vector<uint64_t> keys_;
+    std::vector<uint64_t> scratch_;
+};
+
+}
@@ -0,0 +1,34 @@
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ngn {
+
+// Aim a bit under the target to absorb frame to frame variance.
+constexpr float HEADROOM = .9;
+// Relative distance to the aimed time within which the scale holds.
+constexpr float DEAD_BAND = .05;
+constexpr float DAMPING = .1;
+
+float DynamicResolution::update(float gpu_milliseconds, const DynamicResolutionTarget& target)
+{
+    // No measure yet.
+    if (gpu_milliseconds > 0) {
+        float aimed = target.frame_milliseconds * HEADROOM;
+        float error = gpu_milliseconds / aimed - 1;
+        if (std::abs(error) > DEAD_BAND) {
+            float estimate = scale_ * std::sqrt(aimed / gpu_milliseconds);
+            scale_ += (estimate - scale_) * DAMPING;
+        }
+    }
+    scale_ = std::clamp(scale_, target.min_scale, target.max_scale);
+    return scale_;
+}
+
+float DynamicResolution::scale() const
+{
+    return scale_;
+}
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+namespace ngn {
+
+struct DynamicResolutionTarget {
+    float frame_milliseconds { 16.6 };
+    float min_scale { .5 };
+    float max_scale { 1 };
+};
+
+/**
+ * @brief Adjusts the render resolution scale so the measured GPU frame time stays under a target.
+ *
+ * GPU cost is assumed proportional to the pixel count, i.e. to the square of the scale. The scale moves
+ * a fraction of the way to its estimate every frame and holds within a small band around the target,
+ * as measures arrive a few frames late and would otherwise make it oscillate.
+ */
+class DynamicResolution {
+public:
+    /**
+     * @brief Feeds the last GPU frame time and returns the scale to render the next frame with.
+     */
+    float update(float gpu_milliseconds, const DynamicResolutionTarget& target);
+    float scale() const;
+
+private:
+    float scale_ { 1 };
+};
+
+}
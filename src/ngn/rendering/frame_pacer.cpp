@@ -0,0 +1,143 @@
+#include "frame_pacer.h"
+
+#include "gl_fence.h"
+
+#include <glad/glad.h>
+
+#include <GLFW/glfw3.h>
+
+#include <cmath>
+#include <thread>
+
+namespace ngn {
+
+namespace {
+
+    /**
+     * @brief How early to stop sleeping and start spinning before a deadline.
+     */
+    constexpr auto SPIN_MARGIN = std::chrono::microseconds(2000);
+
+    /**
+     * @brief Weight of the newest sample in the running averages.
+     */
+    constexpr float SMOOTHING = 0.1f;
+
+    float milliseconds(FramePacer::Clock::duration duration)
+    {
+        return std::chrono::duration<float, std::milli>(duration).count();
+    }
+
+    void smooth(float& average, float sample)
+    {
+        average = average == 0.0f ? sample : average + (sample - average) * SMOOTHING;
+    }
+
+}
+
+FramePacer::~FramePacer()
+{
+    for (size_t i = 0; i < fence_count_; i++)
+        glDeleteSync(static_cast<GLsync>(fences_[(first_fence_ + i) % fences_.size()].sync));
+}
+
+float FramePacer::limit(float max_fps)
+{
+    Clock::time_point start = Clock::now();
+    if (max_fps <= 0.0f) {
+        next_frame_ = {};
+        return 0.0f;
+    }
+
+    // Deadlines follow each other by exactly one period, so that oversleeping a frame shortens the next
+    // one instead of shifting every later frame. A frame late by more than a period starts a new schedule.
+    auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / max_fps));
+    next_frame_ += period;
+    if (next_frame_ + period < start)
+        next_frame_ = start;
+
+    if (next_frame_ - start > SPIN_MARGIN)
+        std::this_thread::sleep_until(next_frame_ - SPIN_MARGIN);
+    while (Clock::now() < next_frame_)
+        std::this_thread::yield();
+
+    return milliseconds(Clock::now() - start);
+}
+
+void FramePacer::set_swap_mode(SwapMode mode)
+{
+    int interval = 0;
+    switch (mode) {
+    case SwapMode::VSync:
+        interval = 1;
+        break;
+    case SwapMode::Adaptive:
+        interval = glfwExtensionSupported("WGL_EXT_swap_control_tear")
+                || glfwExtensionSupported("GLX_EXT_swap_control_tear")
+            ? -1
+            : 1;
+        break;
+    case SwapMode::Off:
+        interval = 0;
+        break;
+    }
+    if (interval == swap_interval_)
+        return;
+    glfwSwapInterval(interval);
+    swap_interval_ = interval;
+}
+
+void FramePacer::begin_frame(int max_frames_in_flight)
+{
+    if (max_frames_in_flight < 1)
+        max_frames_in_flight = 1;
+    if (max_frames_in_flight > MAX_FRAMES_IN_FLIGHT)
+        max_frames_in_flight = MAX_FRAMES_IN_FLIGHT;
+
+    // Collect what already finished, then wait for the oldest frames until there is room for this one.
+    while (fence_count_ > 0 && retire(false)) { }
+    Clock::time_point start = Clock::now();
+    while (fence_count_ >= static_cast<size_t>(max_frames_in_flight))
+        retire(true);
+    stats_.gpu_wait_ms = milliseconds(Clock::now() - start);
+    stats_.frames_in_flight = static_cast<unsigned>(fence_count_);
+}
+
+void FramePacer::end_frame(Clock::time_point input_time)
+{
+    // Only a frame that skipped begin_frame() can find the ring full.
+    if (fence_count_ == fences_.size())
+        retire(true);
+    fences_[(first_fence_ + fence_count_) % fences_.size()] = { glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), input_time };
+    fence_count_++;
+
+    Clock::time_point now = Clock::now();
+    if (last_swap_ != Clock::time_point {}) {
+        float interval = milliseconds(now - last_swap_);
+        smooth(stats_.interval_ms, interval);
+        smooth(stats_.jitter_ms, std::abs(interval - stats_.interval_ms));
+    }
+    last_swap_ = now;
+}
+
+const FramePacingStats& FramePacer::stats() const
+{
+    return stats_;
+}
+
+bool FramePacer::retire(bool wait)
+{
+    const Fence& fence = fences_[first_fence_];
+    if (!fence_passed(fence.sync, wait))
+        return false;
+
+    // Polled fences are seen signaled up to a frame late: the latency is an upper bound.
+    stats_.latency_ms = milliseconds(Clock::now() - fence.input_time);
+    smooth(stats_.average_latency_ms, stats_.latency_ms);
+    glDeleteSync(static_cast<GLsync>(fence.sync));
+    first_fence_ = (first_fence_ + 1) % fences_.size();
+    fence_count_--;
+    return true;
+}
+
+}
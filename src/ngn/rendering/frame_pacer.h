@@ -0,0 +1,107 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+
+namespace ngn {
+
+enum class SwapMode : int {
+    VSync,
+    /**
+     * @brief Synchronized, but late frames are shown at once instead of waiting for the next refresh.
+     * Falls back to VSync where the driver has no tearing swap control.
+     */
+    Adaptive,
+    Off,
+};
+
+struct FramePacingStats {
+    /**
+     * @brief From input sampling to the GPU finishing the frame, as last measured and averaged.
+     */
+    float latency_ms;
+    float average_latency_ms;
+    /**
+     * @brief Average time between swaps, and average deviation from it.
+     */
+    float interval_ms;
+    float jitter_ms;
+    /**
+     * @brief Time the last frame waited for earlier ones to leave the GPU.
+     */
+    float gpu_wait_ms;
+    unsigned frames_in_flight;
+};
+
+/**
+ * @brief Paces frames: swap interval, frame rate limit, and how many frames the GPU may lag behind.
+ *
+ * limit() belongs to the thread producing frames. The rest must be called by the thread owning the GL
+ * context: begin_frame() before the first GL call of a frame, end_frame() right after its swap. Fewer
+ * frames in flight means the CPU waits more, but the input a frame was built from reaches the screen
+ * sooner.
+ */
+class FramePacer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr int MAX_FRAMES_IN_FLIGHT = 3;
+
+    FramePacer() = default;
+    ~FramePacer();
+
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator=(const FramePacer&) = delete;
+    FramePacer(FramePacer&&) = delete;
+
+    /**
+     * @brief Waits until the next frame may start, at most {{max_fps}} per second; 0 does not limit.
+     *
+     * Sleeps most of the way, then spins, as sleeps can overshoot by a millisecond or more.
+     *
+     * @return Milliseconds waited.
+     */
+    float limit(float max_fps);
+
+    /**
+     * @brief Sets the swap interval for {{mode}}, when it changed.
+     */
+    void set_swap_mode(SwapMode mode);
+
+    /**
+     * @brief Waits until fewer than {{max_frames_in_flight}} earlier frames are unfinished on the GPU.
+     */
+    void begin_frame(int max_frames_in_flight);
+
+    /**
+     * @brief Fences the frame just swapped, built from input sampled at {{input_time}}.
+     */
+    void end_frame(Clock::time_point input_time);
+
+    const FramePacingStats& stats() const;
+
+private:
+    struct Fence {
+        void* sync;
+        Clock::time_point input_time;
+    };
+
+    /**
+     * @brief Retires the oldest fence once signaled, waiting for it when {{wait}}. @return Whether it was retired.
+     */
+    bool retire(bool wait);
+
+    Clock::time_point next_frame_ {};
+    int swap_interval_ { -2 };
+    /**
+     * @brief Ring of the frames in flight: begin_frame() keeps fewer than MAX_FRAMES_IN_FLIGHT, so the
+     * frame end_frame() fences always has a slot.
+     */
+    std::array<Fence, MAX_FRAMES_IN_FLIGHT> fences_ {};
+    size_t first_fence_ { 0 };
+    size_t fence_count_ { 0 };
+    Clock::time_point last_swap_ {};
+    FramePacingStats stats_ {};
+};
+
+}
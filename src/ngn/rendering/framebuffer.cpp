@@ -0,0 +1,90 @@
+#include "framebuffer.h"
+
+#include "../utils/log.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+
+namespace ngn {
+
+Framebuffer::~Framebuffer()
+{
+    release();
+}
+
+Framebuffer::Framebuffer(const std::string& name)
+    : name_(name)
+{
+}
+
+void Framebuffer::reserve(int width, int height)
+{
+    if (width <= width_ && height <= height_)
+        return;
+    release();
+    width_ = std::max(width, width_);
+    height_ = std::max(height, height_);
+
+    glGenFramebuffers(1, &framebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+
+    glGenTextures(1, &color_);
+    GLState::bind_texture(0, GL_TEXTURE_2D, color_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width_, height_, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    GpuMemory::track(GL_TEXTURE, color_, GpuMemory::RenderTarget, GpuMemory::texture_bytes(GL_RGBA8, width_, height_, 1, false), name_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, color_, 0);
+
+    // Same format as the default framebuffer and the OIT targets, so depth can be blitted between them.
+    glGenRenderbuffers(1, &depth_stencil_);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_stencil_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width_, height_);
+    GpuMemory::track(GL_RENDERBUFFER, depth_stencil_, GpuMemory::RenderTarget, GpuMemory::texture_bytes(GL_DEPTH24_STENCIL8, width_, height_, 1, false), name_);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_stencil_);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        LOGERR("ERROR::FRAMEBUFFER::INCOMPLETE");
+    }
+
+    GLState::bind_texture(0, GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    LOGF("Framebuffer resized to %dx%d.", width_, height_);
+}
+
+void Framebuffer::bind(int width, int height)
+{
+    reserve(width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glViewport(0, 0, width, height);
+}
+
+void Framebuffer::upscale(int width, int height, unsigned target, int target_width, int target_height) const
+{
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, target_width, target_height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    glViewport(0, 0, target_width, target_height);
+}
+
+unsigned Framebuffer::id() const
+{
+    return framebuffer_;
+}
+
+void Framebuffer::release()
+{
+    glDeleteFramebuffers(1, &framebuffer_);
+    GLState::forget_texture(color_);
+    GpuMemory::untrack(GL_TEXTURE, color_);
+    GpuMemory::untrack(GL_RENDERBUFFER, depth_stencil_);
+    glDeleteTextures(1, &color_);
+    glDeleteRenderbuffers(1, &depth_stencil_);
+    framebuffer_ = color_ = depth_stencil_ = 0;
+}
+
+}
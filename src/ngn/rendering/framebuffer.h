@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+
+namespace ngn {
+
+/**
+ * @brief Offscreen colour and depth-stencil target, with the same formats as the default framebuffer.
+ *
+ * Storage only grows, so rendering to a smaller viewport inside it never reallocates.
+ */
+class Framebuffer {
+public:
+    /**
+     * @brief {{name}} owns its allocations in GpuMemory.
+     */
+    Framebuffer(const std::string& name);
+    ~Framebuffer();
+
+    Framebuffer(const Framebuffer&) = delete;
+    Framebuffer& operator=(const Framebuffer&) = delete;
+    Framebuffer(Framebuffer&&) = delete;
+
+    /**
+     * @brief Makes sure a {{width}} by {{height}} area starting at the origin can be rendered to.
+     */
+    void reserve(int width, int height);
+    /**
+     * @brief Binds the framebuffer and sets the viewport to {{width}} by {{height}}.
+     */
+    void bind(int width, int height);
+    /**
+     * @brief Scales the {{width}} by {{height}} area into the whole of {{target}}, with bilinear filtering.
+     */
+    void upscale(int width, int height, unsigned target, int target_width, int target_height) const;
+
+    unsigned id() const;
+
+private:
+    void release();
+
+    std::string name_;
+    unsigned framebuffer_ { 0 };
+    unsigned color_ { 0 };
+    unsigned depth_stencil_ { 0 };
+    int width_ { 0 };
+    int height_ { 0 };
+};
+
+}
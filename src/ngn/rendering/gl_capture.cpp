@@ -0,0 +1,515 @@
+#include "gl_capture.h"
+
+#include "../io/compression.h"
+#include "../utils/log.h"
+#include "gl_capture_format.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <type_traits>
+#include <vector>
+
+namespace ngn {
+
+using gl_capture::Command;
+
+namespace {
+
+    using Proc = void (*)();
+
+    constexpr size_t COMMAND_COUNT = static_cast<size_t>(Command::FrameEnd) + 1;
+
+    struct Mapping {
+        GLintptr offset;
+        GLsizeiptr length;
+        GLbitfield access;
+        void* pointer;
+    };
+
+    struct Capture {
+        std::string path;
+        size_t skipped_frames = 0;
+        size_t frame_count = 0;
+        size_t frames = 0;
+        int width = 0;
+        int height = 0;
+        uint64_t setup_size = 0;
+        std::vector<std::byte> stream;
+        std::array<Proc, COMMAND_COUNT> originals {};
+        PFNGLUNMAPBUFFERPROC original_unmap_buffer = nullptr;
+        std::vector<std::function<void()>> restores;
+        /**
+         * @brief Buffer ranges mapped, by target, recorded with their contents when unmapped.
+         */
+        std::map<GLenum, Mapping> mappings;
+    };
+
+    bool capturing = false;
+    Capture capture;
+
+    template <typename T>
+    void write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if constexpr (std::is_pointer_v<T>) {
+            // Only ever an offset into a bound buffer.
+            write(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(value)));
+        } else {
+            auto* bytes = reinterpret_cast<const std::byte*>(&value);
+            capture.stream.insert(capture.stream.end(), bytes, bytes + sizeof(T));
+        }
+    }
+
+    void write_data(const void* data, size_t size)
+    {
+        write<uint64_t>(size);
+        auto* bytes = static_cast<const std::byte*>(data);
+        if (size > 0)
+            capture.stream.insert(capture.stream.end(), bytes, bytes + size);
+    }
+
+    template <typename... Args>
+    void record(Command command, const Args&... args)
+    {
+        write(command);
+        (write(args), ...);
+    }
+
+    /**
+     * @brief Whether {{command}} only produces results of its frame: drawn pixels, dispatched writes and
+     * query results. Before the captured frames, these are dropped, as the captured ones overwrite them.
+     */
+    constexpr bool frame_only(Command command)
+    {
+        switch (command) {
+        case Command::Clear:
+        case Command::ClearBufferfv:
+        case Command::DrawArrays:
+        case Command::DrawElements:
+        case Command::DrawElementsIndirect:
+        case Command::DrawElementsInstanced:
+        case Command::MultiDrawElements:
+        case Command::DispatchCompute:
+        case Command::BeginQuery:
+        case Command::EndQuery:
+        case Command::QueryCounter:
+        case Command::BeginConditionalRender:
+        case Command::EndConditionalRender:
+        case Command::GetQueryObjectiv:
+        case Command::GetQueryObjectuiv:
+        case Command::GetQueryObjectui64v:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    bool in_setup()
+    {
+        return capture.frames < capture.skipped_frames;
+    }
+
+    template <Command C, typename Function>
+    Function original()
+    {
+        return reinterpret_cast<Function>(capture.originals[static_cast<size_t>(C)]);
+    }
+
+    template <typename Function>
+    void wrap(Command command, Function& pointer, Function wrapper)
+    {
+        // Entry points the context does not provide stay missing.
+        if (!pointer)
+            return;
+        capture.originals[static_cast<size_t>(command)] = reinterpret_cast<Proc>(pointer);
+        capture.restores.push_back([&pointer, previous = pointer] { pointer = previous; });
+        pointer = wrapper;
+    }
+
+    template <Command C, typename... Args>
+    void APIENTRY record_simple(Args... args)
+    {
+        original<C, void(APIENTRYP)(Args...)>()(args...);
+        if (!frame_only(C) || !in_setup())
+            record(C, args...);
+    }
+
+    template <Command C, typename... Args>
+    void wrap_simple(void(APIENTRYP& pointer)(Args...))
+    {
+        wrap(C, pointer, &record_simple<C, Args...>);
+    }
+
+    template <Command C>
+    void APIENTRY record_generate(GLsizei count, GLuint* names)
+    {
+        original<C, void(APIENTRYP)(GLsizei, GLuint*)>()(count, names);
+        write(C);
+        write_data(names, count * sizeof(GLuint));
+    }
+
+    template <Command C>
+    void APIENTRY record_delete(GLsizei count, const GLuint* names)
+    {
+        original<C, void(APIENTRYP)(GLsizei, const GLuint*)>()(count, names);
+        write(C);
+        write_data(names, count * sizeof(GLuint));
+    }
+
+    template <Command C, typename T>
+    void APIENTRY record_get_query_object(GLuint query, GLenum parameter, T* value)
+    {
+        original<C, void(APIENTRYP)(GLuint, GLenum, T*)>()(query, parameter, value);
+        if (!in_setup())
+            record(C, query, parameter);
+    }
+
+    template <Command C, int COMPONENTS>
+    void APIENTRY record_uniform_vector(GLint location, GLsizei count, const GLfloat* value)
+    {
+        original<C, void(APIENTRYP)(GLint, GLsizei, const GLfloat*)>()(location, count, value);
+        record(C, location);
+        write_data(value, count * COMPONENTS * sizeof(GLfloat));
+    }
+
+    GLuint APIENTRY record_create_shader(GLenum type)
+    {
+        GLuint shader = original<Command::CreateShader, PFNGLCREATESHADERPROC>()(type);
+        record(Command::CreateShader, type, shader);
+        return shader;
+    }
+
+    GLuint APIENTRY record_create_program()
+    {
+        GLuint program = original<Command::CreateProgram, PFNGLCREATEPROGRAMPROC>()();
+        record(Command::CreateProgram, program);
+        return program;
+    }
+
+    void APIENTRY record_shader_source(GLuint shader, GLsizei count, const GLchar* const* strings, const GLint* lengths)
+    {
+        original<Command::ShaderSource, PFNGLSHADERSOURCEPROC>()(shader, count, strings, lengths);
+        std::string source;
+        for (GLsizei i = 0; i < count; i++)
+            source.append(strings[i], lengths && lengths[i] >= 0 ? lengths[i] : std::strlen(strings[i]));
+        record(Command::ShaderSource, shader);
+        write_data(source.data(), source.size());
+    }
+
+    GLint APIENTRY record_get_uniform_location(GLuint program, const GLchar* name)
+    {
+        GLint location = original<Command::GetUniformLocation, PFNGLGETUNIFORMLOCATIONPROC>()(program, name);
+        record(Command::GetUniformLocation, program);
+        write_data(name, std::strlen(name));
+        write(location);
+        return location;
+    }
+
+    void APIENTRY record_uniform_matrix_4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+    {
+        original<Command::UniformMatrix4fv, PFNGLUNIFORMMATRIX4FVPROC>()(location, count, transpose, value);
+        record(Command::UniformMatrix4fv, location, transpose);
+        write_data(value, count * 16 * sizeof(GLfloat));
+    }
+
+    void APIENTRY record_buffer_data(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+    {
+        original<Command::BufferData, PFNGLBUFFERDATAPROC>()(target, size, data, usage);
+        record(Command::BufferData, target, size, usage);
+        write_data(data, data ? size : 0);
+    }
+
+    void APIENTRY record_buffer_sub_data(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+    {
+        original<Command::BufferSubData, PFNGLBUFFERSUBDATAPROC>()(target, offset, size, data);
+        record(Command::BufferSubData, target, offset);
+        write_data(data, size);
+    }
+
+    void* APIENTRY record_map_buffer_range(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+    {
+        void* pointer = original<Command::MapBufferRange, PFNGLMAPBUFFERRANGEPROC>()(target, offset, length, access);
+        if (pointer)
+            capture.mappings[target] = { offset, length, access, pointer };
+        return pointer;
+    }
+
+    GLboolean APIENTRY record_unmap_buffer(GLenum target)
+    {
+        // What was written through the mapping is only known now: the pair is recorded at once.
+        auto mapping = capture.mappings.find(target);
+        if (mapping != capture.mappings.end()) {
+            auto& [offset, length, access, pointer] = mapping->second;
+            record(Command::MapBufferRange, target, offset, length, access);
+            write_data(pointer, access & GL_MAP_WRITE_BIT ? length : 0);
+            capture.mappings.erase(mapping);
+        }
+        return capture.original_unmap_buffer(target);
+    }
+
+    size_t pixel_bytes(GLenum format, GLenum type)
+    {
+        switch (type) {
+        case GL_UNSIGNED_INT_24_8:
+            return 4;
+        case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+            return 8;
+        }
+        size_t components = 4;
+        switch (format) {
+        case GL_RED:
+        case GL_RED_INTEGER:
+        case GL_DEPTH_COMPONENT:
+        case GL_STENCIL_INDEX:
+            components = 1;
+            break;
+        case GL_RG:
+        case GL_RG_INTEGER:
+            components = 2;
+            break;
+        case GL_RGB:
+        case GL_BGR:
+        case GL_RGB_INTEGER:
+            components = 3;
+            break;
+        }
+        switch (type) {
+        case GL_UNSIGNED_SHORT:
+        case GL_SHORT:
+        case GL_HALF_FLOAT:
+            return components * 2;
+        case GL_UNSIGNED_INT:
+        case GL_INT:
+        case GL_FLOAT:
+            return components * 4;
+        default:
+            return components;
+        }
+    }
+
+    /**
+     * @brief Bytes read by a texture upload, rows aligned as the default GL_UNPACK_ALIGNMENT, which the engine keeps.
+     */
+    size_t image_bytes(GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type)
+    {
+        constexpr size_t UNPACK_ALIGNMENT = 4;
+        size_t row = (width * pixel_bytes(format, type) + UNPACK_ALIGNMENT - 1) / UNPACK_ALIGNMENT * UNPACK_ALIGNMENT;
+        return row * height * depth;
+    }
+
+    void APIENTRY record_tex_image_2d(GLenum target, GLint level, GLint internal_format, GLsizei width, GLsizei height, GLint border, GLenum format, GLenum type, const void* pixels)
+    {
+        original<Command::TexImage2D, PFNGLTEXIMAGE2DPROC>()(target, level, internal_format, width, height, border, format, type, pixels);
+        record(Command::TexImage2D, target, level, internal_format, width, height, border, format, type);
+        write_data(pixels, pixels ? image_bytes(width, height, 1, format, type) : 0);
+    }
+
+    void APIENTRY record_tex_image_3d(GLenum target, GLint level, GLint internal_format, GLsizei width, GLsizei height, GLsizei depth, GLint border, GLenum format, GLenum type, const void* pixels)
+    {
+        original<Command::TexImage3D, PFNGLTEXIMAGE3DPROC>()(target, level, internal_format, width, height, depth, border, format, type, pixels);
+        record(Command::TexImage3D, target, level, internal_format, width, height, depth, border, format, type);
+        write_data(pixels, pixels ? image_bytes(width, height, depth, format, type) : 0);
+    }
+
+    void APIENTRY record_tex_parameter_fv(GLenum target, GLenum name, const GLfloat* values)
+    {
+        original<Command::TexParameterfv, PFNGLTEXPARAMETERFVPROC>()(target, name, values);
+        record(Command::TexParameterfv, target, name);
+        write_data(values, (name == GL_TEXTURE_BORDER_COLOR ? 4 : 1) * sizeof(GLfloat));
+    }
+
+    void APIENTRY record_clear_buffer_fv(GLenum buffer, GLint draw_buffer, const GLfloat* value)
+    {
+        original<Command::ClearBufferfv, PFNGLCLEARBUFFERFVPROC>()(buffer, draw_buffer, value);
+        if (in_setup())
+            return;
+        record(Command::ClearBufferfv, buffer, draw_buffer);
+        write_data(value, (buffer == GL_COLOR ? 4 : 1) * sizeof(GLfloat));
+    }
+
+    void APIENTRY record_draw_buffers(GLsizei count, const GLenum* buffers)
+    {
+        original<Command::DrawBuffers, PFNGLDRAWBUFFERSPROC>()(count, buffers);
+        write(Command::DrawBuffers);
+        write_data(buffers, count * sizeof(GLenum));
+    }
+
+    void APIENTRY record_multi_draw_elements(GLenum mode, const GLsizei* counts, GLenum type, const void* const* indices, GLsizei draw_count)
+    {
+        original<Command::MultiDrawElements, PFNGLMULTIDRAWELEMENTSPROC>()(mode, counts, type, indices, draw_count);
+        if (in_setup())
+            return;
+        record(Command::MultiDrawElements, mode, type);
+        write_data(counts, draw_count * sizeof(GLsizei));
+        write<uint64_t>(draw_count * sizeof(uint64_t));
+        for (GLsizei i = 0; i < draw_count; i++)
+            write(indices[i]);
+    }
+
+    void write_file()
+    {
+        gl_capture::Header header {};
+        std::memcpy(header.magic, gl_capture::MAGIC, sizeof(header.magic));
+        header.version = gl_capture::VERSION;
+        header.width = capture.width;
+        header.height = capture.height;
+        header.frame_count = capture.frames - capture.skipped_frames;
+        header.setup_size = capture.setup_size;
+        header.stream_size = capture.stream.size();
+
+        // Texture uploads dominate: they compress well.
+        std::vector<std::byte> compressed;
+        for (auto [compression, level] : { std::pair { pack::Compression::Zstd, 3 }, std::pair { pack::Compression::LZ4, 1 } }) {
+            if (compression_supported(compression)) {
+                compressed = compress(compression, capture.stream.data(), capture.stream.size(), level);
+                if (!compressed.empty()) {
+                    header.compression = compression;
+                    break;
+                }
+            }
+        }
+        const std::vector<std::byte>& stored = header.compression == pack::Compression::None ? capture.stream : compressed;
+        header.stored_size = stored.size();
+
+        std::ofstream output(capture.path, std::ios::binary | std::ios::trunc);
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        output.write(reinterpret_cast<const char*>(stored.data()), stored.size());
+        if (!output) {
+            LOGERRF("Failed to write the capture \"%s\".", capture.path.c_str());
+            return;
+        }
+        LOGF("Captured %u frames into %s: %.1f MiB of commands, %.1f MiB stored.", header.frame_count, capture.path.c_str(),
+            header.stream_size / (1024. * 1024.), header.stored_size / (1024. * 1024.));
+    }
+
+}
+
+void GLCapture::begin(const std::string& path, size_t skipped_frames, size_t frame_count)
+{
+    if (capturing)
+        return;
+    capture = {};
+    capture.path = path;
+    // Resources are created during the first frame at the latest: it always goes to the setup.
+    capture.skipped_frames = std::max<size_t>(skipped_frames, 1);
+    capture.frame_count = frame_count;
+
+#define NGN_GL_CAPTURE_WRAP_SIMPLE(name) wrap_simple<Command::name>(gl##name);
+    NGN_GL_CAPTURE_SIMPLE_COMMANDS(NGN_GL_CAPTURE_WRAP_SIMPLE)
+#undef NGN_GL_CAPTURE_WRAP_SIMPLE
+
+    // Names are recorded as they are, the replayer translates them.
+    wrap_simple<Command::DeleteShader>(glDeleteShader);
+    wrap_simple<Command::DeleteProgram>(glDeleteProgram);
+    wrap_simple<Command::BindBuffer>(glBindBuffer);
+    wrap_simple<Command::BindBufferBase>(glBindBufferBase);
+    wrap_simple<Command::BindTexture>(glBindTexture);
+    wrap_simple<Command::BindVertexArray>(glBindVertexArray);
+    wrap_simple<Command::BindFramebuffer>(glBindFramebuffer);
+    wrap_simple<Command::BindRenderbuffer>(glBindRenderbuffer);
+    wrap_simple<Command::UseProgram>(glUseProgram);
+    wrap_simple<Command::FramebufferTexture2D>(glFramebufferTexture2D);
+    wrap_simple<Command::FramebufferTextureLayer>(glFramebufferTextureLayer);
+    wrap_simple<Command::FramebufferRenderbuffer>(glFramebufferRenderbuffer);
+    wrap_simple<Command::BeginQuery>(glBeginQuery);
+    wrap_simple<Command::QueryCounter>(glQueryCounter);
+    wrap_simple<Command::BeginConditionalRender>(glBeginConditionalRender);
+    wrap_simple<Command::CompileShader>(glCompileShader);
+    wrap_simple<Command::AttachShader>(glAttachShader);
+    wrap_simple<Command::LinkProgram>(glLinkProgram);
+    wrap_simple<Command::Uniform1i>(glUniform1i);
+    wrap_simple<Command::Uniform1f>(glUniform1f);
+
+    wrap(Command::GenBuffers, glGenBuffers, &record_generate<Command::GenBuffers>);
+    wrap(Command::GenTextures, glGenTextures, &record_generate<Command::GenTextures>);
+    wrap(Command::GenVertexArrays, glGenVertexArrays, &record_generate<Command::GenVertexArrays>);
+    wrap(Command::GenFramebuffers, glGenFramebuffers, &record_generate<Command::GenFramebuffers>);
+    wrap(Command::GenRenderbuffers, glGenRenderbuffers, &record_generate<Command::GenRenderbuffers>);
+    wrap(Command::GenQueries, glGenQueries, &record_generate<Command::GenQueries>);
+    wrap(Command::DeleteBuffers, glDeleteBuffers, &record_delete<Command::DeleteBuffers>);
+    wrap(Command::DeleteTextures, glDeleteTextures, &record_delete<Command::DeleteTextures>);
+    wrap(Command::DeleteVertexArrays, glDeleteVertexArrays, &record_delete<Command::DeleteVertexArrays>);
+    wrap(Command::DeleteFramebuffers, glDeleteFramebuffers, &record_delete<Command::DeleteFramebuffers>);
+    wrap(Command::DeleteRenderbuffers, glDeleteRenderbuffers, &record_delete<Command::DeleteRenderbuffers>);
+    wrap(Command::DeleteQueries, glDeleteQueries, &record_delete<Command::DeleteQueries>);
+    wrap(Command::CreateShader, glCreateShader, &record_create_shader);
+    wrap(Command::CreateProgram, glCreateProgram, &record_create_program);
+    wrap(Command::GetQueryObjectiv, glGetQueryObjectiv, &record_get_query_object<Command::GetQueryObjectiv, GLint>);
+    wrap(Command::GetQueryObjectuiv, glGetQueryObjectuiv, &record_get_query_object<Command::GetQueryObjectuiv, GLuint>);
+    wrap(Command::GetQueryObjectui64v, glGetQueryObjectui64v, &record_get_query_object<Command::GetQueryObjectui64v, GLuint64>);
+
+    wrap(Command::ShaderSource, glShaderSource, &record_shader_source);
+    wrap(Command::GetUniformLocation, glGetUniformLocation, &record_get_uniform_location);
+    wrap(Command::Uniform3fv, glUniform3fv, &record_uniform_vector<Command::Uniform3fv, 3>);
+    wrap(Command::Uniform4fv, glUniform4fv, &record_uniform_vector<Command::Uniform4fv, 4>);
+    wrap(Command::UniformMatrix4fv, glUniformMatrix4fv, &record_uniform_matrix_4fv);
+
+    wrap(Command::BufferData, glBufferData, &record_buffer_data);
+    wrap(Command::BufferSubData, glBufferSubData, &record_buffer_sub_data);
+    wrap(Command::MapBufferRange, glMapBufferRange, &record_map_buffer_range);
+    capture.original_unmap_buffer = glUnmapBuffer;
+    capture.restores.push_back([previous = glUnmapBuffer] { glUnmapBuffer = previous; });
+    glUnmapBuffer = &record_unmap_buffer;
+    wrap(Command::TexImage2D, glTexImage2D, &record_tex_image_2d);
+    wrap(Command::TexImage3D, glTexImage3D, &record_tex_image_3d);
+    wrap(Command::TexParameterfv, glTexParameterfv, &record_tex_parameter_fv);
+    wrap(Command::ClearBufferfv, glClearBufferfv, &record_clear_buffer_fv);
+    wrap(Command::DrawBuffers, glDrawBuffers, &record_draw_buffers);
+    wrap(Command::MultiDrawElements, glMultiDrawElements, &record_multi_draw_elements);
+
+    capturing = true;
+}
+
+bool GLCapture::active()
+{
+    return capturing;
+}
+
+void GLCapture::group(const char* name)
+{
+    // The replayer only times groups of the captured frames.
+    if (!capturing || in_setup())
+        return;
+    write(Command::Group);
+    write_data(name, std::strlen(name));
+}
+
+void GLCapture::end_frame(int width, int height)
+{
+    if (!capturing)
+        return;
+    write(Command::FrameEnd);
+    capture.width = width;
+    capture.height = height;
+    capture.frames++;
+    if (capture.frames == capture.skipped_frames)
+        capture.setup_size = capture.stream.size();
+    if (capture.frames == capture.skipped_frames + capture.frame_count)
+        finish();
+}
+
+void GLCapture::finish()
+{
+    if (!capturing)
+        return;
+    capturing = false;
+    for (auto& restore : capture.restores)
+        restore();
+
+    if (capture.frames > capture.skipped_frames) {
+        write_file();
+    } else {
+        LOGERR("No frame was captured.");
+    }
+    capture = {};
+}
+
+}
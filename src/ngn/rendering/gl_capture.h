@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace ngn {
+
+/**
+ * @brief Records the GL calls of the engine, with the data they upload, into a capture for the replayer.
+ *
+ * Installed by swapping the glad function pointers for recording wrappers, so it must begin right after
+ * GL is loaded, before any resource exists. Calls made through another loader, like the ImGui backend's,
+ * are not recorded. Only the thread owning the context may call GL, so recording needs no locking.
+ *
+ * The frames before the captured ones become the setup of the capture, which the replayer runs once before
+ * looping over the frames. Only their calls creating resources or changing contents or state are kept:
+ * draws, clears, dispatches and queries are dropped, as the captured frames overwrite their results. The file is written once the last frame ends, compressed with the best
+ * codec built in, and the original pointers are restored.
+ */
+class GLCapture {
+public:
+    GLCapture() = delete;
+
+    /**
+     * @brief Starts recording, to capture {{frame_count}} frames after {{skipped_frames}} ones into {{path}}.
+     */
+    static void begin(const std::string& path, size_t skipped_frames, size_t frame_count);
+    static bool active();
+
+    /**
+     * @brief Names the calls that follow, up to the next group or end_frame().
+     */
+    static void group(const char* name);
+
+    /**
+     * @brief Ends a frame rendered at {{width}} by {{height}}. Writes the capture after the last one.
+     */
+    static void end_frame(int width, int height);
+
+    /**
+     * @brief Writes what was captured so far, if any frame was, and stops recording.
+     */
+    static void finish();
+};
+
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "../io/pack_format.h"
+
+#include <cstdint>
+
+/**
+ * @brief On-disk layout of GL captures, shared by the engine and the replayer.
+ *
+ * A capture is a Header followed by the command stream, compressed as a whole. The stream is a sequence
+ * of commands: a uint16_t Command, then its arguments in call order. Scalars are stored as their GL type,
+ * pointers into bound buffers as uint64_t offsets, and arrays and data as a uint64_t byte count followed
+ * by the bytes. Object names and uniform locations are the ones of the captured run, remapped on replay.
+ *
+ * The first Header::setup_size bytes create the resources and bring them to their state at the first
+ * captured frame, without the draws, clears, dispatches and queries of the frames before it.
+ * The rest holds Header::frame_count frames, each ending with a FrameEnd command.
+ */
+namespace ngn::gl_capture {
+
+constexpr char MAGIC[8] = { 'N', 'G', 'N', 'G', 'L', 'C', 'A', 'P' };
+constexpr uint32_t VERSION = 1;
+
+/**
+ * @brief Calls whose arguments are all values or buffer offsets, replayed as they are.
+ */
+#define NGN_GL_CAPTURE_SIMPLE_COMMANDS(X) \
+    X(ActiveTexture)                      \
+    X(BlendFunc)                          \
+    X(BlendFuncSeparate)                  \
+    X(BlitFramebuffer)                    \
+    X(Clear)                              \
+    X(ClearColor)                         \
+    X(ColorMask)                          \
+    X(CopyTexSubImage3D)                  \
+    X(CullFace)                           \
+    X(DepthFunc)                          \
+    X(DepthMask)                          \
+    X(Disable)                            \
+    X(DispatchCompute)                    \
+    X(DrawArrays)                         \
+    X(DrawBuffer)                         \
+    X(DrawElements)                       \
+    X(DrawElementsIndirect)               \
+    X(DrawElementsInstanced)              \
+    X(Enable)                             \
+    X(EnableVertexAttribArray)            \
+    X(EndConditionalRender)               \
+    X(EndQuery)                           \
+    X(FrontFace)                          \
+    X(GenerateMipmap)                     \
+    X(MemoryBarrier)                      \
+    X(PolygonMode)                        \
+    X(PolygonOffset)                      \
+    X(ReadBuffer)                         \
+    X(RenderbufferStorage)                \
+    X(StencilFunc)                        \
+    X(StencilMask)                        \
+    X(StencilOp)                          \
+    X(TexParameteri)                      \
+    X(VertexAttribDivisor)                \
+    X(VertexAttribPointer)                \
+    X(Viewport)
+
+#define NGN_GL_CAPTURE_ENUMERATOR(name) name,
+
+enum class Command : uint16_t {
+    NGN_GL_CAPTURE_SIMPLE_COMMANDS(NGN_GL_CAPTURE_ENUMERATOR)
+
+    // Object names
+    GenBuffers,
+    GenTextures,
+    GenVertexArrays,
+    GenFramebuffers,
+    GenRenderbuffers,
+    GenQueries,
+    DeleteBuffers,
+    DeleteTextures,
+    DeleteVertexArrays,
+    DeleteFramebuffers,
+    DeleteRenderbuffers,
+    DeleteQueries,
+    CreateShader,
+    CreateProgram,
+    DeleteShader,
+    DeleteProgram,
+
+    // Bindings and attachments
+    BindBuffer,
+    BindBufferBase,
+    BindTexture,
+    BindVertexArray,
+    BindFramebuffer,
+    BindRenderbuffer,
+    UseProgram,
+    FramebufferTexture2D,
+    FramebufferTextureLayer,
+    FramebufferRenderbuffer,
+    BeginQuery,
+    QueryCounter,
+    BeginConditionalRender,
+    GetQueryObjectiv,
+    GetQueryObjectuiv,
+    GetQueryObjectui64v,
+
+    // Programs
+    ShaderSource,
+    CompileShader,
+    AttachShader,
+    LinkProgram,
+    GetUniformLocation,
+    Uniform1i,
+    Uniform1f,
+    Uniform3fv,
+    Uniform4fv,
+    UniformMatrix4fv,
+
+    // Data
+    BufferData,
+    BufferSubData,
+    /**
+     * @brief A glMapBufferRange and glUnmapBuffer pair, with what was written in between.
+     */
+    MapBufferRange,
+    TexImage2D,
+    TexImage3D,
+    TexParameterfv,
+    ClearBufferfv,
+    DrawBuffers,
+    MultiDrawElements,
+
+    // Markers
+    /**
+     * @brief Name of the calls that follow, up to the next group or the end of the frame.
+     */
+    Group,
+    FrameEnd,
+};
+
+#undef NGN_GL_CAPTURE_ENUMERATOR
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    /**
+     * @brief Size of the default framebuffer in the last captured frame.
+     */
+    int32_t width;
+    int32_t height;
+    uint32_t frame_count;
+    pack::Compression compression;
+    uint32_t reserved;
+    uint64_t setup_size;
+    uint64_t stream_size;
+    /**
+     * @brief Bytes following the header, equal to stream_size when not compressed.
+     */
+    uint64_t stored_size;
+};
+
+static_assert(sizeof(Header) == 56);
+
+}
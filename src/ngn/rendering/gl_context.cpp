@@ -0,0 +1,52 @@
+#include "gl_context.h"
+
+#include "../utils/log.h"
+
+#include <glad/glad.h>
+
+#include <GLFW/glfw3.h>
+
+#include <cstdlib>
+
+namespace ngn {
+
+GLFWwindow* create_hidden_gl_context(int width, int height, const char* title)
+{
+#if defined(__linux__) && defined(GLFW_PLATFORM_NULL)
+    bool headless = !std::getenv("DISPLAY") && !std::getenv("WAYLAND_DISPLAY");
+    if (headless)
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+    if (!glfwInit()) {
+        LOGERR("Failed to initialize GLFW.");
+        return nullptr;
+    }
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+#if defined(__linux__) && defined(GLFW_PLATFORM_NULL)
+    if (headless)
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+#endif
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(width, height, title, nullptr, nullptr);
+    if (!window) {
+        LOGERR("Failed to create a GL context.");
+        glfwTerminate();
+        return nullptr;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        LOGERR("Failed to load GL.");
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return nullptr;
+    }
+    return window;
+}
+
+}
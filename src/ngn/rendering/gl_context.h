@@ -0,0 +1,18 @@
+#pragma once
+
+struct GLFWwindow;
+
+namespace ngn {
+
+/**
+ * @brief Initializes GLFW and creates a hidden {{width}} by {{height}} window with a GL 3.3 core context,
+ * made current on this thread, with GL loaded.
+ *
+ * For tools that render offscreen. Without a display on Linux, e.g. on a headless server, GLFW's null
+ * platform creates the context with Mesa's OSMesa (llvmpipe) instead.
+ *
+ * @return nullptr on failure, logged, with GLFW terminated.
+ */
+GLFWwindow* create_hidden_gl_context(int width, int height, const char* title);
+
+}
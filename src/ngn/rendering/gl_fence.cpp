@@ -0,0 +1,15 @@
+#include "gl_fence.h"
+
+#include <glad/glad.h>
+
+namespace ngn {
+
+bool fence_passed(void* sync, bool wait)
+{
+    // Flushing on a wait makes sure the fence reaches the GPU, or the wait could never end.
+    GLenum status = glClientWaitSync(static_cast<GLsync>(sync), wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+        wait ? GL_TIMEOUT_IGNORED : 0);
+    return status != GL_TIMEOUT_EXPIRED;
+}
+
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+namespace ngn {
+
+/**
+ * @brief Whether the GPU passed the fence {{sync}} (a GLsync), blocking until it does when {{wait}}.
+ *
+ * A failed wait counts as passed, so callers never retry a fence forever. The fence is not deleted.
+ */
+bool fence_passed(void* sync, bool wait);
+
+}
@@ -0,0 +1,180 @@
+#include "gl_state.h"
+
+#include <glad/glad.h>
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+
+namespace ngn {
+
+namespace {
+
+    /**
+     * @brief Empty values are unknown, e.g. before the first call or after invalidate().
+     */
+    struct State {
+        std::optional<unsigned> program;
+        std::optional<unsigned> vertex_array;
+        std::optional<unsigned> active_texture_unit;
+        /**
+         * @brief Bound texture by unit (high bits) and target (low bits).
+         */
+        std::unordered_map<uint64_t, unsigned> textures;
+        std::unordered_map<unsigned, bool> capabilities;
+        std::optional<std::array<unsigned, 4>> blend_func;
+        std::optional<unsigned> depth_func;
+        std::optional<bool> depth_mask;
+        std::optional<bool> color_mask;
+        std::optional<std::tuple<unsigned, int, unsigned>> stencil_func;
+        std::optional<std::array<unsigned, 3>> stencil_op;
+        std::optional<unsigned> stencil_mask;
+    };
+
+    State state;
+    GLState::Counters call_counters;
+
+    /**
+     * @brief Stores {{value}} into {{current}}, returning whether the call must be issued.
+     */
+    template <class T>
+    bool changes(std::optional<T>& current, const std::type_identity_t<T>& value)
+    {
+        if (current == value) {
+            call_counters.elided++;
+            return false;
+        }
+        current = value;
+        call_counters.issued++;
+        return true;
+    }
+
+}
+
+void GLState::use_program(unsigned program)
+{
+    if (changes(state.program, program))
+        glUseProgram(program);
+}
+
+void GLState::bind_vertex_array(unsigned vertex_array)
+{
+    if (changes(state.vertex_array, vertex_array))
+        glBindVertexArray(vertex_array);
+}
+
+void GLState::bind_texture(unsigned unit, unsigned target, unsigned texture)
+{
+    auto [bound, inserted] = state.textures.try_emplace(static_cast<uint64_t>(unit) << 32 | target, texture);
+    if (!inserted && bound->second == texture) {
+        call_counters.elided++;
+        return;
+    }
+    if (changes(state.active_texture_unit, unit))
+        glActiveTexture(GL_TEXTURE0 + unit);
+    bound->second = texture;
+    call_counters.issued++;
+    glBindTexture(target, texture);
+}
+
+void GLState::set_enabled(unsigned capability, bool enabled)
+{
+    auto [current, inserted] = state.capabilities.try_emplace(capability, enabled);
+    if (!inserted && current->second == enabled) {
+        call_counters.elided++;
+        return;
+    }
+    current->second = enabled;
+    call_counters.issued++;
+    if (enabled)
+        glEnable(capability);
+    else
+        glDisable(capability);
+}
+
+void GLState::blend_func(unsigned source, unsigned destination)
+{
+    if (changes(state.blend_func, { source, destination, source, destination }))
+        glBlendFunc(source, destination);
+}
+
+void GLState::blend_func_separate(unsigned source_rgb, unsigned destination_rgb, unsigned source_alpha, unsigned destination_alpha)
+{
+    if (changes(state.blend_func, { source_rgb, destination_rgb, source_alpha, destination_alpha }))
+        glBlendFuncSeparate(source_rgb, destination_rgb, source_alpha, destination_alpha);
+}
+
+void GLState::depth_func(unsigned function)
+{
+    if (changes(state.depth_func, function))
+        glDepthFunc(function);
+}
+
+void GLState::depth_mask(bool enabled)
+{
+    if (changes(state.depth_mask, enabled))
+        glDepthMask(enabled);
+}
+
+void GLState::color_mask(bool enabled)
+{
+    if (changes(state.color_mask, enabled))
+        glColorMask(enabled, enabled, enabled, enabled);
+}
+
+void GLState::stencil_func(unsigned function, int reference, unsigned mask)
+{
+    if (changes(state.stencil_func, { function, reference, mask }))
+        glStencilFunc(function, reference, mask);
+}
+
+void GLState::stencil_op(unsigned stencil_fail, unsigned depth_fail, unsigned depth_pass)
+{
+    if (changes(state.stencil_op, { stencil_fail, depth_fail, depth_pass }))
+        glStencilOp(stencil_fail, depth_fail, depth_pass);
+}
+
+void GLState::stencil_mask(unsigned mask)
+{
+    if (changes(state.stencil_mask, mask))
+        glStencilMask(mask);
+}
+
+void GLState::forget_program(unsigned program)
+{
+    if (state.program == program)
+        state.program.reset();
+}
+
+void GLState::forget_vertex_array(unsigned vertex_array)
+{
+    if (state.vertex_array == vertex_array)
+        state.vertex_array.reset();
+}
+
+void GLState::forget_texture(unsigned texture)
+{
+    std::erase_if(state.textures, [texture](const auto& binding) {
+        return binding.second == texture;
+    });
+}
+
+void GLState::invalidate()
+{
+    state = {};
+}
+
+GLState::Counters GLState::counters()
+{
+    return call_counters;
+}
+
+void GLState::reset_counters()
+{
+    call_counters = {};
+}
+
+}
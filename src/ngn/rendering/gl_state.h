@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+
+namespace ngn {
+
+/**
+ * @brief Shadow copy of the GL state the engine changes, skipping calls that would not change it.
+ *
+ * Every program, vertex array, texture and fixed function state change must go through it, or the
+ * shadow copy goes stale: call invalidate() after code that changes the state behind its back. Objects
+ * must be forgotten when deleted, as GL may reuse their names.
+ */
+class GLState {
+public:
+    struct Counters {
+        size_t issued { 0 };
+        size_t elided { 0 };
+    };
+
+    GLState() = delete;
+
+    static void use_program(unsigned program);
+    static void bind_vertex_array(unsigned vertex_array);
+    /**
+     * @brief Binds {{texture}} to {{target}} of {{unit}}, which becomes the active texture unit.
+     */
+    static void bind_texture(unsigned unit, unsigned target, unsigned texture);
+
+    static void set_enabled(unsigned capability, bool enabled);
+    static void blend_func(unsigned source, unsigned destination);
+    static void blend_func_separate(unsigned source_rgb, unsigned destination_rgb, unsigned source_alpha, unsigned destination_alpha);
+    static void depth_func(unsigned function);
+    static void depth_mask(bool enabled);
+    static void color_mask(bool enabled);
+    static void stencil_func(unsigned function, int reference, unsigned mask);
+    static void stencil_op(unsigned stencil_fail, unsigned depth_fail, unsigned depth_pass);
+    static void stencil_mask(unsigned mask);
+
+    static void forget_program(unsigned program);
+    static void forget_vertex_array(unsigned vertex_array);
+    static void forget_texture(unsigned texture);
+    /**
+     * @brief Forgets everything, so the next calls are all issued.
+     */
+    static void invalidate();
+
+    /**
+     * @brief Calls issued to and elided from the driver since the last reset_counters().
+     */
+    static Counters counters();
+    static void reset_counters();
+};
+
+}
@@ -0,0 +1,71 @@
+#include "gpu_instance_culler.h"
+
+#include "gl_state.h"
+
+#include <glad/glad.h>
+
+namespace ngn {
+
+/**
+ * @brief Must match local_size_x in cull_instances.comp.
+ */
+constexpr unsigned WORK_GROUP_SIZE = 64;
+
+bool GpuInstanceCuller::supported()
+{
+    return GLAD_GL_VERSION_4_3;
+}
+
+GpuInstanceCuller::GpuInstanceCuller()
+    : shader_("assets/shaders/cull_instances.comp")
+{
+    DrawCommand command {};
+    glGenBuffers(1, &command_buffer_);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer_);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(command), &command, GL_DYNAMIC_DRAW);
+}
+
+GpuInstanceCuller::~GpuInstanceCuller()
+{
+    glDeleteBuffers(1, &command_buffer_);
+}
+
+float* GpuInstanceCuller::map(size_t count)
+{
+    return input_.map(count);
+}
+
+void GpuInstanceCuller::unmap()
+{
+    input_.unmap();
+}
+
+void GpuInstanceCuller::cull(const glm::mat4& view_projection, const Mesh& mesh, size_t count, InstanceBuffer& output)
+{
+    output.reserve(count);
+
+    // The shader counts the survivors into the command with an atomic add.
+    DrawCommand command { static_cast<unsigned>(mesh.indices().size()), 0, 0, 0, 0 };
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer_);
+    glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(command), &command);
+
+    shader_.use();
+    shader_.set("viewProjection", view_projection);
+    shader_.set("boundsMin", mesh.bounds().min);
+    shader_.set("boundsMax", mesh.bounds().max);
+    shader_.set("instanceCount", static_cast<int>(count));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, input_.id());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, output.id());
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, command_buffer_);
+    glDispatchCompute((count + WORK_GROUP_SIZE - 1) / WORK_GROUP_SIZE, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void GpuInstanceCuller::draw(const Mesh& mesh) const
+{
+    GLState::bind_vertex_array(mesh.VAO());
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, command_buffer_);
+    glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, 0);
+}
+
+}
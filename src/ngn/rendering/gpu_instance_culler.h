@@ -0,0 +1,62 @@
+#pragma once
+
+#include "instance_buffer.h"
+#include "mesh.h"
+#include "shader.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+namespace ngn {
+
+/**
+ * @brief Frustum culls instances in a compute shader and draws the survivors indirectly.
+ *
+ * The CPU only writes the instance matrices: testing, compaction and the instance count of the draw
+ * all happen on the GPU, so CPU cost does not depend on how many instances are visible.
+ * Requires GL 4.3, check supported() first.
+ */
+class GpuInstanceCuller {
+public:
+    static bool supported();
+
+    GpuInstanceCuller();
+    ~GpuInstanceCuller();
+
+    GpuInstanceCuller(const GpuInstanceCuller&) = delete;
+    GpuInstanceCuller& operator=(const GpuInstanceCuller&) = delete;
+    GpuInstanceCuller(GpuInstanceCuller&&) = delete;
+
+    /**
+     * @brief Maps room for the {{count}} instance matrices to cull, see InstanceBuffer::map.
+     */
+    float* map(size_t count);
+    void unmap();
+
+    /**
+     * @brief Copies the mapped instances of {{mesh}} that intersect the frustum into {{output}}, packed.
+     *
+     * {{output}} is expected to be attached to the vertex array of {{mesh}}.
+     */
+    void cull(const glm::mat4& view_projection, const Mesh& mesh, size_t count, InstanceBuffer& output);
+    /**
+     * @brief Draws the instances kept by the last cull(), with the current program and material.
+     */
+    void draw(const Mesh& mesh) const;
+
+private:
+    struct DrawCommand {
+        unsigned count;
+        unsigned instance_count;
+        unsigned first_index;
+        int base_vertex;
+        unsigned base_instance;
+    };
+
+    Shader shader_;
+    InstanceBuffer input_;
+    unsigned command_buffer_;
+};
+
+}
@@ -0,0 +1,164 @@
+#include "gpu_memory.h"
+
+#include "../utils/log.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace ngn {
+
+namespace {
+
+    struct Registry {
+        std::map<std::pair<unsigned, unsigned>, GpuMemory::Allocation> allocations;
+        std::array<size_t, GpuMemory::CATEGORY_COUNT> used {};
+        std::array<size_t, GpuMemory::CATEGORY_COUNT> budgets {};
+        std::array<bool, GpuMemory::CATEGORY_COUNT> over_budget {};
+    };
+
+    // Render targets can be allocated by the render thread while the UI reads the registry.
+    std::mutex registry_mutex;
+    Registry registry;
+    thread_local std::string scope_owner;
+
+    void check_budget(GpuMemory::Category category)
+    {
+        size_t budget = registry.budgets[category];
+        bool over_budget = budget != 0 && registry.used[category] > budget;
+        // Only warn when crossing the budget, not on every allocation past it.
+        if (over_budget && !registry.over_budget[category]) {
+            LOGERRF("WARNING::GPU_MEMORY::%s over budget: %.1f / %.1f MiB", GpuMemory::to_string(category),
+                registry.used[category] / 1048576., budget / 1048576.);
+        }
+        registry.over_budget[category] = over_budget;
+    }
+
+}
+
+GpuMemory::Scope::Scope(const std::string& owner)
+    : previous_owner_(std::exchange(scope_owner, owner))
+{
+}
+
+GpuMemory::Scope::~Scope()
+{
+    scope_owner = previous_owner_;
+}
+
+const char* GpuMemory::to_string(Category category)
+{
+    switch (category) {
+    case Texture:
+        return "Textures";
+    case RenderTarget:
+        return "Render targets";
+    case VertexBuffer:
+        return "Vertex buffers";
+    case IndexBuffer:
+        return "Index buffers";
+    case UniformBuffer:
+        return "Uniform buffers";
+    case ReadbackBuffer:
+        return "Readback buffers";
+    default:
+        return "Unknown";
+    }
+}
+
+static void untrack_locked(unsigned object_type, unsigned id)
+{
+    auto allocation = registry.allocations.find({ object_type, id });
+    if (allocation == registry.allocations.end())
+        return;
+    GpuMemory::Category category = allocation->second.category;
+    registry.used[category] -= allocation->second.bytes;
+    registry.allocations.erase(allocation);
+    check_budget(category);
+}
+
+void GpuMemory::track(unsigned object_type, unsigned id, Category category, size_t bytes, const std::string& owner)
+{
+    std::lock_guard lock(registry_mutex);
+    untrack_locked(object_type, id);
+    std::string name = !owner.empty() ? owner : !scope_owner.empty() ? scope_owner : "Unknown";
+    registry.allocations[{ object_type, id }] = { category, bytes, name };
+    registry.used[category] += bytes;
+    check_budget(category);
+}
+
+void GpuMemory::untrack(unsigned object_type, unsigned id)
+{
+    std::lock_guard lock(registry_mutex);
+    untrack_locked(object_type, id);
+}
+
+size_t GpuMemory::used(Category category)
+{
+    std::lock_guard lock(registry_mutex);
+    return registry.used[category];
+}
+
+size_t GpuMemory::total()
+{
+    std::lock_guard lock(registry_mutex);
+    size_t total = 0;
+    for (size_t used : registry.used)
+        total += used;
+    return total;
+}
+
+void GpuMemory::visit_allocations(const std::function<void(const Allocation&)>& visitor)
+{
+    std::lock_guard lock(registry_mutex);
+    for (auto& [key, allocation] : registry.allocations)
+        visitor(allocation);
+}
+
+void GpuMemory::set_budget(Category category, size_t bytes)
+{
+    std::lock_guard lock(registry_mutex);
+    registry.budgets[category] = bytes;
+    check_budget(category);
+}
+
+size_t GpuMemory::budget(Category category)
+{
+    std::lock_guard lock(registry_mutex);
+    return registry.budgets[category];
+}
+
+size_t GpuMemory::texture_bytes(unsigned internal_format, int width, int height, int layers, bool mipmaps)
+{
+    size_t texel_bytes;
+    switch (internal_format) {
+    case GL_R16F:
+        texel_bytes = 2;
+        break;
+    case GL_RGBA16F:
+        texel_bytes = 8;
+        break;
+    // Drivers pad 24 bit formats to 32 bits.
+    case GL_RGB8:
+    case GL_RGBA8:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH24_STENCIL8:
+    default:
+        texel_bytes = 4;
+        break;
+    }
+
+    size_t texels = static_cast<size_t>(width) * height;
+    while (mipmaps && (width > 1 || height > 1)) {
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+        texels += static_cast<size_t>(width) * height;
+    }
+    return texels * layers * texel_bytes;
+}
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+namespace ngn {
+
+/**
+ * @brief Registry of GPU allocations by category and owning asset, with optional budgets per category.
+ *
+ * GL objects are registered when their storage is allocated and removed when deleted, by the thread owning
+ * the GL context. Queries are thread safe, for the UI to read while another thread renders.
+ */
+class GpuMemory {
+public:
+    enum Category : int {
+        Texture,
+        RenderTarget,
+        VertexBuffer,
+        IndexBuffer,
+        UniformBuffer,
+        ReadbackBuffer,
+        CATEGORY_COUNT,
+    };
+
+    struct Allocation {
+        Category category;
+        size_t bytes;
+        std::string owner;
+    };
+
+    /**
+     * @brief Names the owner of the allocations made while it is alive, on its thread, when they do not name one.
+     */
+    class Scope {
+    public:
+        Scope(const std::string& owner);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        Scope(Scope&&) = delete;
+
+    private:
+        std::string previous_owner_;
+    };
+
+    GpuMemory() = delete;
+
+    static const char* to_string(Category category);
+
+    /**
+     * @brief Records that the GL object {{id}} of {{object_type}} (GL_TEXTURE, GL_RENDERBUFFER or GL_BUFFER)
+     * now holds {{bytes}}, replacing its previous size.
+     */
+    static void track(unsigned object_type, unsigned id, Category category, size_t bytes, const std::string& owner = "");
+    static void untrack(unsigned object_type, unsigned id);
+
+    static size_t used(Category category);
+    static size_t total();
+    /**
+     * @brief Calls {{visitor}} for every allocation, with the registry locked: it must not track or untrack.
+     */
+    static void visit_allocations(const std::function<void(const Allocation&)>& visitor);
+
+    /**
+     * @brief Logs a warning whenever {{category}} goes over {{bytes}}. 0 means no budget.
+     */
+    static void set_budget(Category category, size_t bytes);
+    static size_t budget(Category category);
+
+    /**
+     * @brief Size of a texture of {{internal_format}}, including its mip chain if {{mipmaps}}.
+     */
+    static size_t texture_bytes(unsigned internal_format, int width, int height, int layers, bool mipmaps);
+};
+
+}
@@ -0,0 +1,59 @@
+#include "gpu_timer.h"
+
+#include <glad/glad.h>
+
+namespace ngn {
+
+GpuTimer::GpuTimer()
+{
+    glGenQueries(QUERY_COUNT, begin_queries_.data());
+    glGenQueries(QUERY_COUNT, end_queries_.data());
+}
+
+GpuTimer::~GpuTimer()
+{
+    glDeleteQueries(QUERY_COUNT, begin_queries_.data());
+    glDeleteQueries(QUERY_COUNT, end_queries_.data());
+}
+
+void GpuTimer::begin()
+{
+    // Collect finished queries, oldest first, so the newest result wins.
+    for (unsigned i = 0; i < QUERY_COUNT; i++) {
+        unsigned index = (current_ + i) % QUERY_COUNT;
+        if (!pending_[index])
+            continue;
+        // Timestamps complete in order: once the end is available, so is the begin.
+        int available = 0;
+        glGetQueryObjectiv(end_queries_[index], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+        GLuint64 begin_time = 0, end_time = 0;
+        glGetQueryObjectui64v(begin_queries_[index], GL_QUERY_RESULT, &begin_time);
+        glGetQueryObjectui64v(end_queries_[index], GL_QUERY_RESULT, &end_time);
+        milliseconds_ = (end_time - begin_time) / 1e6f;
+        pending_[index] = false;
+    }
+
+    // Every query is still in flight: skip this measure rather than wait for the GPU.
+    active_ = !pending_[current_];
+    if (active_)
+        glQueryCounter(begin_queries_[current_], GL_TIMESTAMP);
+}
+
+void GpuTimer::end()
+{
+    if (!active_)
+        return;
+    glQueryCounter(end_queries_[current_], GL_TIMESTAMP);
+    pending_[current_] = true;
+    current_ = (current_ + 1) % QUERY_COUNT;
+    active_ = false;
+}
+
+float GpuTimer::milliseconds() const
+{
+    return milliseconds_;
+}
+
+}
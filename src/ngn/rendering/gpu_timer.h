@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+
+namespace ngn {
+
+/**
+ * @brief Measures GPU time spent between begin() and end() with GL_TIMESTAMP queries.
+ *
+ * Queries are kept in a small ring so results are read a few frames late instead of stalling the pipeline.
+ * Unlike GL_TIME_ELAPSED queries, timestamps let timers nest, e.g. a pass timer inside a frame timer.
+ */
+class GpuTimer {
+public:
+    GpuTimer();
+    ~GpuTimer();
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+    GpuTimer(GpuTimer&&) = delete;
+
+    void begin();
+    void end();
+
+    /**
+     * @brief Last available measure in milliseconds.
+     */
+    float milliseconds() const;
+
+private:
+    static constexpr unsigned QUERY_COUNT = 4;
+
+    std::array<unsigned, QUERY_COUNT> begin_queries_;
+    std::array<unsigned, QUERY_COUNT> end_queries_;
+    std::array<bool, QUERY_COUNT> pending_ {};
+    unsigned current_ { 0 };
+    bool active_ { false };
+    float milliseconds_ { 0 };
+};
+
+}
@@ -0,0 +1,71 @@
+#include "instance_buffer.h"
+
+#include "../utils/log.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+namespace ngn {
+
+InstanceBuffer::InstanceBuffer()
+{
+    glGenBuffers(1, &VBO_);
+    // Never leave the attribute pointing to an empty buffer, even before the first map().
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+    capacity_ = 1;
+    GpuMemory::track(GL_BUFFER, VBO_, GpuMemory::VertexBuffer, sizeof(glm::mat4), "Instance buffer");
+}
+
+InstanceBuffer::~InstanceBuffer()
+{
+    GpuMemory::untrack(GL_BUFFER, VBO_);
+    glDeleteBuffers(1, &VBO_);
+}
+
+void InstanceBuffer::attach(unsigned VAO, unsigned location) const
+{
+    GLState::bind_vertex_array(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_);
+    for (unsigned column = 0; column < 4; column++) {
+        glEnableVertexAttribArray(location + column);
+        glVertexAttribPointer(location + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location + column, 1);
+    }
+    GLState::bind_vertex_array(0);
+}
+
+float* InstanceBuffer::map(size_t count)
+{
+    reserve(count);
+    if (count == 0)
+        return nullptr;
+    return static_cast<float*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4),
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+}
+
+void InstanceBuffer::reserve(size_t count)
+{
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_);
+    if (count > capacity_) {
+        capacity_ = count;
+        glBufferData(GL_ARRAY_BUFFER, capacity_ * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+        GpuMemory::track(GL_BUFFER, VBO_, GpuMemory::VertexBuffer, capacity_ * sizeof(glm::mat4), "Instance buffer");
+        LOGF("Instance buffer %u grown to %zu instances.", VBO_, capacity_);
+    }
+}
+
+unsigned InstanceBuffer::id() const
+{
+    return VBO_;
+}
+
+void InstanceBuffer::unmap()
+{
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+}
+
+}
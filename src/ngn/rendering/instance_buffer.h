@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+
+namespace ngn {
+
+/**
+ * @brief Per-instance model matrices, streamed every frame through a mapped buffer.
+ */
+class InstanceBuffer {
+public:
+    InstanceBuffer();
+    ~InstanceBuffer();
+
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+    InstanceBuffer(InstanceBuffer&&) = delete;
+
+    /**
+     * @brief Adds the instance matrix attribute to {{VAO}}, on 4 locations starting at {{location}}.
+     */
+    void attach(unsigned VAO, unsigned location) const;
+
+    /**
+     * @brief Orphans the buffer and maps room for {{count}} column major 4x4 matrices, write only.
+     */
+    float* map(size_t count);
+    void unmap();
+
+    /**
+     * @brief Grows the buffer to hold {{count}} matrices, for writes done by the GPU.
+     */
+    void reserve(size_t count);
+    unsigned id() const;
+
+private:
+    unsigned VBO_;
+    size_t capacity_ { 0 };
+};
+
+}
@@ -1,27 +1,31 @@
 #include "mesh.h"
 
 #include "../utils/log.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
 
 #include <glad/glad.h>
 
 namespace ngn {
 
-Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned>& indices, const std::vector<Texture>& texture_options)
-    : vertices_(vertices)
-    , indices_(indices)
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned> indices, const std::vector<Texture>& texture_options, bool raycast)
+    : vertices_(std::move(vertices))
+    , indices_(std::move(indices))
 {
     glGenVertexArrays(1, &VAO_);
     glGenBuffers(1, &VBO_);
     glGenBuffers(1, &EBO_);
 
-    glBindVertexArray(VAO_);
+    GLState::bind_vertex_array(VAO_);
     glBindBuffer(GL_ARRAY_BUFFER, VBO_);
 
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, vertices_.size() * sizeof(Vertex), vertices_.data(), GL_STATIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned),
-        &indices[0], GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_.size() * sizeof(unsigned),
+        &indices_[0], GL_STATIC_DRAW);
+    GpuMemory::track(GL_BUFFER, VBO_, GpuMemory::VertexBuffer, vertices_.size() * sizeof(Vertex));
+    GpuMemory::track(GL_BUFFER, EBO_, GpuMemory::IndexBuffer, indices_.size() * sizeof(unsigned));
 
     // vertex positions
     glEnableVertexAttribArray(0);
@@ -33,7 +37,30 @@ Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned>& ind
     glEnableVertexAttribArray(2);
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texture_coordinates));
 
-    glBindVertexArray(0);
+    // position-only stream, sharing the element buffer
+    std::vector<glm::vec3> positions;
+    positions.reserve(vertices_.size());
+    for (auto& vertex : vertices_) {
+        positions.push_back(vertex.position);
+        bounds_.extend(vertex.position);
+    }
+
+    glGenVertexArrays(1, &depth_VAO_);
+    glGenBuffers(1, &position_VBO_);
+
+    GLState::bind_vertex_array(depth_VAO_);
+    glBindBuffer(GL_ARRAY_BUFFER, position_VBO_);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+    GpuMemory::track(GL_BUFFER, position_VBO_, GpuMemory::VertexBuffer, positions.size() * sizeof(glm::vec3));
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO_);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+
+    GLState::bind_vertex_array(0);
+
+    if (raycast)
+        bvh_ = TriangleBvh(positions, indices_, true);
 
     textures_.reserve(texture_options.size());
     for (auto& texture : texture_options) {
@@ -46,21 +73,34 @@ Mesh::Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned>& ind
 Mesh::~Mesh()
 {
     // LOGF("Mesh { .VAO:%u, .VBO:%u, .EBO:%u } deleted.", VAO_, VBO_, EBO_);
+    GLState::forget_vertex_array(VAO_);
+    GLState::forget_vertex_array(depth_VAO_);
+    GpuMemory::untrack(GL_BUFFER, VBO_);
+    GpuMemory::untrack(GL_BUFFER, EBO_);
+    GpuMemory::untrack(GL_BUFFER, position_VBO_);
     glDeleteVertexArrays(1, &VAO_);
     glDeleteBuffers(1, &VBO_);
     glDeleteBuffers(1, &EBO_);
+    glDeleteVertexArrays(1, &depth_VAO_);
+    glDeleteBuffers(1, &position_VBO_);
 }
 
 Mesh::Mesh(Mesh&& other)
     : VAO_(other.VAO_)
     , VBO_(other.VBO_)
     , EBO_(other.EBO_)
-    , vertices_(other.vertices_)
-    , indices_(other.indices_)
+    , depth_VAO_(other.depth_VAO_)
+    , position_VBO_(other.position_VBO_)
+    , vertices_(std::move(other.vertices_))
+    , indices_(std::move(other.indices_))
+    , bounds_(other.bounds_)
+    , bvh_(std::move(other.bvh_))
 {
     other.VAO_ = 0;
     other.VBO_ = 0;
     other.EBO_ = 0;
+    other.depth_VAO_ = 0;
+    other.position_VBO_ = 0;
     textures_.reserve(other.textures_.size());
     for (auto& texture : other.textures_) {
         textures_.push_back(texture);
@@ -72,6 +112,12 @@ unsigned Mesh::VAO() const
 {
     return VAO_;
 }
+
+unsigned Mesh::depth_VAO() const
+{
+    return depth_VAO_;
+}
+
 const std::vector<Vertex>& Mesh::vertices() const
 {
     return vertices_;
@@ -87,4 +133,14 @@ const std::vector<Texture>& Mesh::textures() const
     return textures_;
 }
 
+const Bounds& Mesh::bounds() const
+{
+    return bounds_;
+}
+
+const TriangleBvh& Mesh::bvh() const
+{
+    return bvh_;
+}
+
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "../math/bounds.h"
+#include "../math/triangle_bvh.h"
 #include "texture.h"
 #include "vertex.h"
 
@@ -7,22 +9,41 @@ namespace ngn {
 
 class Mesh {
 public:
-    Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned>& indices, const std::vector<Texture>& texture_options);
+    /**
+     * @brief Without {{raycast}}, no BVH is built, for geometry never picked, such as merged batches.
+     */
+    Mesh(std::vector<Vertex> vertices, std::vector<unsigned> indices, const std::vector<Texture>& texture_options, bool raycast = true);
     ~Mesh();
     Mesh(Mesh&&);
 
     Mesh(const Mesh&) = delete;
 
     unsigned VAO() const;
+    /**
+     * @brief Vertex array with a tightly packed position-only stream, for depth-only passes.
+     */
+    unsigned depth_VAO() const;
     const std::vector<Vertex>& vertices() const;
     const std::vector<unsigned>& indices() const;
     const std::vector<Texture>& textures() const;
+    /**
+     * @brief Bounds of the vertices, in model space.
+     */
+    const Bounds& bounds() const;
+    /**
+     * @brief Hierarchy over the triangles, in model space, built along with the mesh. Empty when the mesh
+     * was not built for raycasts.
+     */
+    const TriangleBvh& bvh() const;
 
 private:
     unsigned VAO_, VBO_, EBO_;
+    unsigned depth_VAO_, position_VBO_;
     std::vector<Vertex> vertices_;
     std::vector<unsigned> indices_;
     std::vector<Texture> textures_;
+    Bounds bounds_;
+    TriangleBvh bvh_;
 };
 
 }
@@ -1,102 +1,177 @@
 #include "model.h"
 
+#include "../io/assimp_io_system.h"
+#include "../jobs/jobs.h"
 #include "../utils/log.h"
+#include "gpu_memory.h"
 #include "texture.h"
 
 #include <assimp/Importer.hpp>
 #include <assimp/material.h>
 #include <assimp/postprocess.h>
+#include <assimp/scene.h>
 
-namespace ngn {
+#include <algorithm>
 
-Model::Model(const std::string& path)
-{
-    Assimp::Importer import;
-    const aiScene* scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+#if defined(__x86_64__) || defined(__i386__)
+#define NGN_X86
+#include <immintrin.h>
+#endif
 
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-        LOGERRF("ERROR::ASSIMP::%s", import.GetErrorString());
-        return;
-    }
-    directory_ = path.substr(0, path.find_last_of('/'));
+namespace ngn {
+
+static_assert(sizeof(aiVector3D) == 3 * sizeof(float), "Vertex conversion expects single precision Assimp");
+static_assert(sizeof(Vertex) == 8 * sizeof(float));
 
-    process_node(scene->mRootNode, scene);
+/**
+ * @brief Assimp meshes in the order nodes reference them, depth first.
+ */
+static void collect_nodes(const aiNode* node, const aiScene* scene, int parent, Model::Data& data, std::vector<const aiMesh*>& meshes)
+{
+    // Assimp matrices are row major
+    const aiMatrix4x4& m = node->mTransformation;
+    glm::mat4 transform {
+        glm::vec4(m.a1, m.b1, m.c1, m.d1),
+        glm::vec4(m.a2, m.b2, m.c2, m.d2),
+        glm::vec4(m.a3, m.b3, m.c3, m.d3),
+        glm::vec4(m.a4, m.b4, m.c4, m.d4),
+    };
+    int index = data.nodes.size();
+    data.nodes.push_back({ parent, transform, static_cast<unsigned>(meshes.size()), node->mNumMeshes });
+
+    for (unsigned i = 0; i < node->mNumMeshes; i++)
+        meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
+    for (unsigned i = 0; i < node->mNumChildren; i++)
+        collect_nodes(node->mChildren[i], scene, index, data, meshes);
 }
 
-void Model::process_node(aiNode* node, const aiScene* scene)
+/**
+ * @brief Interleaves the attribute streams of {{mesh}} into {{vertices}}, sized for all of them.
+ */
+static void convert_vertices(const aiMesh* mesh, Vertex* vertices)
 {
-    // process all the node's meshes (if any)
-    for (unsigned i = 0; i < node->mNumMeshes; i++) {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        process_mesh(mesh, scene);
+    size_t count = mesh->mNumVertices;
+    const aiVector3D* positions = mesh->mVertices;
+    const aiVector3D* normals = mesh->mNormals;
+    const aiVector3D* texture_coordinates = mesh->mTextureCoords[0];
+    float* out = reinterpret_cast<float*>(vertices);
+
+    size_t i = 0;
+#ifdef NGN_X86
+    // Every stream is there: 4 wide loads and shuffles per vertex. The loads read one float past the
+    // vertex, so the last one is left to the scalar loop.
+    if (normals && texture_coordinates) {
+        const float* p = &positions[0].x;
+        const float* n = &normals[0].x;
+        const float* t = &texture_coordinates[0].x;
+        for (; i + 1 < count; i++) {
+            __m128 position = _mm_loadu_ps(p + 3 * i);
+            __m128 normal = _mm_loadu_ps(n + 3 * i);
+            __m128 uv = _mm_loadu_ps(t + 3 * i);
+            // { z, z, nx, nx } then { x, y, z, nx }
+            __m128 z_nx = _mm_shuffle_ps(position, normal, _MM_SHUFFLE(0, 0, 2, 2));
+            _mm_storeu_ps(out + 8 * i, _mm_shuffle_ps(position, z_nx, _MM_SHUFFLE(2, 0, 1, 0)));
+            // { ny, nz, u, v }
+            _mm_storeu_ps(out + 8 * i + 4, _mm_shuffle_ps(normal, uv, _MM_SHUFFLE(1, 0, 2, 1)));
+        }
+    }
+#endif
+
+    // Branch once per stream rather than once per vertex.
+    for (size_t j = i; j < count; j++)
+        vertices[j].position = { positions[j].x, positions[j].y, positions[j].z };
+    if (normals) {
+        for (size_t j = i; j < count; j++)
+            vertices[j].normal = { normals[j].x, normals[j].y, normals[j].z };
+    } else {
+        for (size_t j = i; j < count; j++)
+            vertices[j].normal = { 0, 0, 1 };
     }
-    // then do the same for each of its children
-    for (unsigned i = 0; i < node->mNumChildren; i++) {
-        process_node(node->mChildren[i], scene);
+    if (texture_coordinates) {
+        for (size_t j = i; j < count; j++)
+            vertices[j].texture_coordinates = { texture_coordinates[j].x, texture_coordinates[j].y };
+    } else {
+        for (size_t j = i; j < count; j++)
+            vertices[j].texture_coordinates = { 0, 0 };
     }
 }
 
-void Model::process_mesh(aiMesh* mesh, const aiScene* scene)
+static void convert_indices(const aiMesh* mesh, std::vector<unsigned>& indices)
 {
-    std::vector<Vertex> vertices;
-    std::vector<unsigned> indices;
-    std::vector<Texture> textures;
-
-    for (unsigned i = 0; i < mesh->mNumVertices; i++) {
-        Vertex vertex;
-        glm::vec3 vector;
-        vector.x = mesh->mVertices[i].x;
-        vector.y = mesh->mVertices[i].y;
-        vector.z = mesh->mVertices[i].z;
-        vertex.position = vector;
-        vector.x = mesh->mNormals[i].x;
-        vector.y = mesh->mNormals[i].y;
-        vector.z = mesh->mNormals[i].z;
-        vertex.normal = vector;
-        if (mesh->mTextureCoords[0]) {
-            glm::vec2 vec;
-            vec.x = mesh->mTextureCoords[0][i].x;
-            vec.y = mesh->mTextureCoords[0][i].y;
-            vertex.texture_coordinates = vec;
-        } else
-            vertex.texture_coordinates = glm::vec2(0.0f, 0.0f);
-        vertices.push_back(vertex);
-    }
+    size_t count = 0;
+    for (unsigned i = 0; i < mesh->mNumFaces; i++)
+        count += mesh->mFaces[i].mNumIndices;
+    indices.resize(count);
+
+    unsigned* out = indices.data();
     for (unsigned i = 0; i < mesh->mNumFaces; i++) {
-        aiFace face = mesh->mFaces[i];
-        for (unsigned j = 0; j < face.mNumIndices; j++)
-            indices.push_back(face.mIndices[j]);
+        const aiFace& face = mesh->mFaces[i];
+        out = std::copy_n(face.mIndices, face.mNumIndices, out);
     }
-    if (mesh->mMaterialIndex >= 0) {
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+}
 
-        std::vector<Texture> diffuse_maps = load_material_textures(material,
-            aiTextureType_DIFFUSE, TextureType::Diffuse);
-        textures.insert(textures.end(), diffuse_maps.begin(), diffuse_maps.end());
+static void collect_textures(const aiMaterial* material, aiTextureType type, TextureType::Value type_name, const std::string& directory, Model::MeshData& mesh)
+{
+    for (unsigned i = 0; i < material->GetTextureCount(type); i++) {
+        aiString path;
+        material->GetTexture(type, i, &path);
+        mesh.textures.push_back({ directory + "/" + path.C_Str(), type_name });
+    }
+}
 
-        std::vector<Texture> specular_maps = load_material_textures(material,
-            aiTextureType_SPECULAR, TextureType::Specular);
-        textures.insert(textures.end(), specular_maps.begin(), specular_maps.end());
+Model::Data Model::load(const std::string& path)
+{
+    Data data;
+    Assimp::Importer import;
+    import.SetIOHandler(new AssimpIOSystem);
+    const aiScene* scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
 
-        std::vector<Texture> emission_maps = load_material_textures(material,
-            aiTextureType_EMISSIVE, TextureType::Emission);
-        textures.insert(textures.end(), emission_maps.begin(), emission_maps.end());
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        LOGERRF("ERROR::ASSIMP::%s", import.GetErrorString());
+        return data;
     }
-
-    meshes_.emplace_back(vertices, indices, textures);
+    std::string directory = path.substr(0, path.find_last_of('/'));
+
+    std::vector<const aiMesh*> meshes;
+    collect_nodes(scene->mRootNode, scene, -1, data, meshes);
+
+    // Meshes are independent: convert each on its own job, reading the scene concurrently.
+    data.meshes.resize(meshes.size());
+    jobs::parallel_for(0, meshes.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const aiMesh* mesh = meshes[i];
+            MeshData& mesh_data = data.meshes[i];
+
+            mesh_data.vertices.resize(mesh->mNumVertices);
+            convert_vertices(mesh, mesh_data.vertices.data());
+            convert_indices(mesh, mesh_data.indices);
+
+            const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+            collect_textures(material, aiTextureType_DIFFUSE, TextureType::Diffuse, directory, mesh_data);
+            collect_textures(material, aiTextureType_SPECULAR, TextureType::Specular, directory, mesh_data);
+            collect_textures(material, aiTextureType_EMISSIVE, TextureType::Emission, directory, mesh_data);
+        }
+    });
+    return data;
 }
 
-std::vector<Texture> Model::load_material_textures(aiMaterial* mat, aiTextureType type, TextureType::Value typeName)
+Model::Model(const std::string& path)
+    : Model(load(path), path)
 {
-    std::vector<Texture> textures;
-    for (unsigned i = 0; i < mat->GetTextureCount(type); i++) {
-        aiString str;
-        mat->GetTexture(type, i, &str);
+}
 
-        Texture texture = TexturePool::load(directory_ + "/" + str.C_Str(), typeName);
-        textures.push_back(texture);
+Model::Model(Data&& data, const std::string& name)
+    : nodes_(std::move(data.nodes))
+{
+    GpuMemory::Scope memory_scope(name);
+    meshes_.reserve(data.meshes.size());
+    for (auto& mesh : data.meshes) {
+        std::vector<Texture> textures;
+        textures.reserve(mesh.textures.size());
+        for (auto& [path, type] : mesh.textures)
+            textures.push_back(TexturePool::load(path, type));
+        meshes_.emplace_back(std::move(mesh.vertices), std::move(mesh.indices), textures);
     }
-    return textures;
 }
 
 const std::vector<Mesh>& Model::meshes() const
@@ -104,4 +179,18 @@ const std::vector<Mesh>& Model::meshes() const
     return meshes_;
 }
 
+Scene::Node Model::instantiate(Scene& scene, Scene::Node parent) const
+{
+    std::vector<Scene::Node> scene_nodes;
+    scene_nodes.reserve(nodes_.size());
+    for (auto& node : nodes_) {
+        Scene::Node scene_node = scene.create_node(node.parent < 0 ? parent : scene_nodes[node.parent]);
+        scene.set_local_transform(scene_node, node.transform);
+        for (unsigned i = 0; i < node.mesh_count; i++)
+            scene.attach(scene_node, meshes_[node.first_mesh + i]);
+        scene_nodes.push_back(scene_node);
+    }
+    return scene_nodes.empty() ? parent : scene_nodes.front();
+}
+
 }
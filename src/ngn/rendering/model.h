@@ -1,28 +1,77 @@
 #pragma once
 
+#include "../scene/scene.h"
 #include "mesh.h"
 #include "texture.h"
 
-#include <assimp/scene.h>
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace ngn {
 
 class Model {
+private:
+    struct Node {
+        /**
+         * @brief Index of the parent in {{nodes_}}, -1 for the root.
+         */
+        int parent;
+        glm::mat4 transform;
+        /**
+         * @brief Range of the node's meshes in {{meshes_}}.
+         */
+        unsigned first_mesh;
+        unsigned mesh_count;
+    };
+
 public:
+    /**
+     * @brief Mesh converted from Assimp, ready for upload.
+     */
+    struct MeshData {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned> indices;
+        std::vector<std::pair<std::string, TextureType::Value>> textures;
+    };
+
+    /**
+     * @brief CPU side of a model. Loading it makes no GL call, so it can run off the main thread.
+     */
+    struct Data {
+        std::vector<Node> nodes;
+        std::vector<MeshData> meshes;
+    };
+
+    /**
+     * @brief Reads {{path}} with Assimp and converts its meshes in parallel on the job threads.
+     */
+    static Data load(const std::string& path);
+
     Model(const std::string& path);
+    /**
+     * @brief Creates the GL objects of {{data}}, on the main thread. {{name}} owns their GPU memory.
+     */
+    Model(Data&& data, const std::string& name);
 
     Model(const Model&) = delete;
     Model(Model&&) = delete;
 
     const std::vector<Mesh>& meshes() const;
 
-private:
-    void process_node(aiNode* node, const aiScene* scene);
-    void process_mesh(aiMesh* mesh, const aiScene* scene);
-    std::vector<Texture> load_material_textures(aiMaterial* mat, aiTextureType type, TextureType::Value type_name);
+    /**
+     * @brief Creates the model's node hierarchy under {{parent}} and attaches its meshes.
+     *
+     * @return The model's root node.
+     */
+    Scene::Node instantiate(Scene& scene, Scene::Node parent = Scene::NO_PARENT) const;
 
+private:
     std::vector<Mesh> meshes_;
-    std::string directory_;
+    /**
+     * @brief Node hierarchy in depth first order, so parents come before their children.
+     */
+    std::vector<Node> nodes_;
 };
 
 }
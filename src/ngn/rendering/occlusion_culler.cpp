@@ -0,0 +1,180 @@
+#include "occlusion_culler.h"
+
+#include "gl_state.h"
+#include "gpu_memory.h"
+
+#include <glad/glad.h>
+
+#include <glm/ext/matrix_transform.hpp>
+
+#include <algorithm>
+#include <array>
+
+namespace ngn {
+
+/**
+ * @brief Unit cube from 0 to 1, scaled and moved onto each object's bounds.
+ */
+static constexpr std::array<float, 24> BOX_VERTICES {
+    0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0,
+    0, 0, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1
+};
+static constexpr std::array<unsigned char, 36> BOX_INDICES {
+    0, 2, 1, 0, 3, 2, // -z
+    4, 5, 6, 4, 6, 7, // +z
+    0, 1, 5, 0, 5, 4, // -y
+    3, 6, 2, 3, 7, 6, // +y
+    0, 4, 7, 0, 7, 3, // -x
+    1, 2, 6, 1, 6, 5, // +x
+};
+
+/**
+ * @brief Keeps flat bounds, such as a single quad, from producing a degenerate box.
+ */
+constexpr float MINIMUM_BOX_SIZE = 1e-3;
+
+OcclusionCuller::OcclusionCuller(unsigned hysteresis)
+    : hysteresis_(std::max(hysteresis, 1u))
+    , shader_("assets/shaders/depth.vert", "assets/shaders/depth.frag")
+{
+    glGenVertexArrays(1, &box_VAO_);
+    glGenBuffers(1, &box_VBO_);
+    glGenBuffers(1, &box_EBO_);
+
+    GLState::bind_vertex_array(box_VAO_);
+    glBindBuffer(GL_ARRAY_BUFFER, box_VBO_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(BOX_VERTICES), BOX_VERTICES.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, box_EBO_);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(BOX_INDICES), BOX_INDICES.data(), GL_STATIC_DRAW);
+    GpuMemory::track(GL_BUFFER, box_VBO_, GpuMemory::VertexBuffer, sizeof(BOX_VERTICES), "Occlusion culling");
+    GpuMemory::track(GL_BUFFER, box_EBO_, GpuMemory::IndexBuffer, sizeof(BOX_INDICES), "Occlusion culling");
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    GLState::bind_vertex_array(0);
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+    for (auto& object : objects_)
+        glDeleteQueries(1, &object.query);
+    GLState::forget_vertex_array(box_VAO_);
+    GpuMemory::untrack(GL_BUFFER, box_VBO_);
+    GpuMemory::untrack(GL_BUFFER, box_EBO_);
+    glDeleteVertexArrays(1, &box_VAO_);
+    glDeleteBuffers(1, &box_VBO_);
+    glDeleteBuffers(1, &box_EBO_);
+}
+
+void OcclusionCuller::collect(Object& object)
+{
+    if (!object.pending)
+        return;
+    int available = 0;
+    glGetQueryObjectiv(object.query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return;
+    unsigned any_samples_passed = 0;
+    glGetQueryObjectuiv(object.query, GL_QUERY_RESULT, &any_samples_passed);
+    object.pending = false;
+
+    if (any_samples_passed) {
+        object.visible = true;
+        object.occluded_results = 0;
+    } else if (++object.occluded_results >= hysteresis_) {
+        object.visible = false;
+    }
+}
+
+void OcclusionCuller::begin_frame()
+{
+    for (auto& object : objects_)
+        collect(object);
+}
+
+bool OcclusionCuller::is_visible(size_t object) const
+{
+    return object >= objects_.size() || objects_[object].visible;
+}
+
+bool OcclusionCuller::begin_conditional_render(size_t object) const
+{
+    if (object >= objects_.size() || !objects_[object].conditional)
+        return false;
+    glBeginConditionalRender(objects_[object].query, GL_QUERY_NO_WAIT);
+    return true;
+}
+
+void OcclusionCuller::end_conditional_render() const
+{
+    glEndConditionalRender();
+}
+
+void OcclusionCuller::begin_queries(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& camera_position, float near)
+{
+    stats_ = {};
+    camera_position_ = camera_position;
+    near_ = near;
+
+    shader_.use();
+    shader_.set("projection", projection);
+    shader_.set("view", view);
+    GLState::bind_vertex_array(box_VAO_);
+    GLState::color_mask(false);
+    GLState::depth_mask(false);
+    // Boxes of axis aligned meshes share their faces: they must pass against the mesh's own depth.
+    GLState::depth_func(GL_LEQUAL);
+    GLState::set_enabled(GL_CULL_FACE, false);
+}
+
+void OcclusionCuller::query(size_t object_index, const glm::mat4& model, const Bounds& bounds)
+{
+    if (bounds.empty())
+        return;
+    if (object_index >= objects_.size())
+        objects_.resize(object_index + 1);
+    Object& object = objects_[object_index];
+
+    stats_.tested++;
+    if (object.visible)
+        stats_.visible++;
+    else
+        stats_.occluded++;
+
+    // The near plane would clip a box around the camera: such objects are visible without asking.
+    glm::vec3 camera_position(glm::inverse(model) * glm::vec4(camera_position_, 1));
+    if (bounds.contains(camera_position, near_ * 2)) {
+        object.visible = true;
+        object.occluded_results = 0;
+        object.conditional = false;
+        return;
+    }
+    // Still in flight: issuing again would discard it and, under load, never produce a result.
+    if (object.pending)
+        return;
+
+    if (!object.query)
+        glGenQueries(1, &object.query);
+    glm::vec3 size = glm::max(bounds.max - bounds.min, glm::vec3(MINIMUM_BOX_SIZE));
+    shader_.set("model", glm::scale(glm::translate(model, bounds.min), size));
+    glBeginQuery(GL_ANY_SAMPLES_PASSED, object.query);
+    glDrawElements(GL_TRIANGLES, BOX_INDICES.size(), GL_UNSIGNED_BYTE, 0);
+    glEndQuery(GL_ANY_SAMPLES_PASSED);
+    object.pending = true;
+    object.conditional = true;
+}
+
+void OcclusionCuller::end_queries()
+{
+    GLState::set_enabled(GL_CULL_FACE, true);
+    GLState::depth_func(GL_LESS);
+    GLState::depth_mask(true);
+    GLState::color_mask(true);
+}
+
+OcclusionStats OcclusionCuller::stats() const
+{
+    return stats_;
+}
+
+}
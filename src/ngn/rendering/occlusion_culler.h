@@ -0,0 +1,102 @@
+#pragma once
+
+#include "../math/bounds.h"
+#include "shader.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace ngn {
+
+struct OcclusionStats {
+    /**
+     * @brief Objects whose bounding box was submitted during the last query pass.
+     */
+    unsigned tested;
+    unsigned visible;
+    unsigned occluded;
+};
+
+/**
+ * @brief Occlusion culling with one GL_ANY_SAMPLES_PASSED query per object, drawing its bounding box.
+ *
+ * Queries are issued after the opaque pass and only read back once available, so the visibility used
+ * by a frame comes from an earlier one and the CPU never waits for the GPU. An object is only hidden
+ * after several consecutive occluded results, but shown again as soon as one sample passes.
+ *
+ * Objects are identified by a caller chosen index, stable across frames.
+ */
+class OcclusionCuller {
+public:
+    static constexpr unsigned DEFAULT_HYSTERESIS = 3;
+
+    OcclusionCuller(unsigned hysteresis = DEFAULT_HYSTERESIS);
+    ~OcclusionCuller();
+
+    OcclusionCuller(const OcclusionCuller&) = delete;
+    OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+    OcclusionCuller(OcclusionCuller&&) = delete;
+
+    /**
+     * @brief Collects the query results that became available, without waiting.
+     */
+    void begin_frame();
+
+    /**
+     * @brief Visibility according to the CPU side results. Objects never tested are visible.
+     */
+    bool is_visible(size_t object) const;
+
+    /**
+     * @brief Lets the GPU skip the following draws if the last query of {{object}} found no sample.
+     *
+     * Uses the raw result, without hysteresis, and draws anyway while the result is not available yet.
+     *
+     * @return Whether conditional rendering started, in which case end_conditional_render() must follow.
+     */
+    bool begin_conditional_render(size_t object) const;
+    void end_conditional_render() const;
+
+    /**
+     * @brief Starts the query pass against the current depth buffer, with colour and depth writes off.
+     */
+    void begin_queries(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& camera_position, float near);
+    /**
+     * @brief Queries the bounding box of {{object}}, {{bounds}} being in the space {{model}} transforms.
+     */
+    void query(size_t object, const glm::mat4& model, const Bounds& bounds);
+    /**
+     * @brief Restores colour and depth writes, the default depth function and face culling.
+     */
+    void end_queries();
+
+    OcclusionStats stats() const;
+
+private:
+    struct Object {
+        unsigned query { 0 };
+        /**
+         * @brief Issued and not read back yet.
+         */
+        bool pending { false };
+        /**
+         * @brief The last issued query tested this object, so conditional rendering may use it.
+         */
+        bool conditional { false };
+        bool visible { true };
+        unsigned occluded_results { 0 };
+    };
+
+    void collect(Object& object);
+
+    unsigned hysteresis_;
+    Shader shader_;
+    unsigned box_VAO_, box_VBO_, box_EBO_;
+    std::vector<Object> objects_;
+    glm::vec3 camera_position_ { 0 };
+    float near_ { 0 };
+    OcclusionStats stats_ {};
+};
+
+}
@@ -0,0 +1,97 @@
+#include "readback_ring.h"
+
+#include "../utils/log.h"
+#include "gl_fence.h"
+#include "gpu_memory.h"
+
+#include <glad/glad.h>
+
+#include <cstring>
+
+namespace ngn {
+
+constexpr int CHANNELS = 4;
+
+ReadbackRing::ReadbackRing(size_t slot_count, const std::string& name)
+    : name_(name)
+    , slots_(slot_count)
+{
+    for (Slot& slot : slots_)
+        glGenBuffers(1, &slot.buffer);
+}
+
+ReadbackRing::~ReadbackRing()
+{
+    for (Slot& slot : slots_) {
+        GpuMemory::untrack(GL_BUFFER, slot.buffer);
+        glDeleteBuffers(1, &slot.buffer);
+    }
+    for (size_t i = 0; i < count_; i++)
+        glDeleteSync(static_cast<GLsync>(slots_[(first_ + i) % slots_.size()].fence));
+}
+
+bool ReadbackRing::full() const
+{
+    return count_ == slots_.size();
+}
+
+bool ReadbackRing::empty() const
+{
+    return count_ == 0;
+}
+
+void ReadbackRing::read(int width, int height, uint64_t tag)
+{
+    Slot& slot = slots_[(first_ + count_) % slots_.size()];
+    size_t bytes = static_cast<size_t>(width) * height * CHANNELS;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    // Like framebuffers, buffers only grow, so a ring reading the same size over and over never reallocates.
+    if (bytes > slot.capacity) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+        GpuMemory::untrack(GL_BUFFER, slot.buffer);
+        GpuMemory::track(GL_BUFFER, slot.buffer, GpuMemory::ReadbackBuffer, bytes, name_);
+        slot.capacity = bytes;
+    }
+    // Rows of RGBA8 pixels are always 4 byte aligned, as GL_PACK_ALIGNMENT expects by default.
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.tag = tag;
+    slot.width = width;
+    slot.height = height;
+    count_++;
+}
+
+bool ReadbackRing::collect(bool wait, uint64_t& tag, Image& image)
+{
+    if (empty())
+        return false;
+    Slot& slot = slots_[first_];
+    if (!fence_passed(slot.fence, wait))
+        return false;
+    glDeleteSync(static_cast<GLsync>(slot.fence));
+
+    size_t bytes = static_cast<size_t>(slot.width) * slot.height * CHANNELS;
+    image.width = slot.width;
+    image.height = slot.height;
+    image.channels = CHANNELS;
+    image.pixels.resize(bytes);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT)) {
+        std::memcpy(image.pixels.data(), pixels, bytes);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    } else {
+        LOGERRF("ERROR::READBACK::%s::MAP_FAILED", name_.c_str());
+        image.pixels.clear();
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    tag = slot.tag;
+    first_ = (first_ + 1) % slots_.size();
+    count_--;
+    return true;
+}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "../io/image_decoder.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ngn {
+
+/**
+ * @brief Reads framebuffers back through a ring of pixel pack buffers, without stalling the pipeline.
+ *
+ * read() only queues a copy into the next free buffer and fences it, so rendering goes on while the GPU
+ * copies. collect() fetches the pixels once the fence signaled, usually a few frames later. With N buffers,
+ * N reads may be in flight before the oldest has to be waited for.
+ */
+class ReadbackRing {
+public:
+    /**
+     * @brief {{name}} owns the buffers in GpuMemory.
+     */
+    ReadbackRing(size_t slot_count, const std::string& name);
+    ~ReadbackRing();
+
+    ReadbackRing(const ReadbackRing&) = delete;
+    ReadbackRing& operator=(const ReadbackRing&) = delete;
+    ReadbackRing(ReadbackRing&&) = delete;
+
+    /**
+     * @brief Every buffer holds a read not collected yet: collect() one before the next read().
+     */
+    bool full() const;
+    bool empty() const;
+
+    /**
+     * @brief Queues a read of the {{width}} by {{height}} RGBA pixels at the origin of the bound read
+     * framebuffer, identified by {{tag}} once collected.
+     */
+    void read(int width, int height, uint64_t tag);
+
+    /**
+     * @brief Copies the oldest read into {{image}}, bottom row first, if the GPU finished it or when {{wait}}.
+     *
+     * {{image}} has no pixels when the buffer could not be mapped: the read is collected, but failed.
+     *
+     * @return Whether a read was collected, and {{tag}} set to its tag.
+     */
+    bool collect(bool wait, uint64_t& tag, Image& image);
+
+private:
+    struct Slot {
+        unsigned buffer;
+        size_t capacity;
+        void* fence;
+        uint64_t tag;
+        int width;
+        int height;
+    };
+
+    std::string name_;
+    std::vector<Slot> slots_;
+    /**
+     * @brief Oldest read in flight, and number of reads in flight.
+     */
+    size_t first_ { 0 };
+    size_t count_ { 0 };
+};
+
+}
@@ -1,128 +1,234 @@
 #include "shader.h"
 
+#include "../io/file_system.h"
 #include "../utils/log.h"
+#include "gl_state.h"
 
 #include <glad/glad.h>
 
-#include <fstream>
+#include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
-#include <sstream>
+
+#include <algorithm>
+#include <array>
+#include <string_view>
 
 constexpr auto SHADER_LOG_SIZE = 512;
+// From GL_KHR_parallel_shader_compile, same value as GL_COMPLETION_STATUS_ARB.
+constexpr unsigned COMPLETION_STATUS = 0x91B1;
 
 namespace ngn {
-Shader::Shader(const std::string& vertex_path, const std::string& fragment_path)
-    : ID_(glCreateProgram())
+
+/**
+ * @brief #define lines of {{defines}}.
+ */
+static std::string preamble(const Shader::Defines& defines)
 {
-    std::string vertex_source;
-    std::string fragment_source;
-    std::ifstream vertex_file;
-    std::ifstream fragment_file;
+    std::string preamble;
+    for (auto& define : defines)
+        preamble += "#define " + define + "\n";
+    return preamble;
+}
 
-    vertex_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fragment_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    try {
-        vertex_file.open(vertex_path);
-        fragment_file.open(fragment_path);
+/**
+ * @brief Offset of the line following the #version directive of {{source}}, 0 without one.
+ */
+static size_t version_line_end(std::string_view source)
+{
+    // The directive may follow comments, blank lines or a byte order mark: look for it at any line start.
+    for (size_t line = 0; line < source.size();) {
+        size_t line_end = source.find('\n', line);
+        line_end = line_end == std::string_view::npos ? source.size() : line_end + 1;
+        std::string_view text = source.substr(line, line_end - line);
+        size_t directive = text.find_first_not_of(" \t");
+        if (directive != std::string_view::npos && text.substr(directive).starts_with("#version"))
+            return line_end;
+        line = line_end;
+    }
+    return 0;
+}
 
-        std::stringstream vertex_stream, fragment_stream;
+/**
+ * @brief Submits one stage with {{preamble}} after its #version line. Errors are read by Shader::check().
+ */
+static unsigned compile_stage(unsigned type, std::string_view source, const std::string& preamble)
+{
+    unsigned shader = glCreateShader(type);
+    // Sources are compiled straight from the mapped files, which are not null terminated.
+    if (preamble.empty()) {
+        const char* source_ptr = source.data();
+        int source_length = source.size();
+        glShaderSource(shader, 1, &source_ptr, &source_length);
+        glCompileShader(shader);
+        return shader;
+    }
 
-        vertex_stream << vertex_file.rdbuf();
-        fragment_stream << fragment_file.rdbuf();
+    // A #line directive after the definitions keeps error lines matching the file.
+    size_t version_end = version_line_end(source);
+    std::string definitions = preamble;
+    if (version_end > 0)
+        definitions += "#line " + std::to_string(std::count(source.begin(), source.begin() + version_end, '\n') + 1) + "\n";
+    std::array<const char*, 3> strings { source.data(), definitions.data(), source.data() + version_end };
+    std::array<int, 3> lengths { static_cast<int>(version_end), static_cast<int>(definitions.size()), static_cast<int>(source.size() - version_end) };
+    glShaderSource(shader, 3, strings.data(), lengths.data());
+    glCompileShader(shader);
+    return shader;
+}
 
-        vertex_file.close();
-        fragment_file.close();
+static const char* stage_name(int type)
+{
+    switch (type) {
+    case GL_VERTEX_SHADER:
+        return "VERTEX";
+    case GL_FRAGMENT_SHADER:
+        return "FRAGMENT";
+    case GL_COMPUTE_SHADER:
+        return "COMPUTE";
+    default:
+        return "UNKNOWN";
+    }
+}
 
-        vertex_source = vertex_stream.str();
-        fragment_source = fragment_stream.str();
-    } catch (std::ifstream::failure e) {
+Shader::Shader(const std::string& vertex_path, const std::string& fragment_path, const Defines& defines)
+    : ID_(glCreateProgram())
+{
+    FileView vertex_file = FileSystem::open(vertex_path);
+    FileView fragment_file = FileSystem::open(fragment_path);
+    if (!vertex_file || !fragment_file) {
         LOGERR("ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ");
-        glDeleteProgram(ID_);
+        checked_ = true;
         return;
     }
-    const char* vertex_source_ptr = vertex_source.c_str();
-    const char* fragment_source_ptr = fragment_source.c_str();
 
-    int success;
-    char info_log[SHADER_LOG_SIZE];
+    std::string stage_preamble = preamble(defines);
+    stages_[0] = compile_stage(GL_VERTEX_SHADER, vertex_file.text(), stage_preamble);
+    stages_[1] = compile_stage(GL_FRAGMENT_SHADER, fragment_file.text(), stage_preamble);
+    glAttachShader(ID_, stages_[0]);
+    glAttachShader(ID_, stages_[1]);
+    glLinkProgram(ID_);
 
-    unsigned vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vertex_source_ptr, NULL);
-    glCompileShader(vertex);
-    glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertex, SHADER_LOG_SIZE, NULL, info_log);
-        LOGERRF("ERROR::SHADER::VERTEX::COMPILATION_FAILED\n%s", info_log);
-    };
-
-    unsigned fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fragment_source_ptr, NULL);
-    glCompileShader(fragment);
-    glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragment, SHADER_LOG_SIZE, NULL, info_log);
-        LOGERRF("ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n%s", info_log);
-    };
+    LOGF("Program %u submitted.", ID_);
+}
 
-    glAttachShader(ID_, vertex);
-    glAttachShader(ID_, fragment);
-    glLinkProgram(ID_);
-    glGetProgramiv(ID_, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(ID_, SHADER_LOG_SIZE, NULL, info_log);
-        LOGERRF("ERROR::SHADER::PROGRAM::LINKING_FAILED\n%s", info_log);
+Shader::Shader(const std::string& compute_path, const Defines& defines)
+    : ID_(glCreateProgram())
+{
+    FileView compute_file = FileSystem::open(compute_path);
+    if (!compute_file) {
+        LOGERR("ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ");
+        checked_ = true;
+        return;
     }
 
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+    stages_[0] = compile_stage(GL_COMPUTE_SHADER, compute_file.text(), preamble(defines));
+    glAttachShader(ID_, stages_[0]);
+    glLinkProgram(ID_);
 
-    LOGF("Program %u created.", ID_);
+    LOGF("Program %u submitted.", ID_);
 }
 
 Shader::~Shader()
 {
     LOGF("Program %u deleted.", ID_);
+    for (unsigned stage : stages_)
+        glDeleteShader(stage);
+    GLState::forget_program(ID_);
     glDeleteProgram(ID_);
 }
 
 void Shader::use() const
 {
-    glUseProgram(ID_);
+    if (!checked_)
+        check();
+    GLState::use_program(ID_);
+}
+
+bool Shader::ready() const
+{
+    if (checked_ || !parallel_compile_supported())
+        return true;
+    int completed = 0;
+    glGetProgramiv(ID_, COMPLETION_STATUS, &completed);
+    return completed;
+}
+
+bool Shader::check() const
+{
+    if (checked_)
+        return linked_;
+    checked_ = true;
+
+    // Status queries block until the driver is done: deferred to here, they no longer serialise compiles.
+    for (unsigned& stage : stages_) {
+        if (!stage)
+            continue;
+        int success;
+        glGetShaderiv(stage, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            int type;
+            glGetShaderiv(stage, GL_SHADER_TYPE, &type);
+            char info_log[SHADER_LOG_SIZE];
+            glGetShaderInfoLog(stage, SHADER_LOG_SIZE, NULL, info_log);
+            LOGERRF("ERROR::SHADER::%s::COMPILATION_FAILED\n%s", stage_name(type), info_log);
+        }
+        // Still attached: freed along with the program.
+        glDeleteShader(stage);
+        stage = 0;
+    }
+
+    int success;
+    glGetProgramiv(ID_, GL_LINK_STATUS, &success);
+    if (!success) {
+        char info_log[SHADER_LOG_SIZE];
+        glGetProgramInfoLog(ID_, SHADER_LOG_SIZE, NULL, info_log);
+        LOGERRF("ERROR::SHADER::PROGRAM::LINKING_FAILED\n%s", info_log);
+    }
+    linked_ = success;
+    LOGF("Program %u created.", ID_);
+    return linked_;
+}
+
+bool Shader::parallel_compile_supported()
+{
+    // Queried through GLFW: glad is built without extensions. Needs the context current on first call.
+    static const bool supported = glfwExtensionSupported("GL_KHR_parallel_shader_compile")
+        || glfwExtensionSupported("GL_ARB_parallel_shader_compile");
+    return supported;
 }
 
 template <>
-void Shader::set(const std::string& name, int value) const
+void Shader::set(const char* name, int value) const
 {
-    int uniform_location = glGetUniformLocation(ID_, name.c_str());
+    int uniform_location = glGetUniformLocation(ID_, name);
     glUniform1i(uniform_location, value);
 }
 
 template <>
-void Shader::set(const std::string& name, float value) const
+void Shader::set(const char* name, float value) const
 {
-    int uniform_location = glGetUniformLocation(ID_, name.c_str());
+    int uniform_location = glGetUniformLocation(ID_, name);
     glUniform1f(uniform_location, value);
 }
 
 template <>
-void Shader::set(const std::string& name, glm::vec3 value) const
+void Shader::set(const char* name, glm::vec3 value) const
 {
-    int uniform_location = glGetUniformLocation(ID_, name.c_str());
+    int uniform_location = glGetUniformLocation(ID_, name);
     glUniform3fv(uniform_location, 1, glm::value_ptr(value));
 }
 
 template <>
-void Shader::set(const std::string& name, glm::vec4 value) const
+void Shader::set(const char* name, glm::vec4 value) const
 {
-    int uniform_location = glGetUniformLocation(ID_, name.c_str());
+    int uniform_location = glGetUniformLocation(ID_, name);
     glUniform4fv(uniform_location, 1, glm::value_ptr(value));
 }
 
 template <>
-void Shader::set(const std::string& name, glm::mat4 value) const
+void Shader::set(const char* name, glm::mat4 value) const
 {
-    int uniform_location = glGetUniformLocation(ID_, name.c_str());
+    int uniform_location = glGetUniformLocation(ID_, name);
     glUniformMatrix4fv(uniform_location, 1, GL_FALSE, glm::value_ptr(value));
 }
 }
@@ -1,25 +1,75 @@
 #pragma once
 
+#include <array>
 #include <string>
+#include <vector>
 
 namespace ngn {
+/**
+ * @brief Program built from shader files.
+ *
+ * Constructing a program only submits it to the driver. Its compile and link statuses are checked on the
+ * first use(), so programs constructed one after the other compile in parallel where the driver compiles
+ * in the background (see ShaderLibrary).
+ */
 class Shader {
 public:
-    Shader(const std::string& vertex_path, const std::string& fragment_path);
+    /**
+     * @brief Definitions inserted after the #version line of every stage, e.g. "SHADOWS" or "NR_CASCADES 2",
+     * to build variants of the same sources.
+     */
+    using Defines = std::vector<std::string>;
+
+    Shader(const std::string& vertex_path, const std::string& fragment_path, const Defines& defines = {});
+    /**
+     * @brief Compute program, requires GL 4.3.
+     */
+    explicit Shader(const std::string& compute_path, const Defines& defines = {});
     ~Shader();
 
     Shader(Shader&&) = delete;
     Shader(const Shader&) = delete;
     Shader& operator=(const Shader&) = delete;
 
+    /**
+     * @brief Binds the program, after checking it on the first call.
+     */
     void use() const;
+
+    /**
+     * @brief Whether the driver is done compiling and linking, without waiting for it.
+     */
+    bool ready() const;
+    /**
+     * @brief Waits for the driver, and logs the errors of the program the first time.
+     *
+     * @return Whether the program linked.
+     */
+    bool check() const;
+
+    /**
+     * @brief Whether the driver compiles on its own threads, and tells when it is done
+     * (GL_KHR_parallel_shader_compile or GL_ARB_parallel_shader_compile).
+     */
+    static bool parallel_compile_supported();
     /**
      * @brief Sets the value of a given uniform for this shader.
      */
     template <class T>
-    void set(const std::string& name, T value) const;
+    void set(const char* name, T value) const;
+    template <class T>
+    void set(const std::string& name, T value) const
+    {
+        set(name.c_str(), value);
+    }
 
 private:
     const unsigned ID_;
+    /**
+     * @brief Compiled stages, kept until check() read their logs.
+     */
+    mutable std::array<unsigned, 2> stages_ { 0, 0 };
+    mutable bool checked_ { false };
+    mutable bool linked_ { false };
 };
 }
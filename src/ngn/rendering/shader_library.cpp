@@ -0,0 +1,70 @@
+#include "shader_library.h"
+
+#include <glad/glad.h>
+
+#include <GLFW/glfw3.h>
+
+namespace ngn {
+
+ShaderLibrary::ShaderLibrary()
+{
+    if (!Shader::parallel_compile_supported())
+        return;
+    // Same signature in both extensions. Loaded here, as glad is built without extensions.
+    using MaxShaderCompilerThreads = void(APIENTRYP)(GLuint count);
+    auto max_threads = reinterpret_cast<MaxShaderCompilerThreads>(glfwGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+    if (!max_threads)
+        max_threads = reinterpret_cast<MaxShaderCompilerThreads>(glfwGetProcAddress("glMaxShaderCompilerThreadsARB"));
+    // 0xFFFFFFFF leaves the number of threads to the implementation.
+    if (max_threads)
+        max_threads(0xFFFFFFFF);
+}
+
+const Shader& ShaderLibrary::add(const std::string& vertex_path, const std::string& fragment_path, const Shader::Defines& defines)
+{
+    return add_variant(defines, vertex_path, fragment_path);
+}
+
+const Shader& ShaderLibrary::add_compute(const std::string& compute_path, const Shader::Defines& defines)
+{
+    return add_variant(defines, compute_path);
+}
+
+size_t ShaderLibrary::ready_count() const
+{
+    size_t ready = 0;
+    for (auto& shader : shaders_)
+        ready += shader->ready();
+    return ready;
+}
+
+size_t ShaderLibrary::check_all() const
+{
+    size_t failed = 0;
+    for (auto& shader : shaders_)
+        failed += !shader->check();
+    return failed;
+}
+
+size_t ShaderLibrary::size() const
+{
+    return shaders_.size();
+}
+
+template <class... Paths>
+const Shader& ShaderLibrary::add_variant(const Shader::Defines& defines, const Paths&... paths)
+{
+    // Paths and defines can't hold line breaks, which makes them safe separators.
+    std::string key;
+    for (const std::string& part : { paths... })
+        key += part + '\n';
+    for (auto& define : defines)
+        key += '\n' + define;
+
+    auto [variant, inserted] = variants_.try_emplace(key, shaders_.size());
+    if (inserted)
+        shaders_.push_back(std::make_unique<Shader>(paths..., defines));
+    return *shaders_[variant->second];
+}
+
+}
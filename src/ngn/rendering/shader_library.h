@@ -0,0 +1,62 @@
+#pragma once
+
+#include "shader.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ngn {
+
+/**
+ * @brief Every program of the application, submitted up front so the driver compiles them in parallel.
+ *
+ * With GL_KHR_parallel_shader_compile or GL_ARB_parallel_shader_compile, the driver compiles on its own
+ * threads, so startup waits for the slowest program rather than for all of them in turn. Without them, the
+ * driver still gets every program before the first status query. Each program is checked on its first use
+ * either way, so nothing waits before a program is actually needed.
+ */
+class ShaderLibrary {
+public:
+    /**
+     * @brief Lets the driver use as many compiler threads as it sees fit, where it can.
+     */
+    ShaderLibrary();
+    ~ShaderLibrary() = default;
+
+    ShaderLibrary(const ShaderLibrary&) = delete;
+    ShaderLibrary& operator=(const ShaderLibrary&) = delete;
+    ShaderLibrary(ShaderLibrary&&) = delete;
+
+    /**
+     * @brief Submits the program of {{vertex_path}} and {{fragment_path}} built with {{defines}}, unless
+     * the same variant already was. The program lives as long as the library.
+     */
+    const Shader& add(const std::string& vertex_path, const std::string& fragment_path, const Shader::Defines& defines = {});
+    const Shader& add_compute(const std::string& compute_path, const Shader::Defines& defines = {});
+
+    /**
+     * @brief Programs the driver is done with, without waiting for the others.
+     */
+    size_t ready_count() const;
+    /**
+     * @brief Waits for every program and checks them.
+     *
+     * @return How many failed to build.
+     */
+    size_t check_all() const;
+    size_t size() const;
+
+private:
+    template <class... Paths>
+    const Shader& add_variant(const Shader::Defines& defines, const Paths&... paths);
+
+    std::vector<std::unique_ptr<Shader>> shaders_;
+    /**
+     * @brief Index in {{shaders_}} by paths and defines.
+     */
+    std::unordered_map<std::string, size_t> variants_;
+};
+
+}
@@ -1,15 +1,21 @@
 #include "texture.h"
 
+#include "../io/file_system.h"
+#include "../io/image_decoder.h"
 #include "../utils/log.h"
-
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
 
 #include <glad/glad.h>
 
+#include <algorithm>
+#include <map>
+#include <set>
+#include <tuple>
+
 namespace ngn {
 
-std::string TextureType::to_string(TextureType::Value type)
+const char* TextureType::to_string(TextureType::Value type)
 {
     switch (static_cast<int>(type)) {
     case Diffuse:
@@ -23,49 +29,76 @@ std::string TextureType::to_string(TextureType::Value type)
     }
 }
 
+static void set_array_parameters()
+{
+    // Texture repeat
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    // Texture filtering
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
 Texture::Texture(const std::string& path, TextureType::Value type)
     : type_(type)
     , path_(path)
 {
-    // Texture loading
-    stbi_set_flip_vertically_on_load(true);
-    int width, height, number_of_channels;
-    unsigned char* data = stbi_load(path.c_str(), &width, &height, &number_of_channels, 0);
-    if (!data) {
+    // Texture loading, the first row at the bottom as GL expects
+    FileView file = FileSystem::open(path);
+    Image image;
+    if (!file || !decode_image(file.data(), file.size(), true, image)) {
         LOGERR("Failed to load image.");
         throw;
     }
+    width_ = image.width;
+    height_ = image.height;
 
-    // Generate Texture
-    glGenTextures(1, &id_);
+    // Every texture starts as its own single layer array, until TexturePool::pack merges it.
+    unsigned id;
+    glGenTextures(1, &id);
+    GLState::bind_texture(0, GL_TEXTURE_2D_ARRAY, id);
+    set_array_parameters();
 
-    // Bind Texture
-    glBindTexture(GL_TEXTURE_2D, id_);
+    // Load Texture
+    unsigned color_mode = image.channels == 4 ? GL_RGBA : GL_RGB;
+    format_ = image.channels == 4 ? GL_RGBA8 : GL_RGB8;
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, format_, width_, height_, 1, 0, color_mode, GL_UNSIGNED_BYTE, image.pixels.data());
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    layer_ = std::make_shared<TextureLayer>(TextureLayer { id, 0 });
+    GpuMemory::track(GL_TEXTURE, id, GpuMemory::Texture, bytes(), path);
+
+    LOGF("Texture %u created.", id);
+}
 
-    // Texture repeat
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    // For GL_CLAMP_TO_BORDER
-    // float borderColor[] = { 1.0f, 1.0f, 0.0f, 1.0f };
-    // glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
+unsigned Texture::id() const
+{
+    return layer_->array;
+}
 
-    // Texture filtering
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+int Texture::layer() const
+{
+    return layer_->index;
+}
 
-    // Load Texture
-    unsigned color_mode = number_of_channels == 4 ? GL_RGBA : GL_RGB;
-    glTexImage2D(GL_TEXTURE_2D, 0, color_mode, width, height, 0, color_mode, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
+int Texture::width() const
+{
+    return width_;
+}
 
-    // Free Image data
-    stbi_image_free(data);
-    LOGF("Texture %u created.", id_);
+int Texture::height() const
+{
+    return height_;
 }
 
-unsigned Texture::id() const
+unsigned Texture::format() const
+{
+    return format_;
+}
+
+size_t Texture::bytes() const
 {
-    return id_;
+    return GpuMemory::texture_bytes(format_, width_, height_, 1, true);
 }
 
 TextureType::Value Texture::type() const
@@ -82,9 +115,14 @@ TexturePool TexturePool::instance_ {};
 
 TexturePool::~TexturePool()
 {
-    for (auto& texture : textures_) {
-        LOGF("Texture %u deleted.", texture.id());
-        glDeleteTextures(1, &texture.id_);
+    std::set<unsigned> arrays;
+    for (auto& texture : textures_)
+        arrays.insert(texture.id());
+    for (unsigned array : arrays) {
+        LOGF("Texture %u deleted.", array);
+        GLState::forget_texture(array);
+        GpuMemory::untrack(GL_TEXTURE, array);
+        glDeleteTextures(1, &array);
     }
 }
 
@@ -100,4 +138,91 @@ Texture TexturePool::instance_load(const std::string& path, TextureType::Value t
     return textures_.back();
 }
 
+void TexturePool::instance_pack()
+{
+    std::map<std::tuple<int, int, unsigned>, std::vector<Texture*>> groups;
+    for (auto& texture : textures_)
+        groups[{ texture.width_, texture.height_, texture.format_ }].push_back(&texture);
+
+    unsigned read_framebuffer;
+    glGenFramebuffers(1, &read_framebuffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, read_framebuffer);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+
+    for (auto& [key, group] : groups) {
+        std::set<unsigned> old_arrays;
+        for (Texture* texture : group)
+            old_arrays.insert(texture->id());
+        if (old_arrays.size() < 2)
+            continue;
+        auto [width, height, format] = key;
+
+        unsigned array;
+        glGenTextures(1, &array);
+        GLState::bind_texture(0, GL_TEXTURE_2D_ARRAY, array);
+        set_array_parameters();
+        unsigned color_mode = format == GL_RGBA8 ? GL_RGBA : GL_RGB;
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, format, width, height, group.size(), 0, color_mode, GL_UNSIGNED_BYTE, nullptr);
+
+        // Copy on the GPU, the images are not kept in memory once uploaded.
+        for (size_t i = 0; i < group.size(); i++) {
+            TextureLayer& layer = *group[i]->layer_;
+            glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, layer.array, 0, layer.index);
+            glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, 0, 0, width, height);
+            layer = { array, static_cast<int>(i) };
+        }
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        GpuMemory::track(GL_TEXTURE, array, GpuMemory::Texture, GpuMemory::texture_bytes(format, width, height, group.size(), true),
+            "Packed " + std::to_string(width) + "x" + std::to_string(height) + " textures");
+
+        glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, 0, 0, 0);
+        for (unsigned old_array : old_arrays) {
+            GLState::forget_texture(old_array);
+            GpuMemory::untrack(GL_TEXTURE, old_array);
+            glDeleteTextures(1, &old_array);
+        }
+        LOGF("Texture %u created with %zu %dx%d layers.", array, group.size(), width, height);
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &read_framebuffer);
+    GLState::bind_texture(0, GL_TEXTURE_2D_ARRAY, 0);
+}
+
+size_t TexturePool::instance_array_count() const
+{
+    std::set<unsigned> arrays;
+    for (auto& texture : textures_)
+        arrays.insert(texture.id());
+    return arrays.size();
+}
+
+size_t TexturePool::instance_release_unused()
+{
+    // Copies of a texture share its layer: only the pool's own copy left means nothing uses it. Packed
+    // arrays can only go as a whole, so a layer still in use keeps every texture of its array.
+    std::set<unsigned> used_arrays;
+    for (auto& texture : textures_) {
+        if (texture.layer_.use_count() > 1)
+            used_arrays.insert(texture.id());
+    }
+    std::set<unsigned> unused_arrays;
+    auto unused = std::remove_if(textures_.begin(), textures_.end(), [&](const Texture& texture) {
+        if (used_arrays.count(texture.id()))
+            return false;
+        unused_arrays.insert(texture.id());
+        return true;
+    });
+    size_t released = textures_.end() - unused;
+    textures_.erase(unused, textures_.end());
+
+    for (unsigned array : unused_arrays) {
+        LOGF("Texture %u deleted.", array);
+        GLState::forget_texture(array);
+        GpuMemory::untrack(GL_TEXTURE, array);
+        glDeleteTextures(1, &array);
+    }
+    return released;
+}
+
 }
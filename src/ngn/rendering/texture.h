@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include <vector>
 namespace ngn {
@@ -14,26 +15,54 @@ public:
         Emission,
     };
 
-    static std::string to_string(TextureType::Value);
+    static const char* to_string(TextureType::Value);
 
 private:
 };
 
+/**
+ * @brief Location of a texture: a layer of a GL_TEXTURE_2D_ARRAY.
+ */
+struct TextureLayer {
+    unsigned array;
+    int index;
+};
+
 class Texture {
 public:
     ~Texture() = default;
     Texture(const Texture&) = default;
 
+    /**
+     * @brief Texture array holding this texture. Copies share it, so they follow when the pool packs.
+     */
     unsigned id() const;
+    /**
+     * @brief Layer of this texture in id().
+     */
+    int layer() const;
     TextureType::Value type() const;
+    int width() const;
+    int height() const;
+    /**
+     * @brief Sized internal format.
+     */
+    unsigned format() const;
+    /**
+     * @brief GPU memory used, mip chain included.
+     */
+    size_t bytes() const;
     const std::string& path() const;
 
 private:
     Texture(const std::string& path, TextureType::Value type);
 
-    unsigned id_;
+    std::shared_ptr<TextureLayer> layer_;
     TextureType::Value type_;
     std::string path_;
+    int width_;
+    int height_;
+    unsigned format_;
 
     friend TexturePool;
 };
@@ -47,12 +76,40 @@ public:
     {
         return instance_.instance_load(path, type);
     }
+    /**
+     * @brief Merges loaded textures of the same size and format into shared texture arrays, one layer each,
+     * so meshes with different materials can be drawn without rebinding.
+     */
+    static inline void pack()
+    {
+        instance_.instance_pack();
+    }
+    /**
+     * @brief Number of texture arrays in use.
+     */
+    static inline size_t array_count()
+    {
+        return instance_.instance_array_count();
+    }
+    /**
+     * @brief Deletes the textures only the pool still refers to, once the whole array holding them is unused,
+     * e.g. after the model they were loaded for was freed. Loading one again reads it from its file.
+     *
+     * @return Number of textures released.
+     */
+    static inline size_t release_unused()
+    {
+        return instance_.instance_release_unused();
+    }
 
 private:
     TexturePool() = default;
     ~TexturePool();
 
     Texture instance_load(const std::string& path, TextureType::Value type);
+    void instance_pack();
+    size_t instance_array_count() const;
+    size_t instance_release_unused();
 
     static TexturePool instance_;
 
@@ -0,0 +1,135 @@
+#include "weighted_blended_oit.h"
+
+#include "../utils/log.h"
+#include "gl_state.h"
+#include "gpu_memory.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+
+namespace ngn {
+
+WeightedBlendedOIT::WeightedBlendedOIT()
+    : composite_shader_("assets/shaders/oit_composite.vert", "assets/shaders/oit_composite.frag")
+{
+    glGenVertexArrays(1, &empty_VAO_);
+    composite_shader_.use();
+    composite_shader_.set("accumulation", 0);
+    composite_shader_.set("weight", 1);
+}
+
+WeightedBlendedOIT::~WeightedBlendedOIT()
+{
+    release();
+    GLState::forget_vertex_array(empty_VAO_);
+    glDeleteVertexArrays(1, &empty_VAO_);
+}
+
+void WeightedBlendedOIT::begin(unsigned source_framebuffer, int width, int height)
+{
+    // Only grows: with dynamic resolution the rendered area changes every frame. Composition fetches
+    // texels at the fragment coordinates, so a larger target is fine.
+    if (width > width_ || height > height_)
+        resize(std::max(width, width_), std::max(height, height_));
+    source_framebuffer_ = source_framebuffer;
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, source_framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer_);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+
+    // Revealage lives in the accumulation alpha, so it starts fully revealed.
+    const float accumulation_clear[] = { 0, 0, 0, 1 };
+    const float weight_clear[] = { 0, 0, 0, 0 };
+    glClearBufferfv(GL_COLOR, 0, accumulation_clear);
+    glClearBufferfv(GL_COLOR, 1, weight_clear);
+
+    // GL 3.3 has no per-buffer blend functions: colours and weights add up, while the alpha
+    // factors multiply the revealage stored in the accumulation alpha.
+    GLState::depth_mask(false);
+    GLState::blend_func_separate(GL_ONE, GL_ONE, GL_ZERO, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void WeightedBlendedOIT::end()
+{
+    GLState::blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    GLState::depth_mask(true);
+    glBindFramebuffer(GL_FRAMEBUFFER, source_framebuffer_);
+}
+
+void WeightedBlendedOIT::composite() const
+{
+    GLState::set_enabled(GL_DEPTH_TEST, false);
+    GLState::blend_func(GL_ONE_MINUS_SRC_ALPHA, GL_SRC_ALPHA);
+
+    composite_shader_.use();
+    GLState::bind_texture(0, GL_TEXTURE_2D, accumulation_);
+    GLState::bind_texture(1, GL_TEXTURE_2D, weight_);
+
+    GLState::bind_vertex_array(empty_VAO_);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    GLState::blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    GLState::set_enabled(GL_DEPTH_TEST, true);
+}
+
+void WeightedBlendedOIT::resize(int width, int height)
+{
+    release();
+    width_ = width;
+    height_ = height;
+
+    glGenFramebuffers(1, &framebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+
+    glGenTextures(1, &accumulation_);
+    GLState::bind_texture(0, GL_TEXTURE_2D, accumulation_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA, GL_HALF_FLOAT, nullptr);
+    GpuMemory::track(GL_TEXTURE, accumulation_, GpuMemory::RenderTarget, GpuMemory::texture_bytes(GL_RGBA16F, width, height, 1, false), "OIT");
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, accumulation_, 0);
+
+    glGenTextures(1, &weight_);
+    GLState::bind_texture(0, GL_TEXTURE_2D, weight_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, width, height, 0, GL_RED, GL_HALF_FLOAT, nullptr);
+    GpuMemory::track(GL_TEXTURE, weight_, GpuMemory::RenderTarget, GpuMemory::texture_bytes(GL_R16F, width, height, 1, false), "OIT");
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, weight_, 0);
+
+    // Same format as the default framebuffer, so depth can be blitted into it.
+    glGenRenderbuffers(1, &depth_);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+    GpuMemory::track(GL_RENDERBUFFER, depth_, GpuMemory::RenderTarget, GpuMemory::texture_bytes(GL_DEPTH24_STENCIL8, width, height, 1, false), "OIT");
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_);
+
+    const unsigned draw_buffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, draw_buffers);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        LOGERR("ERROR::OIT::FRAMEBUFFER_INCOMPLETE");
+    }
+
+    GLState::bind_texture(0, GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    LOGF("OIT targets resized to %dx%d.", width, height);
+}
+
+void WeightedBlendedOIT::release()
+{
+    glDeleteFramebuffers(1, &framebuffer_);
+    GLState::forget_texture(accumulation_);
+    GLState::forget_texture(weight_);
+    GpuMemory::untrack(GL_TEXTURE, accumulation_);
+    GpuMemory::untrack(GL_TEXTURE, weight_);
+    GpuMemory::untrack(GL_RENDERBUFFER, depth_);
+    glDeleteTextures(1, &accumulation_);
+    glDeleteTextures(1, &weight_);
+    glDeleteRenderbuffers(1, &depth_);
+    framebuffer_ = accumulation_ = weight_ = depth_ = 0;
+}
+
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "shader.h"
+
+namespace ngn {
+
+/**
+ * @brief Order independent transparency with weighted blended accumulation (McGuire & Bavoil).
+ *
+ * Transparent geometry is drawn in any order between begin() and end() with a shader writing
+ * the weighted colour to location 0 and the weighted alpha to location 1, then composite()
+ * resolves it over the opaque scene.
+ */
+class WeightedBlendedOIT {
+public:
+    WeightedBlendedOIT();
+    ~WeightedBlendedOIT();
+
+    WeightedBlendedOIT(const WeightedBlendedOIT&) = delete;
+    WeightedBlendedOIT& operator=(const WeightedBlendedOIT&) = delete;
+    WeightedBlendedOIT(WeightedBlendedOIT&&) = delete;
+
+    /**
+     * @brief Binds the accumulation targets, copying the depth of {{source_framebuffer}} so opaque geometry occludes.
+     */
+    void begin(unsigned source_framebuffer, int width, int height);
+    /**
+     * @brief Restores blending and depth writes and binds back the source framebuffer.
+     */
+    void end();
+    /**
+     * @brief Blends the resolved transparent layer over the currently bound framebuffer.
+     */
+    void composite() const;
+
+private:
+    void resize(int width, int height);
+    void release();
+
+    Shader composite_shader_;
+    unsigned framebuffer_ { 0 };
+    unsigned accumulation_ { 0 };
+    unsigned weight_ { 0 };
+    unsigned depth_ { 0 };
+    unsigned empty_VAO_ { 0 };
+    int width_ { 0 };
+    int height_ { 0 };
+    unsigned source_framebuffer_ { 0 };
+};
+
+}
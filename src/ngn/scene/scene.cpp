@@ -0,0 +1,182 @@
+#include "scene.h"
+
+#include "../rendering/mesh.h"
+
+#include <algorithm>
+
+namespace ngn {
+
+Scene::Node Scene::create_node(Node parent)
+{
+    Node node = static_cast<Node>(parents_.size());
+    parents_.push_back(parent);
+    first_children_.push_back(NO_PARENT);
+    next_siblings_.push_back(NO_PARENT);
+    translations_.emplace_back(0);
+    rotations_.emplace_back(1, 0, 0, 0);
+    scales_.emplace_back(1);
+    world_matrices_.emplace_back(1);
+    dirty_.push_back(false);
+    static_.push_back(parent != NO_PARENT && static_[parent]);
+
+    if (parent != NO_PARENT) {
+        next_siblings_[node] = first_children_[parent];
+        first_children_[parent] = node;
+    }
+    mark_dirty(node);
+    return node;
+}
+
+void Scene::set_translation(Node node, const glm::vec3& translation)
+{
+    translations_[node] = translation;
+    mark_dirty(node);
+}
+
+void Scene::set_rotation(Node node, const glm::quat& rotation)
+{
+    rotations_[node] = rotation;
+    mark_dirty(node);
+}
+
+void Scene::set_scale(Node node, const glm::vec3& scale)
+{
+    scales_[node] = scale;
+    mark_dirty(node);
+}
+
+void Scene::set_local_transform(Node node, const glm::mat4& transform)
+{
+    glm::vec3 scale {
+        glm::length(glm::vec3(transform[0])),
+        glm::length(glm::vec3(transform[1])),
+        glm::length(glm::vec3(transform[2])),
+    };
+    // A mirroring transform is kept as a negative scale on x.
+    if (glm::dot(glm::cross(glm::vec3(transform[0]), glm::vec3(transform[1])), glm::vec3(transform[2])) < 0)
+        scale.x = -scale.x;
+
+    glm::mat3 rotation {
+        glm::vec3(transform[0]) / scale.x,
+        glm::vec3(transform[1]) / scale.y,
+        glm::vec3(transform[2]) / scale.z,
+    };
+
+    translations_[node] = glm::vec3(transform[3]);
+    rotations_[node] = glm::normalize(glm::quat_cast(rotation));
+    scales_[node] = scale;
+    mark_dirty(node);
+}
+
+const glm::vec3& Scene::translation(Node node) const
+{
+    return translations_[node];
+}
+
+const glm::quat& Scene::rotation(Node node) const
+{
+    return rotations_[node];
+}
+
+const glm::vec3& Scene::scale(Node node) const
+{
+    return scales_[node];
+}
+
+const glm::mat4& Scene::world_matrix(Node node) const
+{
+    return world_matrices_[node];
+}
+
+Scene::Node Scene::parent(Node node) const
+{
+    return parents_[node];
+}
+
+size_t Scene::size() const
+{
+    return parents_.size();
+}
+
+void Scene::set_static(Node node, bool is_static)
+{
+    static_[node] = is_static;
+}
+
+bool Scene::is_static(Node node) const
+{
+    return static_[node];
+}
+
+void Scene::attach(Node node, const Mesh& mesh)
+{
+    renderables_.push_back({ node, &mesh });
+}
+
+const std::vector<Scene::Renderable>& Scene::renderables() const
+{
+    return renderables_;
+}
+
+std::optional<Scene::RayHit> Scene::raycast(const Ray& ray) const
+{
+    std::optional<RayHit> closest;
+    float max_distance = INFINITY;
+    for (auto& renderable : renderables_) {
+        // The direction is not normalized in model space, so distances stay those along the world ray.
+        glm::mat4 inverse = glm::inverse(world_matrices_[renderable.node]);
+        Ray model_ray { glm::vec3(inverse * glm::vec4(ray.origin, 1)), glm::mat3(inverse) * ray.direction };
+        if (auto hit = renderable.mesh->bvh().intersect(model_ray, max_distance)) {
+            max_distance = hit->distance;
+            closest = RayHit { renderable.node, renderable.mesh, *hit };
+        }
+    }
+    return closest;
+}
+
+size_t Scene::update()
+{
+    // Parents have lower indices than their children, so ancestors come first and clean their subtrees.
+    std::sort(dirty_nodes_.begin(), dirty_nodes_.end());
+
+    size_t updated = 0;
+    for (Node root : dirty_nodes_) {
+        if (!dirty_[root])
+            continue;
+
+        update_stack_.push_back(root);
+        while (!update_stack_.empty()) {
+            Node node = update_stack_.back();
+            update_stack_.pop_back();
+
+            glm::mat3 rotation = glm::mat3_cast(rotations_[node]);
+            const glm::vec3& scale = scales_[node];
+            glm::mat4 local {
+                glm::vec4(rotation[0] * scale.x, 0),
+                glm::vec4(rotation[1] * scale.y, 0),
+                glm::vec4(rotation[2] * scale.z, 0),
+                glm::vec4(translations_[node], 1),
+            };
+
+            Node parent = parents_[node];
+            world_matrices_[node] = parent == NO_PARENT ? local : world_matrices_[parent] * local;
+            dirty_[node] = false;
+            updated++;
+
+            for (Node child = first_children_[node]; child != NO_PARENT; child = next_siblings_[child])
+                update_stack_.push_back(child);
+        }
+    }
+    dirty_nodes_.clear();
+    return updated;
+}
+
+void Scene::mark_dirty(Node node)
+{
+    if (dirty_[node])
+        return;
+    dirty_[node] = true;
+    dirty_nodes_.push_back(node);
+}
+
+}
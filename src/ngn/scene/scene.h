@@ -0,0 +1,115 @@
+#pragma once
+
+#include "../math/ray.h"
+#include "../math/triangle_bvh.h"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace ngn {
+
+class Mesh;
+
+/**
+ * @brief Flat transform hierarchy.
+ *
+ * Nodes are stored as parallel arrays, and a node is always created after its parent so the arrays
+ * stay topologically ordered. Changing a node's local transform flags it dirty, and update() only
+ * recomputes the world matrices of dirty nodes and their descendants.
+ */
+class Scene {
+public:
+    using Node = uint32_t;
+    static constexpr Node NO_PARENT = UINT32_MAX;
+
+    struct Renderable {
+        Node node;
+        const Mesh* mesh;
+    };
+
+    struct RayHit {
+        Node node;
+        const Mesh* mesh;
+        /**
+         * @brief Distance along the world space ray, triangle of the mesh and where it was hit.
+         */
+        TriangleHit triangle;
+    };
+
+    Scene() = default;
+    ~Scene() = default;
+
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+    Scene(Scene&&) = delete;
+
+    /**
+     * @brief Creates a node under {{parent}}, inheriting its static flag.
+     */
+    Node create_node(Node parent = NO_PARENT);
+
+    void set_translation(Node node, const glm::vec3& translation);
+    void set_rotation(Node node, const glm::quat& rotation);
+    void set_scale(Node node, const glm::vec3& scale);
+    /**
+     * @brief Sets the local transform from a matrix, decomposed into translation, rotation and scale.
+     */
+    void set_local_transform(Node node, const glm::mat4& transform);
+
+    const glm::vec3& translation(Node node) const;
+    const glm::quat& rotation(Node node) const;
+    const glm::vec3& scale(Node node) const;
+    /**
+     * @brief World matrix as of the last update().
+     */
+    const glm::mat4& world_matrix(Node node) const;
+    Node parent(Node node) const;
+    size_t size() const;
+
+    /**
+     * @brief Flags a node whose transform will not change, so its meshes can be cached (e.g. in shadow maps).
+     */
+    void set_static(Node node, bool is_static);
+    bool is_static(Node node) const;
+
+    /**
+     * @brief Draws {{mesh}} with the world matrix of {{node}}. The mesh must outlive the scene.
+     */
+    void attach(Node node, const Mesh& mesh);
+    const std::vector<Renderable>& renderables() const;
+
+    /**
+     * @brief Closest renderable hit by {{ray}}, in world space, with the world matrices of the last update().
+     */
+    std::optional<RayHit> raycast(const Ray& ray) const;
+
+    /**
+     * @brief Recomputes the world matrices of changed nodes and their descendants.
+     *
+     * @return Number of nodes recomputed.
+     */
+    size_t update();
+
+private:
+    void mark_dirty(Node node);
+
+    std::vector<Node> parents_;
+    std::vector<Node> first_children_;
+    std::vector<Node> next_siblings_;
+    std::vector<glm::vec3> translations_;
+    std::vector<glm::quat> rotations_;
+    std::vector<glm::vec3> scales_;
+    std::vector<glm::mat4> world_matrices_;
+    std::vector<uint8_t> dirty_;
+    std::vector<uint8_t> static_;
+
+    std::vector<Node> dirty_nodes_;
+    std::vector<Node> update_stack_;
+    std::vector<Renderable> renderables_;
+};
+
+}
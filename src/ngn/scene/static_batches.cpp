@@ -0,0 +1,165 @@
+#include "static_batches.h"
+
+#include "../rendering/gl_state.h"
+#include "../rendering/gpu_memory.h"
+#include "../utils/frame_arena.h"
+
+#include <glad/glad.h>
+
+#include <map>
+#include <string>
+#include <utility>
+
+namespace ngn {
+
+namespace {
+
+    using MaterialKey = std::vector<std::pair<TextureType::Value, std::string>>;
+
+    MaterialKey material_key(const Mesh& mesh)
+    {
+        MaterialKey key;
+        for (auto& texture : mesh.textures())
+            key.emplace_back(texture.type(), texture.path());
+        return key;
+    }
+
+    /**
+     * @brief Culled when every corner of {{bounds}} is outside the same clip plane.
+     */
+    bool intersects_frustum(const Bounds& bounds, const glm::mat4& view_projection)
+    {
+        int outside[6] = {};
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec3 point {
+                corner & 1 ? bounds.max.x : bounds.min.x,
+                corner & 2 ? bounds.max.y : bounds.min.y,
+                corner & 4 ? bounds.max.z : bounds.min.z,
+            };
+            glm::vec4 clip = view_projection * glm::vec4(point, 1);
+            outside[0] += clip.x < -clip.w;
+            outside[1] += clip.x > clip.w;
+            outside[2] += clip.y < -clip.w;
+            outside[3] += clip.y > clip.w;
+            outside[4] += clip.z < -clip.w;
+            outside[5] += clip.z > clip.w;
+        }
+        for (int plane = 0; plane < 6; plane++) {
+            if (outside[plane] == 8)
+                return false;
+        }
+        return true;
+    }
+
+}
+
+void StaticBatches::build(const Scene& scene)
+{
+    clear();
+    auto& renderables = scene.renderables();
+    merged_.assign(renderables.size(), false);
+
+    // Groups in order of first appearance, so batches come out in scene order.
+    std::map<MaterialKey, size_t> group_indices;
+    std::vector<std::vector<size_t>> groups;
+    for (size_t i = 0; i < renderables.size(); i++) {
+        if (!scene.is_static(renderables[i].node))
+            continue;
+        auto [it, inserted] = group_indices.try_emplace(material_key(*renderables[i].mesh), groups.size());
+        if (inserted)
+            groups.emplace_back();
+        groups[it->second].push_back(i);
+    }
+
+    GpuMemory::Scope memory_scope("Static batches");
+    batches_.reserve(groups.size());
+    for (auto& group : groups) {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned> indices;
+        std::vector<Cluster> clusters;
+        for (size_t index : group) {
+            const Mesh& mesh = *renderables[index].mesh;
+            const glm::mat4& world = scene.world_matrix(renderables[index].node);
+            glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(world)));
+            // A mirroring transform flips the winding, which face culling would then reject.
+            bool mirrored = glm::determinant(glm::mat3(world)) < 0;
+
+            unsigned base_vertex = static_cast<unsigned>(vertices.size());
+            Cluster cluster { {}, static_cast<unsigned>(indices.size()), static_cast<unsigned>(mesh.indices().size()), static_cast<unsigned>(index) };
+            for (auto& vertex : mesh.vertices()) {
+                Vertex transformed = vertex;
+                transformed.position = glm::vec3(world * glm::vec4(vertex.position, 1));
+                transformed.normal = glm::normalize(normal_matrix * vertex.normal);
+                cluster.bounds.extend(transformed.position);
+                vertices.push_back(transformed);
+            }
+            for (size_t i = 0; i + 2 < mesh.indices().size(); i += 3) {
+                indices.push_back(base_vertex + mesh.indices()[i]);
+                indices.push_back(base_vertex + mesh.indices()[i + (mirrored ? 2 : 1)]);
+                indices.push_back(base_vertex + mesh.indices()[i + (mirrored ? 1 : 2)]);
+            }
+            clusters.push_back(cluster);
+            merged_[index] = true;
+        }
+        cluster_count_ += clusters.size();
+        const std::vector<Texture>& textures = renderables[group.front()].mesh->textures();
+        // Picking raycasts the source meshes, never the batches.
+        batches_.push_back({ Mesh(std::move(vertices), std::move(indices), textures, false), std::move(clusters) });
+    }
+}
+
+void StaticBatches::clear()
+{
+    batches_.clear();
+    merged_.clear();
+    cluster_count_ = 0;
+}
+
+bool StaticBatches::contains(size_t index) const
+{
+    return index < merged_.size() && merged_[index];
+}
+
+const std::vector<StaticBatches::Batch>& StaticBatches::batches() const
+{
+    return batches_;
+}
+
+size_t StaticBatches::cluster_count() const
+{
+    return cluster_count_;
+}
+
+void StaticBatches::draw(const Batch& batch, bool depth_only)
+{
+    GLState::bind_vertex_array(depth_only ? batch.mesh.depth_VAO() : batch.mesh.VAO());
+    glDrawElements(GL_TRIANGLES, batch.mesh.indices().size(), GL_UNSIGNED_INT, 0);
+}
+
+unsigned StaticBatches::draw_visible(const Batch& batch, const glm::mat4& view_projection, bool depth_only, const OcclusionCuller* occlusion)
+{
+    // Clusters are contiguous in the index buffer, so a run of visible ones is drawn as a single range.
+    std::pmr::vector<GLsizei> counts(&frame_arena());
+    std::pmr::vector<const void*> offsets(&frame_arena());
+    unsigned drawn = 0;
+    bool previous_visible = false;
+    for (auto& cluster : batch.clusters) {
+        bool visible = intersects_frustum(cluster.bounds, view_projection) && (!occlusion || occlusion->is_visible(cluster.renderable));
+        if (visible && previous_visible) {
+            counts.back() += cluster.index_count;
+        } else if (visible) {
+            counts.push_back(cluster.index_count);
+            offsets.push_back(reinterpret_cast<const void*>(cluster.first_index * sizeof(unsigned)));
+        }
+        drawn += visible;
+        previous_visible = visible;
+    }
+    if (counts.empty())
+        return 0;
+
+    GLState::bind_vertex_array(depth_only ? batch.mesh.depth_VAO() : batch.mesh.VAO());
+    glMultiDrawElements(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(), counts.size());
+    return drawn;
+}
+
+}
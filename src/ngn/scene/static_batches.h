@@ -0,0 +1,89 @@
+#pragma once
+
+#include "../math/bounds.h"
+#include "../rendering/mesh.h"
+#include "../rendering/occlusion_culler.h"
+#include "scene.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace ngn {
+
+/**
+ * @brief Static renderables of a scene merged, per material, into world space meshes drawn in one call each.
+ *
+ * Renderables whose meshes share the same textures are pre-transformed by their world matrix and appended
+ * to the batch of that texture set. Each one stays a cluster of the batch, a range of its indices with
+ * world bounds, so batches are still frustum and occlusion culled piecewise.
+ */
+class StaticBatches {
+public:
+    struct Cluster {
+        Bounds bounds;
+        unsigned first_index;
+        unsigned index_count;
+        /**
+         * @brief Scene index of the renderable merged, which identifies the cluster to occlusion culling.
+         */
+        unsigned renderable;
+    };
+
+    struct Batch {
+        /**
+         * @brief Merged geometry, in world space, with the textures of the material.
+         */
+        Mesh mesh;
+        std::vector<Cluster> clusters;
+    };
+
+    StaticBatches() = default;
+    ~StaticBatches() = default;
+
+    StaticBatches(const StaticBatches&) = delete;
+    StaticBatches& operator=(const StaticBatches&) = delete;
+    StaticBatches(StaticBatches&&) = delete;
+
+    /**
+     * @brief Merges the static renderables of {{scene}}, with the world matrices of its last update().
+     *
+     * Materials are told apart by texture path, so this may run before or after TexturePool::pack().
+     */
+    void build(const Scene& scene);
+    void clear();
+
+    /**
+     * @brief Whether renderable {{index}} of the scene was merged into a batch, and must not be drawn on its own.
+     */
+    bool contains(size_t index) const;
+
+    const std::vector<Batch>& batches() const;
+    /**
+     * @brief Renderables merged over every batch.
+     */
+    size_t cluster_count() const;
+
+    /**
+     * @brief Draws every cluster of {{batch}}, with the position-only stream when {{depth_only}}.
+     *
+     * The material must be bound and the model matrix set to identity.
+     */
+    static void draw(const Batch& batch, bool depth_only);
+    /**
+     * @brief Draws the clusters of {{batch}} inside the frustum of {{view_projection}} in one glMultiDrawElements.
+     *
+     * With {{occlusion}}, clusters it found occluded are skipped as well, according to its CPU side results:
+     * conditional rendering would split the draw per cluster.
+     *
+     * @return Clusters drawn.
+     */
+    static unsigned draw_visible(const Batch& batch, const glm::mat4& view_projection, bool depth_only, const OcclusionCuller* occlusion = nullptr);
+
+private:
+    std::vector<Batch> batches_;
+    std::vector<uint8_t> merged_;
+    size_t cluster_count_ = 0;
+};
+
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+
+namespace ngn {
+
+/**
+ * @brief Number of calls to the global operator new since the start of the program, from every thread.
+ *
+ * Compare two reads to count the heap allocations of a frame. Allocations made with malloc (e.g. by C
+ * libraries or ImGui) are not counted.
+ */
+size_t heap_allocation_count();
+
+}
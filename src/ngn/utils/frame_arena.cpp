@@ -0,0 +1,88 @@
+#include "frame_arena.h"
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+
+namespace ngn {
+
+FrameArena::FrameArena(size_t block_size)
+    : block_size_(block_size)
+{
+}
+
+void FrameArena::reset()
+{
+    current_ = 0;
+    offset_ = 0;
+    used_ = 0;
+}
+
+const char* FrameArena::format(const char* format_string, ...)
+{
+    va_list arguments;
+    va_start(arguments, format_string);
+    va_list measure_arguments;
+    va_copy(measure_arguments, arguments);
+    int length = std::vsnprintf(nullptr, 0, format_string, measure_arguments);
+    va_end(measure_arguments);
+
+    char* string = static_cast<char*>(allocate(length + 1, 1));
+    std::vsnprintf(string, length + 1, format_string, arguments);
+    va_end(arguments);
+    return string;
+}
+
+size_t FrameArena::used() const
+{
+    return used_;
+}
+
+size_t FrameArena::capacity() const
+{
+    size_t capacity = 0;
+    for (auto& block : blocks_)
+        capacity += block.size;
+    return capacity;
+}
+
+void* FrameArena::do_allocate(size_t bytes, size_t alignment)
+{
+    while (current_ < blocks_.size()) {
+        Block& block = blocks_[current_];
+        // The address is aligned, not the offset: blocks themselves are only aligned for new.
+        uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+        size_t aligned = ((base + offset_ + alignment - 1) & ~(alignment - 1)) - base;
+        if (aligned + bytes <= block.size) {
+            offset_ = aligned + bytes;
+            used_ += bytes;
+            return block.data.get() + aligned;
+        }
+        // Move on to the next block, the end of this one stays unused until reset.
+        current_++;
+        offset_ = 0;
+    }
+
+    // Enough for the allocation wherever alignment padding puts it in the block.
+    size_t size = std::max(block_size_, bytes + alignment);
+    blocks_.push_back({ std::make_unique<std::byte[]>(size), size });
+    return do_allocate(bytes, alignment);
+}
+
+void FrameArena::do_deallocate(void* pointer, size_t bytes, size_t alignment)
+{
+}
+
+bool FrameArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept
+{
+    return this == &other;
+}
+
+FrameArena& frame_arena()
+{
+    thread_local FrameArena arena;
+    return arena;
+}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace ngn {
+
+/**
+ * @brief Bump allocator for data that only lives until the end of the frame.
+ *
+ * Deallocation does nothing: everything is released at once by reset(). Blocks are kept across resets,
+ * so once the arena has grown to a frame's needs it never touches the heap again.
+ */
+class FrameArena : public std::pmr::memory_resource {
+public:
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+    FrameArena(size_t block_size = DEFAULT_BLOCK_SIZE);
+    ~FrameArena() override = default;
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+    FrameArena(FrameArena&&) = delete;
+
+    /**
+     * @brief Releases every allocation. Pointers into the arena must not be used afterwards.
+     */
+    void reset();
+
+    /**
+     * @brief Formats a string into the arena, valid until the next reset().
+     */
+    const char* format(const char* format_string, ...) __attribute__((format(printf, 2, 3)));
+
+    size_t used() const;
+    size_t capacity() const;
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    size_t block_size_;
+    std::vector<Block> blocks_;
+    size_t current_ { 0 };
+    size_t offset_ { 0 };
+    size_t used_ { 0 };
+};
+
+/**
+ * @brief Arena of the calling thread, reset by that thread at the end of each of its frames.
+ */
+FrameArena& frame_arena();
+
+}
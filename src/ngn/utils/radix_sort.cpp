@@ -0,0 +1,64 @@
+#include "radix_sort.h"
+
+#include <cstring>
+#include <utility>
+
+namespace ngn {
+
+constexpr unsigned RADIX_BITS = 8;
+constexpr unsigned RADIX_SIZE = 1 << RADIX_BITS;
+constexpr unsigned RADIX_PASSES = 64 / RADIX_BITS;
+
+uint32_t sortable_float(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    // Negative floats sort backwards: flip them entirely, positive ones only need the sign bit set.
+    uint32_t mask = -static_cast<int32_t>(bits >> 31) | 0x80000000;
+    return bits ^ mask;
+}
+
+uint64_t depth_sort_key(float depth, uint32_t draw)
+{
+    return static_cast<uint64_t>(sortable_float(depth)) << 32 | draw;
+}
+
+void radix_sort(uint64_t* keys, uint64_t* scratch, size_t count)
+{
+    if (count < 2)
+        return;
+
+    // Build every histogram in a single read of the keys.
+    uint32_t histograms[RADIX_PASSES][RADIX_SIZE] {};
+    for (size_t i = 0; i < count; i++) {
+        uint64_t key = keys[i];
+        for (unsigned pass = 0; pass < RADIX_PASSES; pass++)
+            histograms[pass][(key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)]++;
+    }
+
+    uint64_t* source = keys;
+    uint64_t* destination = scratch;
+    for (unsigned pass = 0; pass < RADIX_PASSES; pass++) {
+        uint32_t* histogram = histograms[pass];
+        unsigned shift = pass * RADIX_BITS;
+        if (histogram[(source[0] >> shift) & (RADIX_SIZE - 1)] == count)
+            continue;
+
+        uint32_t offset = 0;
+        for (unsigned digit = 0; digit < RADIX_SIZE; digit++) {
+            uint32_t digit_count = histogram[digit];
+            histogram[digit] = offset;
+            offset += digit_count;
+        }
+        for (size_t i = 0; i < count; i++) {
+            uint64_t key = source[i];
+            destination[histogram[(key >> shift) & (RADIX_SIZE - 1)]++] = key;
+        }
+        std::swap(source, destination);
+    }
+
+    if (source != keys)
+        std::memcpy(keys, source, count * sizeof(uint64_t));
+}
+
+}
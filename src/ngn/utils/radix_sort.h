@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ngn {
+
+/**
+ * @brief Maps a float to an unsigned integer with the same ordering, so it can be radix sorted.
+ */
+uint32_t sortable_float(float value);
+
+/**
+ * @brief Packs a depth and a draw index into a key sorting by ascending depth, then draw index.
+ */
+uint64_t depth_sort_key(float depth, uint32_t draw);
+
+/**
+ * @brief Sorts keys in ascending order with a stable LSD radix sort.
+ *
+ * Does not allocate: {{scratch}} must hold at least {{count}} keys. Digits shared by every key are skipped.
+ */
+void radix_sort(uint64_t* keys, uint64_t* scratch, size_t count);
+
+}
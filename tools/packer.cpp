@@ -0,0 +1,145 @@
+#include "ngn/io/compression.h"
+#include "ngn/io/file_system.h"
+#include "ngn/io/pack_format.h"
+#include "ngn/utils/log.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Compressed entries are only kept when they save at least this fraction of their size.
+ */
+constexpr double MINIMUM_SAVING = .05;
+
+struct PackedFile {
+    std::string path;
+    std::string disk_path;
+    ngn::pack::Entry entry;
+};
+
+static void usage()
+{
+    fprintf(stderr, "usage: packer [--lz4 | --zstd] [--level N] <output> <directory>...\n");
+}
+
+static void pad_to_alignment(std::ofstream& output)
+{
+    static constexpr char zeros[ngn::pack::ALIGNMENT] = {};
+    uint64_t offset = output.tellp();
+    output.write(zeros, (ngn::pack::ALIGNMENT - offset % ngn::pack::ALIGNMENT) % ngn::pack::ALIGNMENT);
+}
+
+int main(int argc, char** argv)
+{
+    ngn::pack::Compression compression = ngn::pack::Compression::None;
+    int level = 0;
+    std::vector<std::string> arguments;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--lz4") == 0) {
+            compression = ngn::pack::Compression::LZ4;
+        } else if (std::strcmp(argv[i], "--zstd") == 0) {
+            compression = ngn::pack::Compression::Zstd;
+        } else if (std::strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+            level = std::stoi(argv[++i]);
+        } else {
+            arguments.push_back(argv[i]);
+        }
+    }
+    if (arguments.size() < 2) {
+        usage();
+        return 1;
+    }
+    if (!ngn::compression_supported(compression)) {
+        LOGERR("The requested compression is not supported by this build.");
+        return 1;
+    }
+
+    // Entries are named as the runtime asks for them: relative to the working directory.
+    std::vector<PackedFile> files;
+    for (size_t i = 1; i < arguments.size(); i++) {
+        for (auto& item : std::filesystem::recursive_directory_iterator(arguments[i])) {
+            if (!item.is_regular_file())
+                continue;
+            std::string path = ngn::pack::normalize_path(item.path().generic_string());
+            files.push_back({ path, item.path().string(), {} });
+        }
+    }
+    std::sort(files.begin(), files.end(), [](const PackedFile& a, const PackedFile& b) { return a.path < b.path; });
+
+    std::ofstream output(arguments[0], std::ios::binary | std::ios::trunc);
+    if (!output) {
+        LOGERRF("Failed to create \"%s\".", arguments[0].c_str());
+        return 1;
+    }
+    ngn::pack::Header header {};
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    uint64_t total_size = 0, total_stored_size = 0;
+    std::string paths;
+    for (auto& file : files) {
+        ngn::FileView view = ngn::FileSystem::open(file.disk_path);
+        if (!view)
+            return 1;
+
+        ngn::pack::Entry& entry = file.entry;
+        entry.hash = ngn::pack::hash(file.path);
+        entry.size = view.size();
+        entry.compression = ngn::pack::Compression::None;
+        entry.path_offset = paths.size();
+        entry.path_length = file.path.size();
+        paths += file.path;
+
+        std::vector<std::byte> compressed;
+        if (compression != ngn::pack::Compression::None && view.size() > 0) {
+            compressed = ngn::compress(compression, view.data(), view.size(), level);
+            if (!compressed.empty() && compressed.size() <= view.size() * (1 - MINIMUM_SAVING))
+                entry.compression = compression;
+        }
+        const std::byte* data = entry.compression == ngn::pack::Compression::None ? view.data() : compressed.data();
+        entry.stored_size = entry.compression == ngn::pack::Compression::None ? view.size() : compressed.size();
+
+        pad_to_alignment(output);
+        entry.offset = output.tellp();
+        output.write(reinterpret_cast<const char*>(data), entry.stored_size);
+        total_size += entry.size;
+        total_stored_size += entry.stored_size;
+    }
+
+    std::vector<ngn::pack::Entry> entries;
+    entries.reserve(files.size());
+    for (auto& file : files)
+        entries.push_back(file.entry);
+    std::sort(entries.begin(), entries.end(), [](const ngn::pack::Entry& a, const ngn::pack::Entry& b) { return a.hash < b.hash; });
+    for (size_t i = 1; i < entries.size(); i++) {
+        if (entries[i - 1].hash == entries[i].hash) {
+            LOGERRF("Hash collision between \"%.*s\" and \"%.*s\".",
+                static_cast<int>(entries[i - 1].path_length), paths.data() + entries[i - 1].path_offset,
+                static_cast<int>(entries[i].path_length), paths.data() + entries[i].path_offset);
+            return 1;
+        }
+    }
+
+    pad_to_alignment(output);
+    std::memcpy(header.magic, ngn::pack::MAGIC, sizeof(header.magic));
+    header.version = ngn::pack::VERSION;
+    header.entry_count = entries.size();
+    header.toc_offset = output.tellp();
+    output.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(ngn::pack::Entry));
+    output.write(paths.data(), paths.size());
+    output.seekp(0);
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output.close();
+    if (!output) {
+        LOGERRF("Failed to write \"%s\".", arguments[0].c_str());
+        return 1;
+    }
+
+    printf("%s: %zu files, %llu bytes stored for %llu bytes.\n", arguments[0].c_str(), files.size(),
+        static_cast<unsigned long long>(total_stored_size), static_cast<unsigned long long>(total_size));
+    return 0;
+}
@@ -0,0 +1,657 @@
+#include "ngn/io/compression.h"
+#include "ngn/io/file_system.h"
+#include "ngn/rendering/gl_capture_format.h"
+#include "ngn/rendering/gl_context.h"
+#include "ngn/utils/log.h"
+
+#include <glad/glad.h>
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <span>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+using ngn::gl_capture::Command;
+
+constexpr size_t DEFAULT_ITERATIONS = 100;
+
+static void usage()
+{
+    fprintf(stderr, "usage: replayer <capture> [iterations]\n");
+}
+
+/**
+ * @brief Names of one kind of GL object, from the captured run to this one.
+ */
+class Names {
+public:
+    GLuint operator()(GLuint captured) const
+    {
+        auto name = names_.find(captured);
+        return name == names_.end() ? 0 : name->second;
+    }
+
+    void add(GLuint captured, GLuint name)
+    {
+        names_[captured] = name;
+    }
+
+    void remove(GLuint captured)
+    {
+        names_.erase(captured);
+    }
+
+private:
+    std::unordered_map<GLuint, GLuint> names_;
+};
+
+struct GroupStats {
+    std::string name;
+    size_t calls = 0;
+    double cpu_ms = 0;
+    double gpu_ms = 0;
+};
+
+/**
+ * @brief Executes a capture stream against the current context.
+ *
+ * Frames are timed per group: CPU time spent issuing (decoding included) and GPU time between timestamp
+ * queries around each group. Timestamps are used as the captured frames may have time elapsed queries
+ * of their own running.
+ */
+class Replayer {
+public:
+    Replayer(std::span<const std::byte> stream)
+        : stream_(stream)
+    {
+    }
+
+    /**
+     * @brief Runs the commands up to {{end}}, at most the stream size, without timing them.
+     *
+     * @return Whether the commands were valid. Otherwise the error is logged and running stopped there.
+     */
+    bool run_setup(size_t end)
+    {
+        offset_ = 0;
+        Command command;
+        while (offset_ < end && next(command)) {
+            if (command == Command::Group)
+                read_data();
+            else if (command != Command::FrameEnd)
+                execute(command);
+        }
+        return !failed_;
+    }
+
+    /**
+     * @brief Runs the commands from {{begin}} to the end of the stream, swapping {{window}} after each frame.
+     *
+     * @return Whether the commands were valid, as for run_setup().
+     */
+    bool run_frames(size_t begin, GLFWwindow* window, bool record_stats)
+    {
+        offset_ = begin;
+        record_stats_ = record_stats;
+        open_segment("(frame start)");
+        Command command;
+        while (offset_ < stream_.size() && next(command)) {
+            if (command == Command::Group) {
+                auto name = read_data();
+                close_segment();
+                open_segment(std::string(reinterpret_cast<const char*>(name.data()), name.size()));
+            } else if (command == Command::FrameEnd) {
+                close_segment();
+                glfwSwapBuffers(window);
+                open_segment("(frame start)");
+            } else {
+                execute(command);
+                if (record_stats_)
+                    groups_[group_].calls++;
+            }
+        }
+        close_segment();
+        return !failed_;
+    }
+
+    /**
+     * @brief Reads back the GPU times of the last run_frames(), waiting for them.
+     */
+    void collect_gpu_times()
+    {
+        for (auto& [group, first_query] : segments_) {
+            GLuint64 begin, end;
+            glGetQueryObjectui64v(timestamps_[first_query], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(timestamps_[first_query + 1], GL_QUERY_RESULT, &end);
+            groups_[group].gpu_ms += (end - begin) / 1e6;
+        }
+        segments_.clear();
+        next_timestamp_ = 0;
+    }
+
+    const std::vector<GroupStats>& groups() const
+    {
+        return groups_;
+    }
+
+private:
+    void fail(const char* error)
+    {
+        if (!failed_) {
+            LOGERRF("Invalid capture: %s at byte %zu.", error, offset_);
+        }
+        failed_ = true;
+    }
+
+    /**
+     * @brief Reads the next command. An unknown one fails the stream, as its arguments cannot be skipped.
+     */
+    bool next(Command& command)
+    {
+        command = read<Command>();
+        if (static_cast<uint16_t>(command) > static_cast<uint16_t>(Command::FrameEnd))
+            fail("unknown command");
+        return !failed_;
+    }
+
+    /**
+     * @brief Past the end of the stream, reads fail it and return zeros, which GL ignores or rejects, until
+     * the command being read ends.
+     */
+    template <typename T>
+    T read()
+    {
+        if constexpr (std::is_pointer_v<T>) {
+            return reinterpret_cast<T>(static_cast<uintptr_t>(read<uint64_t>()));
+        } else {
+            T value {};
+            if (sizeof(T) > stream_.size() - offset_) {
+                fail("truncated command");
+                return value;
+            }
+            std::memcpy(&value, stream_.data() + offset_, sizeof(T));
+            offset_ += sizeof(T);
+            return value;
+        }
+    }
+
+    std::span<const std::byte> read_data()
+    {
+        uint64_t size = read<uint64_t>();
+        if (size > stream_.size() - offset_) {
+            fail("truncated data");
+            return {};
+        }
+        std::span<const std::byte> data = stream_.subspan(offset_, size);
+        offset_ += size;
+        return data;
+    }
+
+    template <typename... Args>
+    void replay(void(APIENTRYP function)(Args...))
+    {
+        // Braced initialization evaluates in order.
+        std::tuple<Args...> arguments { read<Args>()... };
+        std::apply(function, arguments);
+    }
+
+    void generate(void(APIENTRYP function)(GLsizei, GLuint*), Names& names)
+    {
+        auto data = read_data();
+        std::vector<GLuint> captured(data.size() / sizeof(GLuint));
+        std::memcpy(captured.data(), data.data(), data.size());
+        std::vector<GLuint> generated(captured.size());
+        function(generated.size(), generated.data());
+        for (size_t i = 0; i < captured.size(); i++)
+            names.add(captured[i], generated[i]);
+    }
+
+    void remove(void(APIENTRYP function)(GLsizei, const GLuint*), Names& names)
+    {
+        auto data = read_data();
+        std::vector<GLuint> captured(data.size() / sizeof(GLuint));
+        std::memcpy(captured.data(), data.data(), data.size());
+        std::vector<GLuint> deleted;
+        for (GLuint name : captured) {
+            deleted.push_back(names(name));
+            names.remove(name);
+        }
+        function(deleted.size(), deleted.data());
+    }
+
+    /**
+     * @brief Stream data copied to aligned storage, valid until the next call.
+     */
+    template <typename T>
+    const T* aligned(std::span<const std::byte> data)
+    {
+        scratch_.resize(data.size());
+        std::memcpy(scratch_.data(), data.data(), data.size());
+        return reinterpret_cast<const T*>(scratch_.data());
+    }
+
+    GLint location(GLint captured) const
+    {
+        auto location = locations_.find({ program_, captured });
+        return location == locations_.end() ? -1 : location->second;
+    }
+
+    void execute(Command command)
+    {
+        switch (command) {
+#define NGN_REPLAY_SIMPLE(name)     \
+    case Command::name:             \
+        replay(gl##name);           \
+        break;
+            NGN_GL_CAPTURE_SIMPLE_COMMANDS(NGN_REPLAY_SIMPLE)
+#undef NGN_REPLAY_SIMPLE
+
+        case Command::GenBuffers:
+            generate(glGenBuffers, buffers_);
+            break;
+        case Command::GenTextures:
+            generate(glGenTextures, textures_);
+            break;
+        case Command::GenVertexArrays:
+            generate(glGenVertexArrays, vertex_arrays_);
+            break;
+        case Command::GenFramebuffers:
+            generate(glGenFramebuffers, framebuffers_);
+            break;
+        case Command::GenRenderbuffers:
+            generate(glGenRenderbuffers, renderbuffers_);
+            break;
+        case Command::GenQueries:
+            generate(glGenQueries, queries_);
+            break;
+        case Command::DeleteBuffers:
+            remove(glDeleteBuffers, buffers_);
+            break;
+        case Command::DeleteTextures:
+            remove(glDeleteTextures, textures_);
+            break;
+        case Command::DeleteVertexArrays:
+            remove(glDeleteVertexArrays, vertex_arrays_);
+            break;
+        case Command::DeleteFramebuffers:
+            remove(glDeleteFramebuffers, framebuffers_);
+            break;
+        case Command::DeleteRenderbuffers:
+            remove(glDeleteRenderbuffers, renderbuffers_);
+            break;
+        case Command::DeleteQueries:
+            remove(glDeleteQueries, queries_);
+            break;
+        case Command::CreateShader: {
+            auto type = read<GLenum>();
+            shaders_.add(read<GLuint>(), glCreateShader(type));
+            break;
+        }
+        case Command::CreateProgram:
+            programs_.add(read<GLuint>(), glCreateProgram());
+            break;
+        case Command::DeleteShader: {
+            auto shader = read<GLuint>();
+            glDeleteShader(shaders_(shader));
+            shaders_.remove(shader);
+            break;
+        }
+        case Command::DeleteProgram: {
+            auto program = read<GLuint>();
+            glDeleteProgram(programs_(program));
+            programs_.remove(program);
+            break;
+        }
+
+        case Command::BindBuffer: {
+            auto target = read<GLenum>();
+            glBindBuffer(target, buffers_(read<GLuint>()));
+            break;
+        }
+        case Command::BindBufferBase: {
+            auto target = read<GLenum>();
+            auto index = read<GLuint>();
+            glBindBufferBase(target, index, buffers_(read<GLuint>()));
+            break;
+        }
+        case Command::BindTexture: {
+            auto target = read<GLenum>();
+            glBindTexture(target, textures_(read<GLuint>()));
+            break;
+        }
+        case Command::BindVertexArray:
+            glBindVertexArray(vertex_arrays_(read<GLuint>()));
+            break;
+        case Command::BindFramebuffer: {
+            auto target = read<GLenum>();
+            glBindFramebuffer(target, framebuffers_(read<GLuint>()));
+            break;
+        }
+        case Command::BindRenderbuffer: {
+            auto target = read<GLenum>();
+            glBindRenderbuffer(target, renderbuffers_(read<GLuint>()));
+            break;
+        }
+        case Command::UseProgram:
+            program_ = read<GLuint>();
+            glUseProgram(programs_(program_));
+            break;
+        case Command::FramebufferTexture2D: {
+            auto [target, attachment, texture_target, texture, level] = std::tuple { read<GLenum>(), read<GLenum>(), read<GLenum>(), read<GLuint>(), read<GLint>() };
+            glFramebufferTexture2D(target, attachment, texture_target, textures_(texture), level);
+            break;
+        }
+        case Command::FramebufferTextureLayer: {
+            auto [target, attachment, texture, level, layer] = std::tuple { read<GLenum>(), read<GLenum>(), read<GLuint>(), read<GLint>(), read<GLint>() };
+            glFramebufferTextureLayer(target, attachment, textures_(texture), level, layer);
+            break;
+        }
+        case Command::FramebufferRenderbuffer: {
+            auto [target, attachment, renderbuffer_target, renderbuffer] = std::tuple { read<GLenum>(), read<GLenum>(), read<GLenum>(), read<GLuint>() };
+            glFramebufferRenderbuffer(target, attachment, renderbuffer_target, renderbuffers_(renderbuffer));
+            break;
+        }
+        case Command::BeginQuery: {
+            auto target = read<GLenum>();
+            glBeginQuery(target, queries_(read<GLuint>()));
+            break;
+        }
+        case Command::QueryCounter: {
+            auto query = read<GLuint>();
+            glQueryCounter(queries_(query), read<GLenum>());
+            break;
+        }
+        case Command::BeginConditionalRender: {
+            auto query = read<GLuint>();
+            glBeginConditionalRender(queries_(query), read<GLenum>());
+            break;
+        }
+        case Command::GetQueryObjectiv:
+        case Command::GetQueryObjectuiv:
+        case Command::GetQueryObjectui64v:
+            // Nothing replayed uses the results. The captured run only read them once available, but
+            // reading them here would wait for the GPU and distort the times measured.
+            read<GLuint>();
+            read<GLenum>();
+            break;
+
+        case Command::ShaderSource: {
+            auto shader = read<GLuint>();
+            auto source = read_data();
+            auto* string = reinterpret_cast<const GLchar*>(source.data());
+            GLint length = source.size();
+            glShaderSource(shaders_(shader), 1, &string, &length);
+            break;
+        }
+        case Command::CompileShader:
+            glCompileShader(shaders_(read<GLuint>()));
+            break;
+        case Command::AttachShader: {
+            auto program = read<GLuint>();
+            glAttachShader(programs_(program), shaders_(read<GLuint>()));
+            break;
+        }
+        case Command::LinkProgram:
+            glLinkProgram(programs_(read<GLuint>()));
+            break;
+        case Command::GetUniformLocation: {
+            auto program = read<GLuint>();
+            auto data = read_data();
+            std::string name(reinterpret_cast<const char*>(data.data()), data.size());
+            auto captured = read<GLint>();
+            locations_[{ program, captured }] = glGetUniformLocation(programs_(program), name.c_str());
+            break;
+        }
+        case Command::Uniform1i: {
+            auto captured = read<GLint>();
+            glUniform1i(location(captured), read<GLint>());
+            break;
+        }
+        case Command::Uniform1f: {
+            auto captured = read<GLint>();
+            glUniform1f(location(captured), read<GLfloat>());
+            break;
+        }
+        case Command::Uniform3fv: {
+            auto captured = read<GLint>();
+            auto data = read_data();
+            glUniform3fv(location(captured), data.size() / (3 * sizeof(GLfloat)), aligned<GLfloat>(data));
+            break;
+        }
+        case Command::Uniform4fv: {
+            auto captured = read<GLint>();
+            auto data = read_data();
+            glUniform4fv(location(captured), data.size() / (4 * sizeof(GLfloat)), aligned<GLfloat>(data));
+            break;
+        }
+        case Command::UniformMatrix4fv: {
+            auto captured = read<GLint>();
+            auto transpose = read<GLboolean>();
+            auto data = read_data();
+            glUniformMatrix4fv(location(captured), data.size() / (16 * sizeof(GLfloat)), transpose, aligned<GLfloat>(data));
+            break;
+        }
+
+        case Command::BufferData: {
+            auto [target, size, usage] = std::tuple { read<GLenum>(), read<GLsizeiptr>(), read<GLenum>() };
+            auto data = read_data();
+            glBufferData(target, size, data.empty() ? nullptr : data.data(), usage);
+            break;
+        }
+        case Command::BufferSubData: {
+            auto [target, offset] = std::tuple { read<GLenum>(), read<GLintptr>() };
+            auto data = read_data();
+            glBufferSubData(target, offset, data.size(), data.data());
+            break;
+        }
+        case Command::MapBufferRange: {
+            auto [target, offset, length, access] = std::tuple { read<GLenum>(), read<GLintptr>(), read<GLsizeiptr>(), read<GLbitfield>() };
+            auto data = read_data();
+            void* pointer = glMapBufferRange(target, offset, length, access);
+            if (pointer && !data.empty())
+                std::memcpy(pointer, data.data(), std::min<size_t>(data.size(), length));
+            glUnmapBuffer(target);
+            break;
+        }
+        case Command::TexImage2D: {
+            auto [target, level, internal_format, width, height, border, format, type] = std::tuple {
+                read<GLenum>(), read<GLint>(), read<GLint>(), read<GLsizei>(), read<GLsizei>(), read<GLint>(), read<GLenum>(), read<GLenum>()
+            };
+            auto data = read_data();
+            glTexImage2D(target, level, internal_format, width, height, border, format, type, data.empty() ? nullptr : data.data());
+            break;
+        }
+        case Command::TexImage3D: {
+            auto [target, level, internal_format, width, height, depth, border, format, type] = std::tuple {
+                read<GLenum>(), read<GLint>(), read<GLint>(), read<GLsizei>(), read<GLsizei>(), read<GLsizei>(), read<GLint>(), read<GLenum>(), read<GLenum>()
+            };
+            auto data = read_data();
+            glTexImage3D(target, level, internal_format, width, height, depth, border, format, type, data.empty() ? nullptr : data.data());
+            break;
+        }
+        case Command::TexParameterfv: {
+            auto [target, name] = std::tuple { read<GLenum>(), read<GLenum>() };
+            glTexParameterfv(target, name, aligned<GLfloat>(read_data()));
+            break;
+        }
+        case Command::ClearBufferfv: {
+            auto [buffer, draw_buffer] = std::tuple { read<GLenum>(), read<GLint>() };
+            glClearBufferfv(buffer, draw_buffer, aligned<GLfloat>(read_data()));
+            break;
+        }
+        case Command::DrawBuffers: {
+            auto data = read_data();
+            glDrawBuffers(data.size() / sizeof(GLenum), aligned<GLenum>(data));
+            break;
+        }
+        case Command::MultiDrawElements: {
+            auto [mode, type] = std::tuple { read<GLenum>(), read<GLenum>() };
+            auto counts = read_data();
+            auto offsets = read_data();
+            std::vector<GLsizei> draw_counts(counts.size() / sizeof(GLsizei));
+            std::memcpy(draw_counts.data(), counts.data(), counts.size());
+            std::vector<const void*> indices(offsets.size() / sizeof(uint64_t));
+            for (size_t i = 0; i < indices.size(); i++) {
+                uint64_t offset;
+                std::memcpy(&offset, offsets.data() + i * sizeof(uint64_t), sizeof(offset));
+                indices[i] = reinterpret_cast<const void*>(static_cast<uintptr_t>(offset));
+            }
+            glMultiDrawElements(mode, draw_counts.data(), type, indices.data(), draw_counts.size());
+            break;
+        }
+
+        case Command::Group:
+        case Command::FrameEnd:
+            break;
+        }
+    }
+
+    void open_segment(const std::string& name)
+    {
+        auto group = std::find_if(groups_.begin(), groups_.end(), [&](const GroupStats& stats) { return stats.name == name; });
+        if (group == groups_.end()) {
+            groups_.push_back({ name });
+            group = groups_.end() - 1;
+        }
+        group_ = group - groups_.begin();
+        segment_start_ = std::chrono::steady_clock::now();
+        if (record_stats_) {
+            if (next_timestamp_ + 2 > timestamps_.size()) {
+                timestamps_.resize(next_timestamp_ + 2);
+                glGenQueries(2, &timestamps_[next_timestamp_]);
+            }
+            segments_.emplace_back(group_, next_timestamp_);
+            glQueryCounter(timestamps_[next_timestamp_], GL_TIMESTAMP);
+            next_timestamp_ += 2;
+        }
+    }
+
+    void close_segment()
+    {
+        if (!record_stats_)
+            return;
+        glQueryCounter(timestamps_[segments_.back().second + 1], GL_TIMESTAMP);
+        std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - segment_start_;
+        groups_[group_].cpu_ms += duration.count();
+    }
+
+    std::span<const std::byte> stream_;
+    size_t offset_ = 0;
+    bool failed_ = false;
+
+    Names buffers_, textures_, vertex_arrays_, framebuffers_, renderbuffers_, queries_, shaders_, programs_;
+    /**
+     * @brief Uniform locations by captured program and captured location.
+     */
+    std::map<std::pair<GLuint, GLint>, GLint> locations_;
+    GLuint program_ = 0;
+    std::vector<std::byte> scratch_;
+
+    bool record_stats_ = false;
+    std::vector<GroupStats> groups_;
+    size_t group_ = 0;
+    std::chrono::steady_clock::time_point segment_start_;
+    std::vector<GLuint> timestamps_;
+    size_t next_timestamp_ = 0;
+    /**
+     * @brief Group and first of the two timestamps of every segment of the current run.
+     */
+    std::vector<std::pair<size_t, size_t>> segments_;
+};
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+    size_t iterations = DEFAULT_ITERATIONS;
+    if (argc > 2) {
+        char* end = nullptr;
+        iterations = std::strtoul(argv[2], &end, 10);
+        if (*end != '\0' || iterations == 0 || argv[2][0] == '-') {
+            usage();
+            return 1;
+        }
+    }
+
+    ngn::FileView file = ngn::FileSystem::open(argv[1]);
+    ngn::gl_capture::Header header;
+    if (!file || file.size() < sizeof(header)) {
+        LOGERRF("Failed to open \"%s\".", argv[1]);
+        return 1;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, ngn::gl_capture::MAGIC, sizeof(header.magic)) != 0 || header.version != ngn::gl_capture::VERSION
+        || file.size() - sizeof(header) < header.stored_size || header.setup_size > header.stream_size) {
+        LOGERRF("\"%s\" is not a capture of this version.", argv[1]);
+        return 1;
+    }
+    std::vector<std::byte> stream(header.stream_size);
+    if (!ngn::decompress(header.compression, file.data() + sizeof(header), header.stored_size, stream.data(), stream.size())) {
+        LOGERR("Failed to decompress the capture, or its compression is not supported by this build.");
+        return 1;
+    }
+
+    // Hidden: nothing needs to be shown, and it runs the same on a software rasterizer like llvmpipe.
+    GLFWwindow* window = ngn::create_hidden_gl_context(std::max(header.width, 1), std::max(header.height, 1), "replayer");
+    if (!window)
+        return 1;
+    glfwSwapInterval(0);
+    printf("%s: %u frames at %dx%d, %.1f MiB setup, %.1f MiB of frames, on %s\n", argv[1], header.frame_count, header.width, header.height,
+        header.setup_size / (1024. * 1024.), (header.stream_size - header.setup_size) / (1024. * 1024.), reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+
+    Replayer replayer(stream);
+    auto setup_start = std::chrono::steady_clock::now();
+    if (!replayer.run_setup(header.setup_size)) {
+        glfwTerminate();
+        return 1;
+    }
+    glFinish();
+    std::chrono::duration<double, std::milli> setup_duration = std::chrono::steady_clock::now() - setup_start;
+    printf("setup: %.3f ms\n", setup_duration.count());
+
+    // One untimed run first, so that the driver has compiled and uploaded everything. It also validates the
+    // frames: the timed runs replay the same commands.
+    if (!replayer.run_frames(header.setup_size, window, false)) {
+        glfwTerminate();
+        return 1;
+    }
+    glFinish();
+    double best_ms = INFINITY, total_ms = 0;
+    for (size_t i = 0; i < iterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        replayer.run_frames(header.setup_size, window, true);
+        glFinish();
+        std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+        replayer.collect_gpu_times();
+        best_ms = std::min(best_ms, duration.count());
+        total_ms += duration.count();
+    }
+
+    // Per frame averages.
+    double frames = static_cast<double>(iterations) * std::max(header.frame_count, 1u);
+    printf("%-24s %12s %12s %12s\n", "group", "calls", "cpu (ms)", "gpu (ms)");
+    double cpu_ms = 0, gpu_ms = 0;
+    for (auto& group : replayer.groups()) {
+        printf("%-24s %12.0f %12.3f %12.3f\n", group.name.c_str(), group.calls / frames, group.cpu_ms / frames, group.gpu_ms / frames);
+        cpu_ms += group.cpu_ms;
+        gpu_ms += group.gpu_ms;
+    }
+    printf("%-24s %12s %12.3f %12.3f\n", "total", "", cpu_ms / frames, gpu_ms / frames);
+    printf("frame: %.3f ms average, %.3f ms best, swaps and waits included\n", total_ms / frames, best_ms / std::max(header.frame_count, 1u));
+
+    glfwTerminate();
+    return 0;
+}